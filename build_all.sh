@@ -58,6 +58,8 @@ build_linux() {
     echo "Building qtype_client (WebSocket client)..."
     g++ -o "$BINARY_DIR/qtype_client-linux-x64" \
         "$SCRIPT_DIR/websocket/qtype_client.cpp" \
+        "$SCRIPT_DIR/core/typing_core.cpp" "$SCRIPT_DIR/core/x11_input.cpp" \
+        -I"$SCRIPT_DIR/core" -DQTYPE_HAVE_XTEST \
         -lX11 -lXtst -lXss -std=c++17 -O2
     chmod +x "$BINARY_DIR/qtype_client-linux-x64"
     echo -e "${GREEN}✓ qtype_client-linux-x64 built successfully${NC}"
@@ -78,6 +80,7 @@ build_windows() {
     x86_64-w64-mingw32-g++-posix \
         -o "$BINARY_DIR/qtype_client-windows-x64.exe" \
         "$SCRIPT_DIR/websocket/qtype_client.cpp" \
+        "$SCRIPT_DIR/core/typing_core.cpp" -I"$SCRIPT_DIR/core" \
         -static -std=c++17 -lws2_32 -O2 \
         -DWIN32_LEAN_AND_MEAN 2>&1 | grep -v "redefined" || true
     chmod +x "$BINARY_DIR/qtype_client-windows-x64.exe"
@@ -145,6 +148,7 @@ build_macos() {
     echo "Building qtype_client (WebSocket client)..."
     clang++ -o "$BINARY_DIR/qtype_client-macos-x64" \
         "$SCRIPT_DIR/websocket/qtype_client.cpp" \
+        "$SCRIPT_DIR/core/typing_core.cpp" -I"$SCRIPT_DIR/core" \
         -framework ApplicationServices \
         -std=c++17 -O2
     chmod +x "$BINARY_DIR/qtype_client-macos-x64"
@@ -0,0 +1,381 @@
+// core_benchmarks.cpp - Hot-path benchmarks for the typing core
+// Run: ./qtype_core_benchmarks [--benchmark_filter=<regex>]
+#include "typing_core.h"
+#include "session_host.h"
+#include "typing_pipeline.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+using namespace qtype;
+
+namespace {
+
+std::string loadCorpus() {
+    std::ifstream file(QTYPE_BENCH_INPUT, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (text.empty()) {
+        text = "The quick brown fox jumps over the lazy dog. ";
+    }
+    return text;
+}
+
+const std::string& corpus() {
+    static const std::string text = loadCorpus();
+    return text;
+}
+
+// Accepts every keystroke without touching the OS
+template<typename CharT>
+class NullKeyboard : public IKeyboardSimulator<CharT> {
+public:
+    void typeCharacter(CharT c, int holdTimeMs) override { benchmark::DoNotOptimize(c); }
+    void pressBackspace() override {}
+    void releaseAllKeys() override {}
+};
+
+template<typename CharT>
+std::basic_string<CharT> widen(const std::string& text) {
+    return std::basic_string<CharT>(text.begin(), text.end());
+}
+
+} // namespace
+
+// ============================================================================
+// Random
+// ============================================================================
+
+static void BM_RandomUniform(benchmark::State& state) {
+    Random rng(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.uniform());
+    }
+}
+BENCHMARK(BM_RandomUniform);
+
+static void BM_RandomNormal(benchmark::State& state) {
+    Random rng(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.normal(0.0, 1.0));
+    }
+}
+BENCHMARK(BM_RandomNormal);
+
+static void BM_RandomGamma(benchmark::State& state) {
+    Random rng(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.gamma(2.0, 1.0));
+    }
+}
+BENCHMARK(BM_RandomGamma);
+
+static void BM_RandomGammaPrecomputed(benchmark::State& state) {
+    Random rng(1);
+    constexpr GammaParams params = GammaParams::of(2.0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.gamma(params, 1.0));
+    }
+}
+BENCHMARK(BM_RandomGammaPrecomputed);
+
+static void BM_RandomFastNormal(benchmark::State& state) {
+    Random rng(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.fastNormal(0.0, 1.0));
+    }
+}
+BENCHMARK(BM_RandomFastNormal);
+
+static void BM_RandomFastGamma(benchmark::State& state) {
+    Random rng(1);
+    constexpr GammaParams params = GammaParams::of(2.0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.fastGamma(params, 1.0));
+    }
+}
+BENCHMARK(BM_RandomFastGamma);
+
+// ============================================================================
+// Per-keystroke work
+// ============================================================================
+
+// The class byte the engine reads per character, against the predicate
+// calls it replaced
+static void BM_CharClass(benchmark::State& state) {
+    const std::u16string text = widen<char16_t>(corpus());
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(detail::charClass<CharTraits<char16_t>>(text[i]));
+        if (++i == text.size()) i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CharClass);
+
+static void BM_CharPredicates(benchmark::State& state) {
+    using Traits = CharTraits<char16_t>;
+    const std::u16string text = widen<char16_t>(corpus());
+    size_t i = 0;
+    for (auto _ : state) {
+        char16_t c = text[i];
+        char32_t code = Traits::code(c);
+        benchmark::DoNotOptimize(Traits::isDigit(c));
+        benchmark::DoNotOptimize(Traits::isSpace(c));
+        benchmark::DoNotOptimize(code == '\n' || code == '.' || code == '!' || code == '?');
+        benchmark::DoNotOptimize(Traits::isUpper(c));
+        benchmark::DoNotOptimize(Traits::isLetter(c));
+        if (++i == text.size()) i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CharPredicates);
+
+// DynamicProfile is the GUI's run-time profile; the presets are folded in at
+// compile time
+template<typename Profile>
+static void BM_CalculateDelay(benchmark::State& state) {
+    Random rng(1);
+    TypingDynamics<char, CharTraits<char>, Profile> dynamics(
+        TimingProfile::humanAdvanced(), DelayRange{80, 180}, rng);
+    const std::string& text = corpus();
+    size_t i = 0;
+    for (auto _ : state) {
+        char c = text[i];
+        benchmark::DoNotOptimize(dynamics.generateHoldTime(c));
+        benchmark::DoNotOptimize(dynamics.calculateDelay(c, false, false, false));
+        dynamics.updateState(c);
+        if (++i == text.size()) i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_CalculateDelay, DynamicProfile);
+BENCHMARK_TEMPLATE(BM_CalculateDelay, HumanAdvancedProfile);
+
+// The same keystroke on the reference samplers and std::sin, as
+// TypingDynamics drew it before the ziggurat and the rhythm rotation: the
+// baseline for BM_CalculateDelay
+static void BM_CalculateDelayReference(benchmark::State& state) {
+    Random rng(1);
+    const TimingProfile profile = TimingProfile::humanAdvanced();
+    const GammaParams delayGamma = GammaParams::of(profile.gammaShape);
+    double phase = rng.uniform() * TypingConstants::TWO_PI;
+    const std::string& text = corpus();
+    char previous = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        char c = text[i];
+        double hold = rng.gamma(detail::HOLD_GAMMA, 20.0) * (0.9 + rng.uniform() * 0.2);
+        benchmark::DoNotOptimize(hold);
+
+        double delay = 80 + 100 * std::min(rng.gamma(delayGamma, profile.gammaScale) / 6.0, 1.0);
+        phase += TypingConstants::RHYTHM_STEP;
+        delay *= 0.85 + (std::sin(phase) * 0.5 + 0.5) * 0.3;
+        if (previous) delay *= detail::digraphFactor(previous, c);
+        if (rng.uniform() < profile.microStutterProb) delay *= 1.3 + rng.uniform() * 0.4;
+        delay *= 1.0 + rng.normal(0.0, profile.noiseLevel);
+        benchmark::DoNotOptimize(delay);
+
+        previous = c;
+        if (++i == text.size()) i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CalculateDelayReference);
+
+template<typename CharT>
+static void BM_Chunker(benchmark::State& state) {
+    std::basic_string<CharT> text = widen<CharT>(corpus());
+    TextChunker<CharT> chunker;
+    for (auto _ : state) {
+        chunker.setText(text.data(), text.size());
+        while (chunker.hasMore()) {
+            benchmark::DoNotOptimize(chunker.next());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_Chunker, char);
+BENCHMARK_TEMPLATE(BM_Chunker, wchar_t);
+BENCHMARK_TEMPLATE(BM_Chunker, char16_t);
+
+// Whole engine over the corpus; items/s is keystrokes per second, so
+// 1e9 / items_per_second is the engine's cost per keystroke in ns
+template<typename CharT, typename Profile = DynamicProfile>
+static void BM_TypeText(benchmark::State& state) {
+    std::basic_string<CharT> text = widen<CharT>(corpus());
+    NullKeyboard<CharT> keyboard;
+    ImperfectionSettings imperfections;
+    imperfections.enableTypos = false;       // Corrections sleep
+    imperfections.enableDoubleKeys = false;
+
+    TypingEngine<CharT, CharTraits<CharT>, Profile> engine(
+        &keyboard, nullptr, TimingProfile::humanAdvanced(), DelayRange{80, 180}, imperfections);
+    engine.seed(1);
+    for (auto _ : state) {
+        engine.setText(text);
+        while (engine.hasMoreToType()) {
+            benchmark::DoNotOptimize(engine.typeNextChunk());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * text.size());
+}
+BENCHMARK_TEMPLATE(BM_TypeText, char);
+BENCHMARK_TEMPLATE(BM_TypeText, wchar_t);
+BENCHMARK_TEMPLATE(BM_TypeText, char16_t);
+BENCHMARK_TEMPLATE(BM_TypeText, char, HumanAdvancedProfile);
+
+// Keystrokes spread over many engines, one chunk each in turn, the way a
+// host serving many sessions would run them. With a single engine its state
+// stays in L1; with thousands each chunk starts from cold state, so the
+// time per keystroke follows how many cache lines a keystroke touches.
+// hot_lines is the size of the engine's per-run block in cache lines.
+template<typename Profile>
+static void BM_KeystrokeFootprint(benchmark::State& state) {
+    using Engine = TypingEngine<char, CharTraits<char>, Profile>;
+    const size_t engineCount = static_cast<size_t>(state.range(0));
+    const std::string text = corpus().substr(0, 256);
+
+    NullKeyboard<char> keyboard;
+    ImperfectionSettings imperfections;
+    imperfections.enableTypos = false;       // Corrections sleep
+    imperfections.enableDoubleKeys = false;
+
+    std::vector<std::unique_ptr<Engine>> engines;
+    for (size_t i = 0; i < engineCount; i++) {
+        engines.push_back(std::make_unique<Engine>(
+            &keyboard, nullptr, TimingProfile::humanAdvanced(), DelayRange{80, 180},
+            imperfections));
+        engines.back()->seed(i + 1);
+        engines.back()->setText(text);
+    }
+
+    int64_t keystrokes = 0;
+    size_t i = 0;
+    for (auto _ : state) {
+        Engine& engine = *engines[i];
+        if (!engine.hasMoreToType()) engine.setText(text);
+
+        int before = engine.currentPosition();
+        benchmark::DoNotOptimize(engine.typeNextChunk());
+        keystrokes += engine.currentPosition() - before;
+        if (++i == engineCount) i = 0;
+    }
+    state.SetItemsProcessed(keystrokes);
+    state.counters["hot_lines"] = double(Engine::hotStateSize() / TypingConstants::CACHE_LINE_BYTES);
+}
+BENCHMARK_TEMPLATE(BM_KeystrokeFootprint, DynamicProfile)->Arg(1)->Arg(16384);
+BENCHMARK_TEMPLATE(BM_KeystrokeFootprint, HumanAdvancedProfile)->Arg(1)->Arg(16384);
+
+// ============================================================================
+// Session host
+// ============================================================================
+
+// 256 sessions of 512 characters on a pool of range(0) workers, with typing
+// time scaled down 10000x so the pool, not the delays, sets the pace.
+// items/s is keystrokes per second across all sessions; compare the worker
+// counts against the machine's core count.
+static void BM_SessionHost(benchmark::State& state) {
+    const std::string text = corpus().substr(0, 512);
+    std::vector<NullKeyboard<char>> keyboards(256);
+    ImperfectionSettings imperfections;
+    imperfections.enableTypos = false;
+    imperfections.enableDoubleKeys = false;
+
+    SessionHostOptions options;
+    options.workers = static_cast<int>(state.range(0));
+    options.seed = 1;
+    options.timeScale = 1e-4;
+
+    int64_t keystrokes = 0;
+    uint64_t steals = 0;
+    for (auto _ : state) {
+        SessionHost<char> host(options);
+        for (NullKeyboard<char>& keyboard : keyboards) {
+            host.addSession(&keyboard, text, TimingProfile::humanAdvanced(),
+                            DelayRange{80, 180}, imperfections);
+        }
+        host.wait();
+        keystrokes += host.keystrokes();
+        steals += host.steals();
+    }
+    state.SetItemsProcessed(keystrokes);
+    state.counters["steals"] = benchmark::Counter(double(steals), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SessionHost)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// Pipeline
+// ============================================================================
+
+// What the player pays per planned event: one pop from the ring. Compare
+// with BM_TypeText, which is what every keystroke costs when planning runs
+// on the injecting thread.
+static void BM_SpscRingHandoff(benchmark::State& state) {
+    SpscRing<PlannedEvent<char>> ring(TypingConstants::PIPELINE_RING_EVENTS);
+    PlannedEvent<char> event;
+    event.kind = PlannedEvent<char>::Type;
+    for (auto _ : state) {
+        ring.tryPush(event);
+        ring.tryPop(event);
+        benchmark::DoNotOptimize(event);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpscRingHandoff);
+
+// ============================================================================
+// Plan cache
+// ============================================================================
+
+// Never waits, so setting up a plan doesn't take the corpus's typing time
+class InstantClock : public IClock {
+public:
+    int64_t nowUs() const override { return 0; }
+    void sleepUntilUs(int64_t) override {}
+    bool waitUntilUs(int64_t, CancellationToken& token) override { return !token.isCancelled(); }
+};
+
+// A repeat run's planning cost: map the corpus's stored plan, validate it
+// and read every event. items/s is keystrokes per second; compare with
+// BM_TypeText, which plans them.
+static void BM_PlanCacheHit(benchmark::State& state) {
+    const std::string& text = corpus();
+    NullKeyboard<char> keyboard;
+    InstantClock clock;
+    PlanSettings settings;
+    settings.profile = TimingProfile::humanAdvanced();
+    settings.delays = DelayRange{80, 180};
+    settings.imperfections.enableTypos = false;
+    settings.imperfections.enableDoubleKeys = false;
+    settings.seed = 1;
+
+    PlanCache cache("qtype_bench_plans");
+    uint64_t key = planKey(text.data(), text.size(), settings, keyboard);
+    {
+        TypingPipeline<char> pipeline(&keyboard, nullptr, settings.profile, settings.delays,
+                                      settings.imperfections);
+        pipeline.setClock(&clock);
+        pipeline.engine().seed(settings.seed);
+        CancellationToken stop;
+        pipeline.run(text, key, cache, stop);
+    }
+
+    size_t events = 0;
+    for (auto _ : state) {
+        PlanView plan;
+        if (!cache.load(key, plan)) {
+            state.SkipWithError("plan was not stored");
+            break;
+        }
+        int64_t last = 0;
+        for (const PlanRecord& record : plan) last += record.atUs;
+        benchmark::DoNotOptimize(last);
+        events = plan.size();
+    }
+    state.SetItemsProcessed(state.iterations() * text.size());
+    state.counters["events"] = double(events);
+}
+BENCHMARK(BM_PlanCacheHit);
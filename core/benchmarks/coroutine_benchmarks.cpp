@@ -0,0 +1,124 @@
+// coroutine_benchmarks.cpp - Blocking vs coroutine engines, many sessions (C++20)
+// Run: ./qtype_core_coroutine_benchmarks [--benchmark_filter=<regex>]
+//
+// Both variants type the same sessions on a clock running 1000x fast. The
+// blocking one needs a thread per session; the coroutine one runs them all
+// on the benchmark thread. "threads" counts the threads typing, "switches"
+// the context switches of the whole process (getrusage) per iteration.
+#include "coroutine_engine.h"
+#include "session_host.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <sys/resource.h>
+#include <vector>
+
+using namespace qtype;
+
+namespace {
+
+constexpr double TIME_SCALE = 1e-3;
+
+const std::string TEXT =
+    "Many sessions typing at once, each waiting out its holds and pauses. "
+    "The question is what those waits cost the process. ";
+
+// Waits out each hold on its clock, like the ydotoold and XTest simulators
+class HoldingKeyboard : public IKeyboardSimulator<char> {
+public:
+    explicit HoldingKeyboard(IClock* clock = nullptr) : clock_(clock) {}
+
+    void setClock(IClock* clock) { clock_ = clock; }
+
+    void typeCharacter(char c, int holdTimeMs) override {
+        benchmark::DoNotOptimize(c);
+        clock_->sleepForMs(holdTimeMs);
+    }
+    void pressBackspace() override { clock_->sleepForMs(TypingConstants::BACKSPACE_HOLD_MS); }
+    void releaseAllKeys() override {}
+
+private:
+    IClock* clock_;
+};
+
+int64_t contextSwitches() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+void report(benchmark::State& state, int threads, int64_t switches, int64_t keystrokes) {
+    state.SetItemsProcessed(keystrokes);
+    state.counters["threads"] = threads;
+    state.counters["switches"] = benchmark::Counter(double(switches), benchmark::Counter::kAvgIterations);
+}
+
+} // namespace
+
+static void BM_BlockingSessions(benchmark::State& state) {
+    int sessions = static_cast<int>(state.range(0));
+    int64_t switches = 0;
+    int64_t keystrokes = 0;
+
+    for (auto _ : state) {
+        ScaledClock clock(systemClock(), TIME_SCALE);
+        int64_t before = contextSwitches();
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < sessions; i++) {
+            threads.emplace_back([&clock, i] {
+                HoldingKeyboard keyboard(&clock);
+                TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                          DelayRange{80, 180}, ImperfectionSettings());
+                engine.setClock(&clock);
+                engine.seed(uint64_t(i) + 1);
+                engine.setText(TEXT);
+                while (engine.hasMoreToType()) {
+                    clock.sleepForMs(engine.typeNextChunk());
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+
+        switches += contextSwitches() - before;
+        keystrokes += int64_t(sessions) * int64_t(TEXT.size());
+    }
+    report(state, sessions, switches, keystrokes);
+}
+BENCHMARK(BM_BlockingSessions)->Arg(1)->Arg(8)->Arg(32)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_CoroutineSessions(benchmark::State& state) {
+    int sessions = static_cast<int>(state.range(0));
+    int64_t switches = 0;
+    int64_t keystrokes = 0;
+
+    for (auto _ : state) {
+        ScaledClock clock(systemClock(), TIME_SCALE);
+        EventTimers timers(clock);
+        int64_t before = contextSwitches();
+
+        using Engine = CoroutineTypingEngine<char>;
+        std::vector<HoldingKeyboard> keyboards(sessions);
+        std::vector<std::unique_ptr<Engine>> engines;
+        int running = sessions;
+        for (int i = 0; i < sessions; i++) {
+            engines.push_back(std::make_unique<Engine>(&keyboards[i], nullptr, TimingProfile::humanAdvanced(),
+                                                       DelayRange{80, 180}, ImperfectionSettings()));
+            keyboards[i].setClock(&engines[i]->holdClock());
+            engines[i]->engine().seed(uint64_t(i) + 1);
+            engines[i]->engine().setText(TEXT);
+            engines[i]->start(timers, [&running] { running--; });
+        }
+
+        // The frontend's loop: one wakeup source for every session
+        while (running > 0) {
+            int ms = timers.msUntilNextRun();
+            if (ms > 0) clock.sleepUntilUs(clock.nowUs() + int64_t(ms) * 1000);
+            timers.run();
+        }
+
+        switches += contextSwitches() - before;
+        keystrokes += int64_t(sessions) * int64_t(TEXT.size());
+    }
+    report(state, 1, switches, keystrokes);
+}
+BENCHMARK(BM_CoroutineSessions)->Arg(1)->Arg(8)->Arg(32)->UseRealTime()->Unit(benchmark::kMillisecond);
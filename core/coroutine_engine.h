@@ -0,0 +1,283 @@
+// coroutine_engine.h - TypingEngine that yields at its waits (C++20)
+//
+// The blocking engine sleeps inside a chunk (double keys, corrections) and
+// its simulators sleep through every hold, so a frontend either gives it a
+// thread or stalls its event loop. CoroutineTypingEngine runs the same engine
+// as a coroutine on the loop's EventTimers instead: every wait is a co_await
+// on one timer, and typing shares the thread with networking and UI.
+//
+// Only built by C++20 translation units; the rest of the core stays C++17.
+#ifndef COROUTINE_ENGINE_H
+#define COROUTINE_ENGINE_H
+
+#include "typing_core.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+
+namespace qtype {
+
+// ============================================================================
+// Coroutine Task
+// ============================================================================
+
+// Starts running when called and stays suspended at its end, so the owner
+// can see that it finished. Destroying it destroys the coroutine.
+class TypingTask {
+public:
+    struct promise_type {
+        TypingTask get_return_object() {
+            return TypingTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    TypingTask() = default;
+    TypingTask(TypingTask&& other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    TypingTask& operator=(TypingTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
+        return *this;
+    }
+    ~TypingTask() {
+        if (handle_) handle_.destroy();
+    }
+
+    bool done() const { return !handle_ || handle_.done(); }
+
+private:
+    explicit TypingTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// ============================================================================
+// Coroutine Engine
+// ============================================================================
+
+// Each chunk is first planned by the wrapped TypingEngine against a recorder
+// that stands in for both the simulator and the clock, then played on the
+// real simulator with a co_await at every pause. Holds become co_awaits too
+// when the simulator waits on holdClock() (the ydotoold, XTest and test
+// simulators take a clock); simulators that sleep on their own still block.
+template<typename CharT, typename Traits = CharTraits<CharT>,
+         typename Profile = DynamicProfile>
+class CoroutineTypingEngine {
+public:
+    using Engine = TypingEngine<CharT, Traits, Profile>;
+
+    CoroutineTypingEngine(IKeyboardSimulator<CharT, Traits>* simulator,
+                          IMouseSimulator* mouseSimulator,
+                          const TimingProfile& profile,
+                          const DelayRange& delays,
+                          const ImperfectionSettings& imperfections,
+                          KeyboardLayoutType layout = KeyboardLayoutType::US_QWERTY)
+        : simulator_(simulator)
+        , recorder_(*this)
+        , engine_(&recorder_, mouseSimulator, profile, delays, imperfections, layout)
+    {
+        engine_.setClock(&recorder_);
+        engine_.setCancellationToken(&cancel_);
+        sleepTimer_.callback = [this] { resumeWaiting(); };
+    }
+
+    // Stops a running task first
+    ~CoroutineTypingEngine() { stop(); }
+
+    CoroutineTypingEngine(const CoroutineTypingEngine&) = delete;
+    CoroutineTypingEngine& operator=(const CoroutineTypingEngine&) = delete;
+
+    // Text, resume, checkpoints and seeds; its clock and token are ours
+    Engine& engine() { return engine_; }
+
+    // Give this to a simulator that waits its holds on an IClock
+    IClock& holdClock() { return holdClock_; }
+
+    // Types the text on timers' thread until it is done or stopped, then
+    // calls onFinished. Returns at the first wait.
+    void start(EventTimers& timers, std::function<void()> onFinished = {}) {
+        stop();
+        cancel_.reset();
+        timers_ = &timers;
+        holdClock_.setBase(timers.clock());
+        task_ = play(std::move(onFinished));
+    }
+
+    // Ends the run after the keystroke in progress. A sleeping task wakes at
+    // once, flushes and finishes before this returns.
+    void stop() {
+        if (task_.done()) return;
+        cancel_.cancel();
+        if (waiting_) {
+            timers_->stop(sleepTimer_);
+            resumeWaiting();
+        }
+    }
+
+    bool isRunning() const { return !task_.done(); }
+
+private:
+    // One step of a planned chunk
+    struct Action {
+        enum Kind : uint8_t { Type, Backspace, Flush, Wait, Done };
+        Kind kind;
+        CharT character;
+        int ms;                 // Hold for Type, pause for Wait
+    };
+
+    // Stands in for the simulator and the clock while the engine plans a
+    // chunk: keystrokes and pauses are recorded, time only moves on paper
+    class Recorder : public IKeyboardSimulator<CharT, Traits>, public IClock {
+    public:
+        explicit Recorder(CoroutineTypingEngine& owner) : owner_(owner) {}
+
+        void typeCharacter(CharT c, int holdTimeMs) override {
+            owner_.plan_.push_back({Action::Type, c, holdTimeMs});
+        }
+        void pressBackspace() override { owner_.plan_.push_back({Action::Backspace, CharT(), 0}); }
+        void releaseAllKeys() override { owner_.simulator_->releaseAllKeys(); }
+        void flush() override { owner_.plan_.push_back({Action::Flush, CharT(), 0}); }
+        void characterDone() override { owner_.plan_.push_back({Action::Done, CharT(), 0}); }
+        bool canType(CharT c) const override { return owner_.simulator_->canType(c); }
+
+        int64_t nowUs() const override { return nowUs_; }
+        void sleepUntilUs(int64_t deadlineUs) override {
+            int ms = static_cast<int>((deadlineUs - nowUs_ + 999) / 1000);
+            owner_.plan_.push_back({Action::Wait, CharT(), ms});
+            nowUs_ = std::max(nowUs_, deadlineUs);
+        }
+
+    private:
+        CoroutineTypingEngine& owner_;
+        int64_t nowUs_ = 0;
+    };
+
+    // Reads the base clock, but a sleep only adds up what is owed; the
+    // coroutine then awaits the total
+    class DeferredClock : public IClock {
+    public:
+        void setBase(IClock& base) { base_ = &base; }
+
+        int64_t nowUs() const override { return base_->nowUs() + owedUs_; }
+        void sleepUntilUs(int64_t deadlineUs) override {
+            owedUs_ += std::max<int64_t>(0, deadlineUs - nowUs());
+        }
+
+        int takeMs() {
+            int ms = static_cast<int>((owedUs_ + 999) / 1000);
+            owedUs_ = 0;
+            return ms;
+        }
+
+    private:
+        IClock* base_ = &systemClock();
+        int64_t owedUs_ = 0;
+    };
+
+    struct Sleep {
+        CoroutineTypingEngine& owner;
+        int ms;
+
+        bool await_ready() const { return ms <= 0 || owner.cancel_.isCancelled(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            owner.waiting_ = handle;
+            owner.timers_->start(owner.sleepTimer_, ms);
+        }
+        void await_resume() const {}
+    };
+
+    IKeyboardSimulator<CharT, Traits>* simulator_;
+    std::vector<Action> plan_;          // Reused, so chunks don't allocate
+    Recorder recorder_;
+    Engine engine_;
+    DeferredClock holdClock_;
+    CancellationToken cancel_;
+
+    EventTimers* timers_ = nullptr;
+    TimingWheel::Timer sleepTimer_;     // Its callback is set once: it may run while we re-arm it
+    std::coroutine_handle<> waiting_;
+    TypingTask task_;                   // Last: destroyed before what it uses
+
+    Sleep sleepFor(int ms) { return Sleep{*this, ms}; }
+
+    void resumeWaiting() {
+        std::coroutine_handle<> handle = waiting_;
+        waiting_ = nullptr;
+        if (handle) handle.resume();
+    }
+
+    TypingTask play(std::function<void()> onFinished) {
+        while (engine_.hasMoreToType() && !cancel_.isCancelled()) {
+            plan_.clear();
+            int chunkStart = engine_.currentPosition();
+            int delayMs = engine_.typeNextChunk();
+
+            int done = 0;               // Characters of the chunk played in full
+            bool typed = false;         // Keys of the current character so far
+            bool erased = false;
+            size_t next = 0;
+            for (; next < plan_.size() && !cancel_.isCancelled(); ++next) {
+                const Action& action = plan_[next];
+                switch (action.kind) {
+                    case Action::Type:
+                        typed = true;
+                        simulator_->typeCharacter(action.character, action.ms);
+                        co_await sleepFor(holdClock_.takeMs());
+                        break;
+                    case Action::Backspace:
+                        erased = true;
+                        simulator_->pressBackspace();
+                        co_await sleepFor(holdClock_.takeMs());
+                        break;
+                    case Action::Flush:
+                        simulator_->flush();
+                        break;
+                    case Action::Wait:
+                        co_await sleepFor(action.ms);
+                        break;
+                    case Action::Done:
+                        done++;
+                        typed = erased = false;
+                        break;
+                }
+            }
+
+            // Stopped part-way through a character: a typo waiting for its
+            // correction is taken back, as the blocking engine does. The
+            // character counts as typed only if it is on screen, and the
+            // engine moves back to the first one that isn't, so the next run
+            // and a checkpoint taken now continue there.
+            if (next < plan_.size()) {
+                bool retype = false;
+                for (; next < plan_.size() && plan_[next].kind != Action::Done; ++next) {
+                    if (plan_[next].kind == Action::Backspace) {
+                        simulator_->pressBackspace();
+                        erased = true;
+                    }
+                    if (plan_[next].kind == Action::Type) retype = true;
+                }
+                if (typed && (!retype || !erased)) done++;
+                engine_.seek(chunkStart + done);
+            }
+            simulator_->flush();
+
+            co_await sleepFor(delayMs);
+        }
+        simulator_->flush();
+        holdClock_.takeMs();
+        if (onFinished) onFinished();
+    }
+};
+
+} // namespace qtype
+
+#endif // __cpp_impl_coroutine
+
+#endif // COROUTINE_ENGINE_H
@@ -0,0 +1,372 @@
+// plan_cache.cpp - Plan files: layout, validation and eviction
+#include "plan_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace qtype {
+
+namespace {
+
+constexpr char PLAN_MAGIC[8] = {'Q', 'T', 'P', 'L', 'A', 'N', '\0', '\0'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr const char* PLAN_EXTENSION = ".qtplan";
+
+// Fills a cache line, so the records after it stay 8-byte aligned
+struct PlanFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;         // BYTE_ORDER_MARK as the writer stored it
+    uint64_t key;
+    uint64_t count;
+    uint64_t checksum;          // Over the records
+    uint32_t recordSize;
+    uint8_t reserved[20];
+};
+
+static_assert(sizeof(PlanFileHeader) == 64, "plan header is one cache line");
+
+uint64_t mix(uint64_t hash, uint64_t value) {
+    return (hash ^ value) * 0x100000001B3ull;
+}
+
+uint64_t mixDouble(uint64_t hash, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return mix(hash, bits);
+}
+
+// A word at a time, so checking a hit costs far less than planning it again
+uint64_t checksum(const PlanRecord* records, size_t count) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(records);
+    size_t words = count * sizeof(PlanRecord) / sizeof(uint64_t);
+    uint64_t hash = detail::FNV_OFFSET;
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * sizeof word, sizeof word);
+        hash = mix(hash, word);
+    }
+    return hash;
+}
+
+// The record count if the header belongs to this build and to key, and
+// says the file is fileBytes long; -1 otherwise
+int64_t checkHeader(const PlanFileHeader& header, uint64_t key, uint64_t fileBytes) {
+    if (std::memcmp(header.magic, PLAN_MAGIC, sizeof PLAN_MAGIC) != 0) return -1;
+    if (header.version != TypingConstants::PLAN_FORMAT_VERSION) return -1;
+    if (header.byteOrder != BYTE_ORDER_MARK) return -1;
+    if (header.recordSize != sizeof(PlanRecord)) return -1;
+    if (header.key != key) return -1;
+    if (header.count > (fileBytes - sizeof header) / sizeof(PlanRecord)) return -1;
+    if (sizeof header + header.count * sizeof(PlanRecord) != fileBytes) return -1;
+    return static_cast<int64_t>(header.count);
+}
+
+enum class ReadResult { Missing, Invalid, Ok };
+
+#ifndef _WIN32
+
+ReadResult readPlan(const std::string& path, uint64_t key, void*& mapping, size_t& mappedBytes,
+                    const PlanRecord*& records, size_t& count) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return ReadResult::Missing;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(PlanFileHeader))) {
+        close(fd);
+        return ReadResult::Invalid;
+    }
+    size_t bytes = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                  // The mapping keeps the file
+    if (data == MAP_FAILED) return ReadResult::Invalid;
+
+    PlanFileHeader header;
+    std::memcpy(&header, data, sizeof header);
+    int64_t recordCount = checkHeader(header, key, bytes);
+    const PlanRecord* first = reinterpret_cast<const PlanRecord*>(
+        static_cast<const unsigned char*>(data) + sizeof header);
+    if (recordCount < 0 || checksum(first, size_t(recordCount)) != header.checksum) {
+        munmap(data, bytes);
+        return ReadResult::Invalid;
+    }
+
+    mapping = data;
+    mappedBytes = bytes;
+    records = first;
+    count = size_t(recordCount);
+    return ReadResult::Ok;
+}
+
+#else
+
+ReadResult readPlan(const std::string& path, uint64_t key, std::vector<PlanRecord>& copy) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return ReadResult::Missing;
+
+    uint64_t bytes = static_cast<uint64_t>(file.tellg());
+    if (bytes < sizeof(PlanFileHeader)) return ReadResult::Invalid;
+    file.seekg(0);
+
+    PlanFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof header);
+    int64_t recordCount = checkHeader(header, key, bytes);
+    if (!file || recordCount < 0) return ReadResult::Invalid;
+
+    copy.resize(size_t(recordCount));
+    file.read(reinterpret_cast<char*>(copy.data()),
+              static_cast<std::streamsize>(copy.size() * sizeof(PlanRecord)));
+    if (!file || checksum(copy.data(), copy.size()) != header.checksum) return ReadResult::Invalid;
+    return ReadResult::Ok;
+}
+
+#endif
+
+// Plan files in the directory with their key, size and last use
+struct Entry {
+    fs::path path;
+    uint64_t key;
+    bool named;                 // The file name is a key
+    uint64_t bytes;
+    fs::file_time_type used;
+};
+
+std::vector<Entry> listEntries(const std::string& directory) {
+    std::vector<Entry> entries;
+    std::error_code error;
+    for (const fs::directory_entry& item : fs::directory_iterator(directory, error)) {
+        if (!item.is_regular_file(error) || item.path().extension() != PLAN_EXTENSION) continue;
+
+        Entry entry;
+        entry.path = item.path();
+        std::string stem = entry.path.stem().string();
+        char* end = nullptr;
+        entry.key = std::strtoull(stem.c_str(), &end, 16);
+        entry.named = stem.size() == 16 && end && *end == '\0';
+        entry.bytes = item.file_size(error);
+        entry.used = item.last_write_time(error);
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+} // namespace
+
+namespace detail {
+
+uint64_t hashPlanSettings(uint64_t hash, const PlanSettings& settings) {
+    const TimingProfile& p = settings.profile;
+    hash = mixDouble(hash, p.baseSpeedFactor);
+    hash = mixDouble(hash, p.microStutterProb);
+    hash = mixDouble(hash, p.idlePauseProb);
+    hash = mixDouble(hash, p.burstProb);
+    hash = mix(hash, uint64_t(p.burstMin));
+    hash = mix(hash, uint64_t(p.burstMax));
+    hash = mixDouble(hash, p.gammaShape);
+    hash = mixDouble(hash, p.gammaScale);
+    hash = mixDouble(hash, p.noiseLevel);
+
+    hash = mix(hash, uint64_t(settings.delays.minMs));
+    hash = mix(hash, uint64_t(settings.delays.maxMs));
+
+    const ImperfectionSettings& i = settings.imperfections;
+    hash = mix(hash, i.enableTypos);
+    hash = mix(hash, uint64_t(i.typoMin));
+    hash = mix(hash, uint64_t(i.typoMax));
+    hash = mix(hash, i.enableDoubleKeys);
+    hash = mix(hash, uint64_t(i.doubleMin));
+    hash = mix(hash, uint64_t(i.doubleMax));
+    hash = mix(hash, i.enableAutoCorrection);
+    hash = mix(hash, uint64_t(i.correctionProbability));
+
+    hash = mix(hash, uint64_t(settings.layout));
+    hash = mix(hash, settings.seed);
+    hash = mix(hash, settings.mouseMovement);
+    return hash;
+}
+
+} // namespace detail
+
+// ============================================================================
+// PlanView
+// ============================================================================
+
+PlanView& PlanView::operator=(PlanView&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    mapping_ = other.mapping_;
+    mappedBytes_ = other.mappedBytes_;
+    copy_ = std::move(other.copy_);
+    count_ = other.count_;
+    records_ = mapping_ ? other.records_ : copy_.data();
+
+    other.mapping_ = nullptr;
+    other.mappedBytes_ = 0;
+    other.copy_.clear();
+    other.records_ = nullptr;
+    other.count_ = 0;
+    return *this;
+}
+
+void PlanView::release() {
+#ifndef _WIN32
+    if (mapping_) munmap(mapping_, mappedBytes_);
+#endif
+    mapping_ = nullptr;
+    mappedBytes_ = 0;
+    copy_.clear();
+    records_ = nullptr;
+    count_ = 0;
+}
+
+// ============================================================================
+// PlanCache
+// ============================================================================
+
+PlanCache::PlanCache(std::string directory, uint64_t maxBytes)
+    : directory_(std::move(directory))
+    , maxBytes_(maxBytes)
+{}
+
+std::string PlanCache::pathFor(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof name, "%016llx%s", static_cast<unsigned long long>(key), PLAN_EXTENSION);
+    return (fs::path(directory_) / name).string();
+}
+
+bool PlanCache::load(uint64_t key, PlanView& out) {
+    std::string path = pathFor(key);
+    PlanView view;
+#ifndef _WIN32
+    ReadResult result = readPlan(path, key, view.mapping_, view.mappedBytes_, view.records_, view.count_);
+#else
+    ReadResult result = readPlan(path, key, view.copy_);
+    view.records_ = view.copy_.data();
+    view.count_ = view.copy_.size();
+#endif
+    if (result != ReadResult::Ok) {
+        if (result == ReadResult::Invalid) std::remove(path.c_str());
+        misses_++;
+        return false;
+    }
+
+    // The modification time is the entry's last use
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    hits_++;
+    out = std::move(view);
+    return true;
+}
+
+bool PlanCache::store(uint64_t key, const PlanRecord* records, size_t count) {
+    uint64_t bytes = sizeof(PlanFileHeader) + uint64_t(count) * sizeof(PlanRecord);
+    if (bytes > maxBytes_) return false;
+
+    std::error_code error;
+    fs::create_directories(directory_, error);
+
+    PlanFileHeader header = {};
+    std::memcpy(header.magic, PLAN_MAGIC, sizeof PLAN_MAGIC);
+    header.version = TypingConstants::PLAN_FORMAT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.key = key;
+    header.count = count;
+    header.checksum = checksum(records, count);
+    header.recordSize = sizeof(PlanRecord);
+
+    // Unique per writer, so processes sharing the directory don't collide
+    std::string path = pathFor(key);
+    std::string tmpPath = path + ".tmp" +
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                       uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()));
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof header);
+        file.write(reinterpret_cast<const char*>(records),
+                   static_cast<std::streamsize>(count * sizeof(PlanRecord)));
+        if (!file.flush()) {
+            file.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());      // rename() doesn't replace on Windows
+#endif
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+size_t PlanCache::validate() {
+    size_t removed = 0;
+    for (const Entry& entry : listEntries(directory_)) {
+        bool valid = entry.named;
+        if (valid) {
+#ifndef _WIN32
+            void* mapping = nullptr;
+            size_t mappedBytes = 0;
+            const PlanRecord* records = nullptr;
+            size_t count = 0;
+            valid = readPlan(entry.path.string(), entry.key, mapping, mappedBytes, records, count) ==
+                    ReadResult::Ok;
+            if (mapping) munmap(mapping, mappedBytes);
+#else
+            std::vector<PlanRecord> copy;
+            valid = readPlan(entry.path.string(), entry.key, copy) == ReadResult::Ok;
+#endif
+        }
+        if (!valid) {
+            std::error_code error;
+            if (fs::remove(entry.path, error)) removed++;
+        }
+    }
+    return removed + evict();
+}
+
+uint64_t PlanCache::sizeBytes() const {
+    uint64_t total = 0;
+    for (const Entry& entry : listEntries(directory_)) total += entry.bytes;
+    return total;
+}
+
+// Oldest use first until the rest fits
+size_t PlanCache::evict() {
+    std::vector<Entry> entries = listEntries(directory_);
+    uint64_t total = 0;
+    for (const Entry& entry : entries) total += entry.bytes;
+    if (total <= maxBytes_) return 0;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.used < b.used; });
+
+    size_t removed = 0;
+    for (const Entry& entry : entries) {
+        if (total <= maxBytes_) break;
+        std::error_code error;
+        if (fs::remove(entry.path, error)) {
+            total -= entry.bytes;
+            removed++;
+        }
+    }
+    return removed;
+}
+
+} // namespace qtype
@@ -0,0 +1,150 @@
+// plan_cache.h - Planned event timelines kept on disk between runs
+//
+// Planning a text (chunking, imperfections, dynamics, the random stream) is
+// a pure function of the text, the settings and the seed. When the same
+// document is typed again with all of those unchanged, the timeline planned
+// last time can be played as it is. PlanCache keeps such timelines as flat
+// files named after a hash of their inputs; a file is a header and an array
+// of fixed-size records, so a hit is mapped and played without parsing.
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include "typing_core.h"
+
+namespace qtype {
+
+// ============================================================================
+// Plan Records
+// ============================================================================
+
+// One planned event as stored in the file, in host byte order
+struct PlanRecord {
+    int64_t atUs = 0;           // When to play it, from the start of the run
+    uint32_t code = 0;          // Character code unit
+    int32_t value = 0;          // As PlannedEvent::value
+    int32_t deltaY = 0;
+    uint8_t kind = 0;           // PlannedEvent::Kind
+    uint8_t reserved[3] = {};
+};
+
+static_assert(sizeof(PlanRecord) == 24, "plan records are laid out for mapping");
+
+// A plan loaded from the cache: mapped read-only where the platform can,
+// read into memory elsewhere. Valid until destroyed, even if the entry is
+// evicted meanwhile.
+class PlanView {
+public:
+    PlanView() = default;
+    ~PlanView() { release(); }
+
+    PlanView(PlanView&& other) noexcept { *this = std::move(other); }
+    PlanView& operator=(PlanView&& other) noexcept;
+
+    PlanView(const PlanView&) = delete;
+    PlanView& operator=(const PlanView&) = delete;
+
+    const PlanRecord* begin() const { return records_; }
+    const PlanRecord* end() const { return records_ + count_; }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+private:
+    friend class PlanCache;
+
+    void* mapping_ = nullptr;
+    size_t mappedBytes_ = 0;
+    std::vector<PlanRecord> copy_;
+    const PlanRecord* records_ = nullptr;
+    size_t count_ = 0;
+
+    void release();
+};
+
+// ============================================================================
+// Cache Keys
+// ============================================================================
+
+// Everything besides the text that decides what a run plans
+struct PlanSettings {
+    TimingProfile profile;          // For StaticProfile engines, the type's profile
+    DelayRange delays;
+    ImperfectionSettings imperfections;
+    KeyboardLayoutType layout = KeyboardLayoutType::US_QWERTY;
+    uint64_t seed = 0;
+    bool mouseMovement = false;
+};
+
+namespace detail {
+    uint64_t hashPlanSettings(uint64_t hash, const PlanSettings& settings);
+}
+
+// Hash of a run's inputs. Which characters the backend can type is part of
+// it: the engine skips the others, which changes the plan.
+template<typename CharT, typename Traits>
+uint64_t planKey(const CharT* text, size_t length, const PlanSettings& settings,
+                 const IKeyboardSimulator<CharT, Traits>& backend) {
+    uint64_t hash = detail::FNV_OFFSET;
+    for (size_t i = 0; i < length; ++i) {
+        uint64_t code = Traits::code(text[i]);
+        if (!backend.canType(text[i])) code |= uint64_t(1) << 32;
+        hash = (hash ^ code) * 0x100000001B3ull;
+    }
+    hash = (hash ^ sizeof(CharT)) * 0x100000001B3ull;
+    hash = (hash ^ length) * 0x100000001B3ull;
+    return detail::hashPlanSettings(hash, settings);
+}
+
+template<typename CharT, typename Traits>
+uint64_t planKey(const typename Traits::String& text, const PlanSettings& settings,
+                 const IKeyboardSimulator<CharT, Traits>& backend) {
+    return planKey<CharT, Traits>(text.data(), static_cast<size_t>(text.size()), settings, backend);
+}
+
+// ============================================================================
+// Plan Cache
+// ============================================================================
+
+// A directory of plan files, trimmed to a byte budget by evicting the least
+// recently used (by modification time, which a hit refreshes). Several
+// processes may share one directory: files are written to a temporary name
+// and renamed into place.
+class PlanCache {
+public:
+    explicit PlanCache(std::string directory,
+                       uint64_t maxBytes = TypingConstants::PLAN_CACHE_MAX_BYTES);
+
+    const std::string& directory() const { return directory_; }
+    uint64_t maxBytes() const { return maxBytes_; }
+    std::string pathFor(uint64_t key) const;
+
+    // The plan stored under key. An entry that fails validation (another
+    // format version or byte order, truncated, checksum mismatch) is
+    // deleted and counts as a miss.
+    bool load(uint64_t key, PlanView& out);
+
+    // Writes the plan, then evicts until the cache fits its budget again.
+    // False if it couldn't be written or is larger than the whole budget.
+    bool store(uint64_t key, const PlanRecord* records, size_t count);
+
+    // Checks every entry, deletes the ones load() would reject, and trims
+    // to the budget. Returns how many entries were removed.
+    size_t validate();
+
+    // Bytes of all entries, as found on disk now
+    uint64_t sizeBytes() const;
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+private:
+    std::string directory_;
+    uint64_t maxBytes_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    size_t evict();
+};
+
+} // namespace qtype
+
+#endif // PLAN_CACHE_H
@@ -0,0 +1,148 @@
+// session_host.cpp - Timer thread and worker pool behind SessionHost
+#include "session_host.h"
+
+namespace qtype {
+namespace detail {
+
+namespace {
+    // Lets submit() find the calling worker's own deque
+    thread_local HostRuntime* currentRuntime = nullptr;
+    thread_local int currentWorker = -1;
+
+    // Idle threads wait with a timeout and look again. Untimed
+    // condition_variable::wait() needs GLIBCXX_3.4.30, newer than the
+    // runtime some of our toolchains ship.
+    constexpr std::chrono::milliseconds IDLE_RECHECK(250);
+}
+
+HostRuntime::HostRuntime(int workers, double timeScale)
+    : clock_(systemClock(), timeScale > 0.0 ? timeScale : 1.0)
+    , wheel_(nowMs())
+{
+    if (workers <= 0) {
+        workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < workers; i++) {
+        workers_.emplace_back();
+    }
+    for (int i = 0; i < workers; i++) {
+        workers_[i].thread = std::thread(&HostRuntime::workerLoop, this, i);
+    }
+    timerThread_ = std::thread(&HostRuntime::timerLoop, this);
+}
+
+HostRuntime::~HostRuntime() {
+    {
+        std::lock_guard<std::mutex> lock(wheelMutex_);
+        timerStopping_ = true;
+    }
+    wheelWake_.notify_one();
+    timerThread_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        stopping_ = true;
+    }
+    idleWake_.notify_all();
+    for (Worker& worker : workers_) {
+        worker.thread.join();
+    }
+}
+
+void HostRuntime::schedule(TimingWheel::Timer& timer, int64_t dueMs) {
+    std::lock_guard<std::mutex> lock(wheelMutex_);
+    wheel_.schedule(timer, dueMs);
+    if (timer.expiry() < plannedWakeup_) wheelWake_.notify_one();
+}
+
+bool HostRuntime::expedite(TimingWheel::Timer& timer) {
+    std::lock_guard<std::mutex> lock(wheelMutex_);
+    if (!timer.isScheduled()) return false;
+    wheel_.schedule(timer, wheel_.now() + 1);
+    wheelWake_.notify_one();
+    return true;
+}
+
+void HostRuntime::submit(Job job) {
+    int index = currentRuntime == this
+        ? currentWorker
+        : static_cast<int>(nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size());
+
+    // Counted before it is visible, so a worker that finds it never sees
+    // the count go negative
+    pending_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers_[index].mutex);
+        workers_[index].jobs.push_back(job);
+    }
+
+    // Pairs with the sleeping_/pending_ check in workerLoop(); both are
+    // sequentially consistent, so one side always sees the other
+    if (sleeping_.load() > 0) {
+        { std::lock_guard<std::mutex> lock(idleMutex_); }
+        idleWake_.notify_one();
+    }
+}
+
+void HostRuntime::timerLoop() {
+    std::unique_lock<std::mutex> lock(wheelMutex_);
+    while (!timerStopping_) {
+        // Callbacks only submit jobs, so they can run under the wheel lock
+        wheel_.advance(nowMs());
+
+        plannedWakeup_ = wheel_.nextWakeup();
+        if (plannedWakeup_ == INT64_MAX) {
+            wheelWake_.wait_for(lock, IDLE_RECHECK);
+        } else {
+            auto deadline = std::chrono::steady_clock::time_point(
+                std::chrono::microseconds(clock_.baseUs(plannedWakeup_ * 1000)));
+            wheelWake_.wait_until(lock, deadline);
+        }
+    }
+}
+
+void HostRuntime::workerLoop(int index) {
+    currentRuntime = this;
+    currentWorker = index;
+
+    for (;;) {
+        Job job;
+        if (popLocal(index, job) || steal(index, job)) {
+            pending_.fetch_sub(1);
+            job.run(job.context);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        sleeping_.fetch_add(1);
+        idleWake_.wait_for(lock, IDLE_RECHECK, [this] { return pending_.load() > 0 || stopping_; });
+        sleeping_.fetch_sub(1);
+        if (stopping_ && pending_.load() <= 0) return;
+    }
+}
+
+bool HostRuntime::popLocal(int index, Job& job) {
+    Worker& worker = workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.jobs.empty()) return false;
+    job = worker.jobs.front();
+    worker.jobs.pop_front();
+    return true;
+}
+
+bool HostRuntime::steal(int index, Job& job) {
+    int count = static_cast<int>(workers_.size());
+    for (int i = 1; i < count; i++) {
+        Worker& victim = workers_[(index + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+        job = victim.jobs.front();
+        victim.jobs.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+} // namespace detail
+} // namespace qtype
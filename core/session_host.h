@@ -0,0 +1,270 @@
+// session_host.h - Many independent typing sessions in one process
+//
+// For load-testing editors and UIs under simulated input: every session has
+// its own engine, keyboard sink and random stream, and all of them share one
+// timing wheel and a fixed pool of workers instead of a thread or timer each.
+#ifndef SESSION_HOST_H
+#define SESSION_HOST_H
+
+#include "typing_core.h"
+#include <deque>
+
+namespace qtype {
+
+// ============================================================================
+// Scaled Time
+// ============================================================================
+
+// A clock whose time runs 1/scale times as fast as the base clock's, so a
+// load test can play hours of typing in minutes. Sleeps are shortened to
+// match; scale 1 is real time.
+class ScaledClock : public IClock {
+public:
+    ScaledClock(IClock& base, double scale)
+        : base_(&base)
+        , scale_(scale)
+        , originUs_(base.nowUs())
+    {}
+
+    int64_t nowUs() const override {
+        return originUs_ + static_cast<int64_t>((base_->nowUs() - originUs_) / scale_);
+    }
+
+    void sleepUntilUs(int64_t deadlineUs) override { base_->sleepUntilUs(baseUs(deadlineUs)); }
+
+    bool waitUntilUs(int64_t deadlineUs, CancellationToken& token) override {
+        return base_->waitUntilUs(baseUs(deadlineUs), token);
+    }
+
+    // The base clock's time at which this clock reads us
+    int64_t baseUs(int64_t us) const {
+        return originUs_ + static_cast<int64_t>((us - originUs_) * scale_);
+    }
+
+private:
+    IClock* base_;
+    double scale_;
+    int64_t originUs_;
+};
+
+// ============================================================================
+// Host Runtime
+// ============================================================================
+
+namespace detail {
+    // The part of SessionHost that doesn't depend on the character type: a
+    // timer thread driving one TimingWheel (ticks are scaled milliseconds)
+    // and a fixed pool of work-stealing workers that run the due sessions.
+    class HostRuntime {
+    public:
+        struct Job {
+            void (*run)(void*);
+            void* context;
+        };
+
+        HostRuntime(int workers, double timeScale);
+        ~HostRuntime();     // Stops the timer thread, then drains and joins the workers
+
+        HostRuntime(const HostRuntime&) = delete;
+        HostRuntime& operator=(const HostRuntime&) = delete;
+
+        IClock& clock() { return clock_; }
+        int64_t nowMs() const { return clock_.nowUs() / 1000; }
+
+        // The timer's callback runs on the timer thread once dueMs is reached
+        void schedule(TimingWheel::Timer& timer, int64_t dueMs);
+        // Moves a scheduled timer to the next tick; false if it isn't scheduled
+        bool expedite(TimingWheel::Timer& timer);
+
+        // Queues a job. Called from a worker it goes on that worker's own
+        // queue, so a session stays where its state is cached; from other
+        // threads the jobs are dealt round robin. Queues run oldest first,
+        // and idle workers steal the oldest job from the others.
+        void submit(Job job);
+
+        int workerCount() const { return static_cast<int>(workers_.size()); }
+        uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            std::thread thread;
+        };
+
+        ScaledClock clock_;
+
+        std::mutex wheelMutex_;
+        std::condition_variable wheelWake_;
+        TimingWheel wheel_;
+        int64_t plannedWakeup_ = INT64_MAX;
+        bool timerStopping_ = false;
+        std::thread timerThread_;
+
+        std::deque<Worker> workers_;
+        std::atomic<int64_t> pending_{0};       // Queued, not yet taken
+        std::atomic<int> sleeping_{0};
+        std::atomic<uint32_t> nextWorker_{0};
+        std::atomic<uint64_t> steals_{0};
+        std::mutex idleMutex_;
+        std::condition_variable idleWake_;
+        bool stopping_ = false;
+
+        void timerLoop();
+        void workerLoop(int index);
+        bool popLocal(int index, Job& job);
+        bool steal(int index, Job& job);
+    };
+}
+
+// ============================================================================
+// Session Host
+// ============================================================================
+
+struct SessionHostOptions {
+    int workers = 0;            // 0: one per hardware thread
+    uint64_t seed = 0;          // Non-zero: every session types the same way on every run
+    double timeScale = 1.0;     // Real time per unit of typing time; below 1 runs faster
+};
+
+// Sessions start as soon as they are added. Each one's chunks run on some
+// worker, never two at once; between chunks a session only holds a timer in
+// the shared wheel. Pauses inside a chunk (double keys, corrections) run on
+// the host's clock and hold their worker.
+template<typename CharT, typename Traits = CharTraits<CharT>,
+         typename Profile = DynamicProfile>
+class SessionHost {
+public:
+    using Engine = TypingEngine<CharT, Traits, Profile>;
+    using String = typename Traits::String;
+
+    explicit SessionHost(const SessionHostOptions& options = SessionHostOptions())
+        : seed_(options.seed)
+        , runtime_(options.workers, options.timeScale)
+    {}
+
+    // Stops every session; returns once no worker touches them any more
+    ~SessionHost() { stopAll(); }
+
+    SessionHost(const SessionHost&) = delete;
+    SessionHost& operator=(const SessionHost&) = delete;
+
+    // Starts typing text into simulator, which must outlive the host.
+    // Returns the session's id.
+    int addSession(IKeyboardSimulator<CharT, Traits>* simulator,
+                   const String& text,
+                   const TimingProfile& profile,
+                   const DelayRange& delays,
+                   const ImperfectionSettings& imperfections,
+                   KeyboardLayoutType layout = KeyboardLayoutType::US_QWERTY) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int id = static_cast<int>(sessions_.size());
+        sessions_.emplace_back(*this, simulator, profile, delays, imperfections, layout);
+
+        Session& session = sessions_.back();
+        if (seed_) session.engine.seed(sessionSeed(seed_, id));
+        session.engine.setClock(&runtime_.clock());
+        session.engine.setCancellationToken(&session.stop);
+        session.engine.setText(text);
+        session.dueMs = runtime_.nowMs();
+
+        active_++;
+        runtime_.schedule(session.timer, session.dueMs);
+        return id;
+    }
+
+    // Ends the session after the keystroke in progress
+    void stop(int id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopLocked(sessions_.at(static_cast<size_t>(id)));
+    }
+
+    void stopAll() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Session& session : sessions_) stopLocked(session);
+    }
+
+    // Blocks until every session has finished or been stopped
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (active_ != 0) {
+            allDone_.wait_for(lock, std::chrono::milliseconds(250));    // Untimed wait: see session_host.cpp
+        }
+    }
+
+    size_t activeSessions() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return active_;
+    }
+
+    int64_t keystrokes() const { return keystrokes_.load(std::memory_order_relaxed); }
+    int workerCount() const { return runtime_.workerCount(); }
+    uint64_t steals() const { return runtime_.steals(); }
+
+private:
+    struct Session {
+        Session(SessionHost& host, IKeyboardSimulator<CharT, Traits>* simulator,
+                const TimingProfile& profile, const DelayRange& delays,
+                const ImperfectionSettings& imperfections, KeyboardLayoutType layout)
+            : host(host)
+            , engine(simulator, nullptr, profile, delays, imperfections, layout)
+            , timer([this] { this->host.runtime_.submit({&SessionHost::step, this}); })
+        {}
+
+        SessionHost& host;
+        Engine engine;
+        CancellationToken stop;
+        TimingWheel::Timer timer;
+        int64_t dueMs = 0;      // When the current chunk was due, in host ms
+    };
+
+    uint64_t seed_;
+    mutable std::mutex mutex_;
+    std::condition_variable allDone_;
+    std::deque<Session> sessions_;      // Never moves an element
+    size_t active_ = 0;
+    std::atomic<int64_t> keystrokes_{0};
+    detail::HostRuntime runtime_;       // Last: joined before the sessions go
+
+    // Independent streams from one seed
+    static uint64_t sessionSeed(uint64_t seed, int id) {
+        return seed ^ (uint64_t(id) + 1) * 0x9E3779B97F4A7C15ull;
+    }
+
+    void stopLocked(Session& session) {
+        session.stop.cancel();
+        // Waiting for its next chunk: wake it now so it can finish
+        runtime_.expedite(session.timer);
+    }
+
+    // One chunk on a worker, then the wait for the next goes back on the wheel
+    static void step(void* context) {
+        Session& session = *static_cast<Session*>(context);
+        SessionHost& host = session.host;
+        Engine& engine = session.engine;
+
+        if (!session.stop.isCancelled() && engine.hasMoreToType()) {
+            int before = engine.currentPosition();
+            int delayMs = engine.typeNextChunk();
+            host.keystrokes_.fetch_add(engine.currentPosition() - before, std::memory_order_relaxed);
+
+            if (!session.stop.isCancelled() && engine.hasMoreToType()) {
+                // Paced from when the chunk was due, so late starts catch up
+                session.dueMs += delayMs;
+                if (session.dueMs <= host.runtime_.nowMs()) {
+                    host.runtime_.submit({&SessionHost::step, &session});
+                } else {
+                    host.runtime_.schedule(session.timer, session.dueMs);
+                }
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(host.mutex_);
+        if (--host.active_ == 0) host.allDone_.notify_all();
+    }
+};
+
+} // namespace qtype
+
+#endif // SESSION_HOST_H
@@ -0,0 +1,1462 @@
+// core_tests.cpp - Google Test Unit Tests for the Qt-free typing core
+#include "typing_core.h"
+#include "plan_cache.h"
+#include "session_host.h"
+#include "typing_pipeline.h"
+#include "ydotool_socket.h"
+#include "x11_input.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/input.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef QTYPE_HAVE_XTEST
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#endif
+
+using namespace qtype;
+
+// Heap allocations made on this thread, for the no-allocation tests
+static thread_local int allocationCount = 0;
+
+void* operator new(std::size_t size) {
+    allocationCount++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Records keystrokes for any character type
+template<typename CharT>
+class RecordingKeyboard : public IKeyboardSimulator<CharT> {
+public:
+    std::basic_string<CharT> typed;
+    int backspaceCount = 0;
+    int flushCount = 0;
+    bool typeEverything = false;
+
+    void typeCharacter(CharT c, int holdTimeMs) override {
+        typed.push_back(c);
+    }
+
+    void pressBackspace() override {
+        backspaceCount++;
+        if (!typed.empty()) typed.pop_back();
+    }
+
+    void releaseAllKeys() override {}
+
+    void flush() override { flushCount++; }
+
+    bool canType(CharT c) const override {
+        return typeEverything || IKeyboardSimulator<CharT>::canType(c);
+    }
+};
+
+// Time only moves when someone sleeps; every sleep wakes overshootUs late
+class ManualClock : public IClock {
+public:
+    int64_t now = 0;
+    int64_t overshootUs = 0;
+    int sleeps = 0;
+
+    int64_t nowUs() const override { return now; }
+
+    void sleepUntilUs(int64_t deadlineUs) override {
+        sleeps++;
+        now = std::max(now, deadlineUs) + overshootUs;
+    }
+};
+
+static ImperfectionSettings noImperfections() {
+    ImperfectionSettings settings;
+    settings.enableTypos = false;
+    settings.enableDoubleKeys = false;
+    return settings;
+}
+
+// ============================================================================
+// Random Tests
+// ============================================================================
+
+TEST(RandomTest, SameSeedSameSequence) {
+    Random a(42);
+    Random b(42);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(a.next(), b.next());
+    }
+    EXPECT_EQ(a.gamma(2.0, 1.0), b.gamma(2.0, 1.0));
+    EXPECT_EQ(a.normal(0.0, 1.0), b.normal(0.0, 1.0));
+}
+
+TEST(RandomTest, RangeIsInclusive) {
+    Random rng(1);
+    bool sawMin = false, sawMax = false;
+    for (int i = 0; i < 1000; i++) {
+        int val = rng.range(-3, 3);
+        EXPECT_GE(val, -3);
+        EXPECT_LE(val, 3);
+        sawMin |= val == -3;
+        sawMax |= val == 3;
+    }
+    EXPECT_TRUE(sawMin);
+    EXPECT_TRUE(sawMax);
+    EXPECT_EQ(rng.range(5, 5), 5);
+    EXPECT_GE(rng.range(20, 10), 10);  // Swapped bounds
+}
+
+TEST(RandomTest, GammaMean) {
+    Random rng(7);
+    double sum = 0;
+    int count = 20000;
+    for (int i = 0; i < count; i++) {
+        sum += rng.gamma(2.0, 1.5);
+    }
+    EXPECT_NEAR(sum / count, 3.0, 0.1);
+}
+
+TEST(RandomTest, PrecomputedGammaMatchesShape) {
+    static_assert(GammaParams::of(2.0).invShape == 0.0, "shape >= 1 needs no boost");
+    static_assert(GammaParams::of(0.5).invShape == 2.0, "shape < 1 is boosted");
+    EXPECT_NEAR(GammaParams::of(2.5).c, 1.0 / std::sqrt(9.0 * (2.5 - 1.0 / 3.0)), 1e-15);
+
+    Random rng(11);
+    GammaParams small = GammaParams::of(0.5);
+    double sum = 0;
+    int count = 20000;
+    for (int i = 0; i < count; i++) {
+        sum += rng.gamma(small, 2.0);
+    }
+    EXPECT_NEAR(sum / count, 1.0, 0.05);
+}
+
+// ============================================================================
+// TextChunker Tests
+// ============================================================================
+
+template<typename CharT>
+class ChunkerTypedTest : public ::testing::Test {};
+
+using CharTypes = ::testing::Types<char, wchar_t, char16_t>;
+TYPED_TEST_SUITE(ChunkerTypedTest, CharTypes);
+
+template<typename CharT>
+static std::basic_string<CharT> widen(const char* text) {
+    std::basic_string<CharT> out;
+    for (; *text; ++text) out.push_back(static_cast<CharT>(*text));
+    return out;
+}
+
+TYPED_TEST(ChunkerTypedTest, SplitsWordsAndPunctuation) {
+    using String = std::basic_string<TypeParam>;
+    TextChunker<TypeParam> chunker(widen<TypeParam>("hello, world!\n\tok"));
+
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>("hello"));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>(","));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>(" "));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>("world"));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>("!"));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>("\n"));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>("\t"));
+    EXPECT_EQ(chunker.nextChunk(), widen<TypeParam>("ok"));
+    EXPECT_FALSE(chunker.hasMore());
+    EXPECT_EQ(chunker.nextChunk(), String());
+}
+
+TYPED_TEST(ChunkerTypedTest, LongWordsAreCapped) {
+    TextChunker<TypeParam> chunker(widen<TypeParam>("abcdefghijklmnopqrstuvwxyz"));
+    EXPECT_EQ(chunker.next().size, TypingConstants::MAX_CHUNK_LENGTH);
+    EXPECT_EQ(chunker.next().size, TypingConstants::MAX_CHUNK_LENGTH);
+    EXPECT_EQ(chunker.next().size, 2);
+}
+
+TEST(TextChunkerTest, UnicodeSpaceBreaksWords) {
+    TextChunker<char16_t> chunker(u"a\u00A0b");
+    EXPECT_EQ(chunker.nextChunk(), u"a");
+    EXPECT_EQ(chunker.nextChunk(), u"\u00A0");  // No-break space
+    EXPECT_EQ(chunker.nextChunk(), u"b");
+}
+
+TEST(TextChunkerTest, AppendKeepsAbsolutePositions) {
+    TextChunker<char> chunker;
+    std::string first = "one two";
+    chunker.append(first.data(), first.size());
+
+    EXPECT_EQ(chunker.nextChunk(), "one");
+    EXPECT_EQ(chunker.nextChunk(), " ");
+    EXPECT_EQ(chunker.currentPosition(), 4);
+
+    std::string second = " three";
+    chunker.append(second.data(), second.size());
+    EXPECT_EQ(chunker.totalLength(), 13);
+
+    std::string rest;
+    while (chunker.hasMore()) rest += chunker.nextChunk();
+    EXPECT_EQ(rest, "two three");
+    EXPECT_EQ(chunker.progressPercent(), 100);
+}
+
+// ============================================================================
+// TypingDynamics Tests
+// ============================================================================
+
+// The table and the Unicode path must answer what the Traits predicates do
+TEST(CharClassTest, MatchesTraitsForEveryCodeUnit) {
+    using Traits = CharTraits<char16_t>;
+    for (char32_t code = 0; code < 0x10000; code++) {
+        char16_t c = static_cast<char16_t>(code);
+        uint8_t flags = detail::charClass<Traits>(c);
+        ASSERT_EQ(bool(flags & detail::CHAR_SPACE), Traits::isSpace(c)) << code;
+        ASSERT_EQ(bool(flags & detail::CHAR_DIGIT), Traits::isDigit(c)) << code;
+        ASSERT_EQ(bool(flags & detail::CHAR_UPPER), Traits::isUpper(c)) << code;
+        ASSERT_EQ(bool(flags & detail::CHAR_LETTER), Traits::isLetter(c)) << code;
+    }
+
+    auto delayClass = [](char16_t c) { return detail::charClass<Traits>(c) & detail::CHAR_DELAY_MASK; };
+    EXPECT_EQ(delayClass(u'a'), detail::DELAY_PLAIN);
+    EXPECT_EQ(delayClass(u'7'), detail::DELAY_DIGIT);
+    EXPECT_EQ(delayClass(u' '), detail::DELAY_SPACE);
+    EXPECT_EQ(delayClass(u'\t'), detail::DELAY_SPACE);
+    EXPECT_EQ(delayClass(u'\u00A0'), detail::DELAY_SPACE);
+    EXPECT_EQ(delayClass(u'\n'), detail::DELAY_NEWLINE);
+    EXPECT_EQ(delayClass(u'?'), detail::DELAY_SENTENCE_END);
+    EXPECT_EQ(delayClass(u','), detail::DELAY_PLAIN);
+}
+
+TEST(TypingDynamicsTest, DigraphFactors) {
+    TypingDynamics<char> dynamics(TimingProfile::humanAdvanced(), DelayRange{100, 200});
+    EXPECT_DOUBLE_EQ(dynamics.digraphFactor('t', 'h'), 0.75);
+    EXPECT_DOUBLE_EQ(dynamics.digraphFactor('T', 'H'), 0.75);
+    EXPECT_DOUBLE_EQ(dynamics.digraphFactor('q', 'z'), 1.4);
+    EXPECT_DOUBLE_EQ(dynamics.digraphFactor('a', 's'), 1.08);   // Both left hand
+    EXPECT_DOUBLE_EQ(dynamics.digraphFactor('a', 'k'), 1.0);
+    EXPECT_DOUBLE_EQ(dynamics.digraphFactor('1', '2'), 1.0);
+}
+
+TEST(TypingDynamicsTest, SeededRunsMatch) {
+    Random a(99), b(99);
+    TypingDynamics<char> first(TimingProfile::humanAdvanced(), DelayRange{100, 200}, a);
+    TypingDynamics<char> second(TimingProfile::humanAdvanced(), DelayRange{100, 200}, b);
+
+    for (char c : std::string("the quick brown fox")) {
+        EXPECT_EQ(first.generateHoldTime(c), second.generateHoldTime(c));
+        EXPECT_EQ(first.calculateDelay(c, false, false, false),
+                  second.calculateDelay(c, false, false, false));
+        first.updateState(c);
+        second.updateState(c);
+    }
+}
+
+// The rotation stands in for std::sin of a phase stepped by RHYTHM_STEP
+TEST(TypingDynamicsTest, RhythmFollowsTheSine) {
+    EXPECT_DOUBLE_EQ(TypingConstants::RHYTHM_STEP_COS, std::cos(TypingConstants::RHYTHM_STEP));
+    EXPECT_DOUBLE_EQ(TypingConstants::RHYTHM_STEP_SIN, std::sin(TypingConstants::RHYTHM_STEP));
+
+    Random probe(5), rng(5);
+    double phase = probe.uniform() * TypingConstants::TWO_PI;
+    TypingDynamics<char> dynamics(TimingProfile::humanAdvanced(), DelayRange{100, 200}, rng);
+
+    double worst = 0.0;
+    for (int i = 1; i <= 200000; i++) {
+        dynamics.calculateDelay('a', false, false, false);
+        TypingDynamics<char>::State state = dynamics.state();
+        worst = std::max(worst, std::fabs(state.rhythmSin - std::sin(phase + i * TypingConstants::RHYTHM_STEP)));
+        worst = std::max(worst, std::fabs(state.rhythmCos - std::cos(phase + i * TypingConstants::RHYTHM_STEP)));
+    }
+    EXPECT_LT(worst, 1e-9);
+}
+
+// A compile-time preset must behave exactly like the same profile passed in
+// at run time
+template<typename Profile>
+static void expectSameAsRuntime(const TimingProfile& runtime) {
+    Random a(21), b(21);
+    TypingDynamics<char> dynamic(runtime, DelayRange{100, 200}, a);
+    TypingDynamics<char, CharTraits<char>, Profile> fixed(runtime, DelayRange{100, 200}, b);
+
+    for (char c : std::string("Fixed profiles. Same delays!\n")) {
+        bool burst = dynamic.shouldBurst();
+        EXPECT_EQ(burst, fixed.shouldBurst());
+        EXPECT_EQ(dynamic.generateHoldTime(c), fixed.generateHoldTime(c));
+        EXPECT_EQ(dynamic.calculateDelay(c, c == '.', burst, c == '\n'),
+                  fixed.calculateDelay(c, c == '.', burst, c == '\n'));
+        dynamic.updateState(c);
+        fixed.updateState(c);
+    }
+}
+
+TEST(TypingDynamicsTest, StaticProfilesMatchRuntimeProfiles) {
+    expectSameAsRuntime<HumanAdvancedProfile>(TimingProfile::humanAdvanced());
+    expectSameAsRuntime<FastHumanProfile>(TimingProfile::fastHuman());
+    expectSameAsRuntime<SlowTiredProfile>(TimingProfile::slowTired());
+    expectSameAsRuntime<ProfessionalProfile>(TimingProfile::professional());
+}
+
+// ============================================================================
+// Pacer Tests
+// ============================================================================
+
+TEST(PacerTest, PreciseClockWaitsTheDelay) {
+    ManualClock clock;
+    Pacer pacer(clock);
+    pacer.wait(20);
+    pacer.wait(35);
+    EXPECT_EQ(clock.now, 55000);
+    EXPECT_EQ(pacer.debtUs(), 0);
+}
+
+TEST(PacerTest, OvershootIsTakenOffTheNextWait) {
+    ManualClock clock;
+    clock.overshootUs = 15600;      // A full default Windows timer tick
+    Pacer pacer(clock);
+
+    for (int i = 0; i < 10; i++) {
+        pacer.wait(100);
+    }
+
+    // Only the last wait's overshoot is still outstanding
+    EXPECT_EQ(clock.now, 10 * 100000 + 15600);
+    EXPECT_EQ(pacer.debtUs(), 15600);
+}
+
+TEST(PacerTest, LargeOvershootIsSpreadOverWaits) {
+    ManualClock clock;
+    Pacer pacer(clock);
+
+    clock.overshootUs = 50000;
+    pacer.wait(20);
+    clock.overshootUs = 0;
+    pacer.wait(20);
+    pacer.wait(20);
+    EXPECT_EQ(clock.now, 70000);    // No time left to wait; never goes back
+    EXPECT_EQ(pacer.debtUs(), 10000);
+
+    pacer.wait(20);
+    EXPECT_EQ(clock.now, 4 * 20000);
+    EXPECT_EQ(pacer.debtUs(), 0);
+}
+
+// ============================================================================
+// Cancellation Tests
+// ============================================================================
+
+TEST(CancellationTest, CancelWakesAWait) {
+    CancellationToken token;
+    SteadyClock clock;
+    Pacer pacer(clock);
+
+    std::thread stopper([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        token.cancel();
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(pacer.wait(5000, &token));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stopper.join();
+
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+    EXPECT_FALSE(clock.waitForMs(5000, &token));    // Stays cancelled
+
+    token.reset();
+    EXPECT_TRUE(clock.waitForMs(1, &token));
+}
+
+TEST(CancellationTest, NotifierFollowsState) {
+    CancellationToken token;
+    std::vector<bool> calls;
+    token.setNotifier([&](bool cancelled) { calls.push_back(cancelled); });
+
+    token.cancel();
+    token.reset();
+    EXPECT_EQ(calls, (std::vector<bool>{true, false}));
+}
+
+// Cancels the run from inside a keystroke, like a stop arriving mid-chunk
+class CancellingKeyboard : public RecordingKeyboard<char> {
+public:
+    CancellationToken* token = nullptr;
+    size_t cancelAfter = 0;
+
+    void typeCharacter(char c, int holdTimeMs) override {
+        RecordingKeyboard<char>::typeCharacter(c, holdTimeMs);
+        if (typed.size() == cancelAfter) token->cancel();
+    }
+};
+
+TEST(CancellationTest, EngineStopsMidChunk) {
+    CancellationToken token;
+    CancellingKeyboard keyboard;
+    keyboard.token = &token;
+    keyboard.cancelAfter = 3;
+
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, noImperfections());
+    engine.setCancellationToken(&token);
+    engine.setText("abcdefgh ijk");
+
+    EXPECT_EQ(engine.typeNextChunk(), 0);
+    EXPECT_EQ(keyboard.typed, "abc");
+    EXPECT_GE(keyboard.flushCount, 1);          // Held-back key-ups still go out
+    EXPECT_TRUE(engine.isCancelled());
+    EXPECT_EQ(engine.typeNextChunk(), 0);
+    EXPECT_EQ(keyboard.typed, "abc");
+}
+
+// Holds each key on the stop token like the console simulators do, and
+// notes when the last key went down
+class TimedKeyboard : public IKeyboardSimulator<char> {
+public:
+    explicit TimedKeyboard(CancellationToken& token) : token_(token) {}
+
+    std::atomic<int64_t> lastKeyUs{0};
+    std::atomic<int> keys{0};
+
+    void typeCharacter(char, int holdTimeMs) override {
+        lastKeyUs = systemClock().nowUs();
+        keys++;
+        systemClock().waitForMs(holdTimeMs, &token_);
+    }
+
+    void pressBackspace() override {}
+    void releaseAllKeys() override {}
+
+private:
+    CancellationToken& token_;
+};
+
+TEST(CancellationTest, StopToQuietUnderFiveMs) {
+    for (int attempt = 0; attempt < 5; attempt++) {
+        CancellationToken token;
+        TimedKeyboard keyboard(token);
+        TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                  DelayRange{150, 400}, noImperfections());
+        engine.setCancellationToken(&token);
+        engine.setText(std::string(2000, 'a') + " long words keep it busy");
+
+        std::atomic<int64_t> quietUs{0};
+        std::thread typist([&] {
+            Pacer pacer;
+            while (engine.hasMoreToType() && !token.isCancelled()) {
+                pacer.wait(engine.typeNextChunk(), &token);
+            }
+            quietUs = systemClock().nowUs();
+        });
+
+        // Land the stop at a different point of a hold or delay each time
+        std::this_thread::sleep_for(std::chrono::milliseconds(60 + 37 * attempt));
+        int64_t stopUs = systemClock().nowUs();
+        token.cancel();
+        typist.join();
+
+        EXPECT_GT(keyboard.keys, 0);
+        EXPECT_LT(quietUs - stopUs, 5000) << "attempt " << attempt;
+        EXPECT_LT(keyboard.lastKeyUs - stopUs, 5000) << "attempt " << attempt;
+    }
+}
+
+// ============================================================================
+// KeyboardLayout Tests
+// ============================================================================
+
+TEST(KeyboardLayoutTest, NeighborsStayOnLayoutAndKeepCase) {
+    KeyboardLayout<wchar_t> layout(KeyboardLayoutType::GERMAN_QWERTZ);
+    Random rng(3);
+    for (int i = 0; i < 100; i++) {
+        wchar_t lower = layout.getNeighborKey(L'z', rng);
+        EXPECT_NE(std::wstring(L"tuhgj").find(lower), std::wstring::npos);
+
+        wchar_t upper = layout.getNeighborKey(L'Z', rng);
+        EXPECT_TRUE(upper >= L'A' && upper <= L'Z');
+    }
+    EXPECT_EQ(layout.getNeighborKey(L'é', rng), L'é');
+}
+
+static_assert(keyStrokeFor(KeyboardLayoutType::US_QWERTY, 'a').scancode == 30,
+              "key stroke tables are built at compile time");
+
+TEST(KeyboardLayoutTest, KeyStrokesFollowTheLayout) {
+    KeyStroke upperA = keyStrokeFor(KeyboardLayoutType::US_QWERTY, 'A');
+    EXPECT_EQ(upperA.scancode, 30);
+    EXPECT_TRUE(upperA.needsShift);
+    EXPECT_FALSE(upperA.needsAltGr);
+
+    // Same character, different key
+    EXPECT_EQ(keyStrokeFor(KeyboardLayoutType::GERMAN_QWERTZ, 'z').scancode, 21);
+    EXPECT_EQ(keyStrokeFor(KeyboardLayoutType::FRENCH_AZERTY, 'a').scancode, 16);
+    EXPECT_EQ(keyStrokeFor(KeyboardLayoutType::UK_QWERTY, '"').scancode, 3);
+    EXPECT_EQ(keyStrokeFor(KeyboardLayoutType::UK_QWERTY, '\\').scancode, 86);
+
+    KeyStroke at = keyStrokeFor(KeyboardLayoutType::GERMAN_QWERTZ, '@');
+    EXPECT_EQ(at.scancode, 16);
+    EXPECT_TRUE(at.needsAltGr);
+    EXPECT_FALSE(at.needsShift);
+
+    // French digits are shifted
+    KeyStroke seven = keyStrokeFor(KeyboardLayoutType::FRENCH_AZERTY, '7');
+    EXPECT_EQ(seven.scancode, 8);
+    EXPECT_TRUE(seven.needsShift);
+
+    // Dead keys and non-ASCII go to the backend's text path
+    EXPECT_FALSE(keyStrokeFor(KeyboardLayoutType::GERMAN_QWERTZ, '^').isTypable());
+    EXPECT_FALSE(keyStrokeFor(KeyboardLayoutType::US_QWERTY, U'é').isTypable());
+}
+
+TEST(KeyboardLayoutTest, UsAndUkTypeAllPrintableAscii) {
+    for (KeyboardLayoutType type : {KeyboardLayoutType::US_QWERTY, KeyboardLayoutType::UK_QWERTY}) {
+        for (char32_t c = 0x20; c < 0x7F; c++) {
+            EXPECT_TRUE(keyStrokeFor(type, c).isTypable()) << static_cast<char>(c);
+        }
+    }
+    for (char c : {'\t', '\n', '\b'}) {
+        EXPECT_TRUE(keyStrokeFor(KeyboardLayoutType::FRENCH_AZERTY, c).isTypable());
+    }
+}
+
+// ============================================================================
+// TimingWheel Tests
+// ============================================================================
+
+TEST(TimingWheelTest, FiresEachTimerOnItsTick) {
+    TimingWheel wheel(1000);
+    std::vector<std::pair<int64_t, int64_t>> fired;     // {expiry, tick fired}
+    std::vector<std::unique_ptr<TimingWheel::Timer>> timers;
+
+    // Every level of the wheel, its edges, and past the top
+    for (int64_t delta : {1, 2, 63, 64, 65, 4095, 4096, 5000, 262143, 262144, 300000,
+                          16777215, 16777216, 20000000}) {
+        timers.push_back(std::make_unique<TimingWheel::Timer>());
+        TimingWheel::Timer& timer = *timers.back();
+        timer.callback = [&fired, &wheel, &timer] { fired.push_back({timer.expiry(), wheel.now()}); };
+        wheel.schedule(timer, 1000 + delta);
+    }
+    EXPECT_EQ(wheel.size(), timers.size());
+
+    for (int64_t now = 1000; now <= 1000 + 20000000; now += 997) {
+        wheel.advance(now);
+    }
+    wheel.advance(1000 + 20000001);
+
+    ASSERT_EQ(fired.size(), timers.size());
+    for (size_t i = 0; i < fired.size(); i++) {
+        EXPECT_EQ(fired[i].first, fired[i].second);
+        if (i > 0) EXPECT_LT(fired[i - 1].first, fired[i].first);
+    }
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimingWheelTest, CancelAndReschedule) {
+    TimingWheel wheel;
+    int fires = 0;
+    TimingWheel::Timer once([&fires] { fires++; });
+    TimingWheel::Timer cancelled([&fires] { fires += 100; });
+
+    wheel.schedule(once, 10);
+    wheel.schedule(cancelled, 10);
+    wheel.cancel(cancelled);
+    EXPECT_FALSE(cancelled.isScheduled());
+
+    wheel.schedule(once, 5000);         // Moves it
+    wheel.advance(4999);
+    EXPECT_EQ(fires, 0);
+    EXPECT_EQ(wheel.nextWakeup(), 5000);
+    wheel.advance(5000);
+    EXPECT_EQ(fires, 1);
+    EXPECT_EQ(wheel.nextWakeup(), INT64_MAX);
+
+    // A periodic timer re-arms itself from its callback
+    TimingWheel::Timer periodic;
+    periodic.callback = [&] { fires++; wheel.schedule(periodic, wheel.now() + 100); };
+    wheel.schedule(periodic, 5100);
+    wheel.advance(6000);
+    EXPECT_EQ(fires, 1 + 10);    // 5100, 5200, ... 6000
+    EXPECT_TRUE(periodic.isScheduled());
+}
+
+TEST(TimingWheelTest, PastTimesFireOnTheNextTick) {
+    TimingWheel wheel(50);
+    int fires = 0;
+    TimingWheel::Timer late([&fires] { fires++; });
+    wheel.schedule(late, 10);
+    EXPECT_EQ(late.expiry(), 51);
+    wheel.advance(51);
+    EXPECT_EQ(fires, 1);
+}
+
+TEST(TimingWheelTest, FarTimersWakeOncePerLevel) {
+    TimingWheel wheel;
+    int fires = 0;
+    TimingWheel::Timer timer([&fires] { fires++; });
+    wheel.schedule(timer, 1000);
+
+    int wakeups = 0;
+    while (fires == 0) {
+        wheel.advance(wheel.nextWakeup());
+        wakeups++;
+    }
+    EXPECT_EQ(wheel.now(), 1000);
+    EXPECT_EQ(wakeups, 2);      // Re-bucketed at 960, fired at 1000
+}
+
+TEST(EventTimersTest, OneWakeupSourceAndItsSlack) {
+    ManualClock clock;
+    clock.now = 5000000;
+    clock.overshootUs = 1000;   // Every wakeup comes 1 ms late
+    EventTimers timers(clock);
+
+    int ticks = 0, shots = 0;
+    TimingWheel::Timer periodic;
+    periodic.callback = [&] { ticks++; timers.start(periodic, 1000); };
+    TimingWheel::Timer oneShot([&shots] { shots++; });
+    timers.start(periodic, 1000);
+    timers.start(oneShot, 2500);
+
+    int wakeups = 0;
+    while (ticks < 5) {
+        int ms = timers.msUntilNextRun();
+        ASSERT_GE(ms, 0);
+        clock.sleepUntilUs(clock.now + ms * 1000);
+        timers.run();
+        wakeups++;
+    }
+
+    EXPECT_EQ(shots, 1);
+    EXPECT_LE(wakeups, 2 * (ticks + shots));
+    EXPECT_EQ(timers.slack().wakeups, wakeups);
+    EXPECT_EQ(timers.slack().maxUs, 1000);
+    EXPECT_DOUBLE_EQ(timers.slack().averageMs(), 1.0);
+
+    timers.stop(periodic);
+    EXPECT_EQ(timers.msUntilNextRun(), -1);
+}
+
+// ============================================================================
+// TypingEngine Tests
+// ============================================================================
+
+TEST(TypingEngineTest, TypesNarrowText) {
+    RecordingKeyboard<char> keyboard;
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, noImperfections());
+    engine.setText("hello world.");
+
+    while (engine.hasMoreToType()) {
+        int delay = engine.typeNextChunk();
+        EXPECT_GE(delay, TypingConstants::MIN_DELAY_MS);
+    }
+
+    EXPECT_EQ(keyboard.typed, "hello world.");
+    EXPECT_EQ(engine.progressPercent(), 100);
+}
+
+TEST(TypingEngineTest, StaticProfileEngine) {
+    RecordingKeyboard<char> keyboard;
+    TypingEngine<char, CharTraits<char>, ProfessionalProfile> engine(
+        &keyboard, nullptr, DelayRange{50, 100}, noImperfections());
+    engine.setText("fixed at compile time");
+    while (engine.hasMoreToType()) engine.typeNextChunk();
+
+    EXPECT_EQ(keyboard.typed, "fixed at compile time");
+}
+
+TEST(TypingEngineTest, SkipsWhatTheBackendCannotType) {
+    RecordingKeyboard<wchar_t> keyboard;
+    TypingEngine<wchar_t> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                 DelayRange{50, 100}, noImperfections());
+    engine.setText(L"café — ok");
+    while (engine.hasMoreToType()) engine.typeNextChunk();
+
+    EXPECT_EQ(keyboard.typed, L"caf  ok");
+    EXPECT_EQ(engine.getSkippedCharCount(), 2);
+    EXPECT_EQ(engine.getSkippedCharsPreview(), L"é, —");
+}
+
+TEST(TypingEngineTest, UnicodeBackendTypesEverything) {
+    RecordingKeyboard<wchar_t> keyboard;
+    keyboard.typeEverything = true;
+    TypingEngine<wchar_t> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                 DelayRange{50, 100}, noImperfections());
+    engine.setText(L"café — ok");
+    while (engine.hasMoreToType()) engine.typeNextChunk();
+
+    EXPECT_EQ(keyboard.typed, L"café — ok");
+    EXPECT_EQ(engine.getSkippedCharCount(), 0);
+}
+
+TEST(TypingEngineTest, AppendedTextContinuesTheRun) {
+    RecordingKeyboard<char> keyboard;
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, noImperfections());
+    std::string parts[] = {"streamed ", "in ", "pieces"};
+    for (const std::string& part : parts) {
+        engine.appendText(part.data(), part.size());
+        while (engine.hasMoreToType()) engine.typeNextChunk();
+    }
+
+    EXPECT_EQ(keyboard.typed, "streamed in pieces");
+    EXPECT_EQ(engine.currentPosition(), 18);
+}
+
+TEST(TypingEngineTest, CorrectedTyposLeaveTextIntact) {
+    RecordingKeyboard<char16_t> keyboard;
+    ImperfectionSettings imperfections = noImperfections();
+    imperfections.enableTypos = true;
+    imperfections.typoMin = 3;
+    imperfections.typoMax = 5;
+    imperfections.correctionProbability = 100;
+
+    TypingEngine<char16_t> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                  DelayRange{50, 100}, imperfections);
+    engine.seed(5);
+    engine.setText(u"abcdefghij");
+    while (engine.hasMoreToType()) engine.typeNextChunk();
+
+    EXPECT_GT(keyboard.backspaceCount, 0);
+    EXPECT_EQ(keyboard.typed, u"abcdefghij");
+}
+
+TEST(TypingEngineTest, RestartingARunDoesNotAllocate) {
+    static_assert(TypingEngine<char>::hotStateSize() % TypingConstants::CACHE_LINE_BYTES == 0,
+                  "hot state fills whole cache lines");
+
+    RecordingKeyboard<char> keyboard;
+    keyboard.typed.reserve(64);
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, noImperfections());
+    const std::string text = "the same text again";
+    engine.setText(text);
+    while (engine.hasMoreToType()) engine.typeNextChunk();
+
+    keyboard.typed.clear();
+    int before = allocationCount;
+    engine.setText(text);
+    while (engine.hasMoreToType()) engine.typeNextChunk();
+
+    EXPECT_EQ(allocationCount, before);
+    EXPECT_EQ(keyboard.typed, text);
+}
+
+TEST(TypingEngineTest, PausesInsideChunksUseTheEngineClock) {
+    RecordingKeyboard<char> keyboard;
+    ImperfectionSettings imperfections = noImperfections();
+    imperfections.enableTypos = true;
+    imperfections.typoMin = 2;
+    imperfections.typoMax = 3;
+    imperfections.correctionProbability = 100;
+
+    ManualClock clock;
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, imperfections);
+    engine.setClock(&clock);
+    engine.setText("corrections everywhere");
+
+    int chunks = 0;
+    while (engine.hasMoreToType()) {
+        engine.typeNextChunk();
+        chunks++;
+    }
+
+    EXPECT_EQ(keyboard.typed, "corrections everywhere");
+    EXPECT_EQ(clock.sleeps, 2 * keyboard.backspaceCount);
+    EXPECT_GE(clock.now, keyboard.backspaceCount * int64_t(
+                  TypingConstants::MIN_CORRECTION_DELAY_MS + TypingConstants::MIN_BACKSPACE_DELAY_MS) * 1000);
+    EXPECT_GE(keyboard.flushCount, chunks);
+}
+
+// ============================================================================
+// Session Checkpoint Tests
+// ============================================================================
+
+// Keystrokes (with '\b' for backspaces) and delays of one run
+struct SessionTrace {
+    std::string keys;
+    std::vector<int> delays;
+};
+
+class TraceKeyboard : public IKeyboardSimulator<char> {
+public:
+    std::string* keys = nullptr;
+
+    void typeCharacter(char c, int holdTimeMs) override { keys->push_back(c); }
+    void pressBackspace() override { keys->push_back('\b'); }
+    void releaseAllKeys() override {}
+};
+
+static ImperfectionSettings sessionImperfections() {
+    ImperfectionSettings imperfections;
+    imperfections.typoMin = 15;
+    imperfections.typoMax = 30;
+    imperfections.doubleMin = 40;
+    imperfections.doubleMax = 60;
+    return imperfections;
+}
+
+// Types `text` from seed 9, stopping after `stopAfterChunks` chunks to
+// checkpoint and continue in a fresh engine (negative: never stop)
+static SessionTrace typeWithSession(const std::string& text, int stopAfterChunks) {
+    SessionTrace trace;
+    TraceKeyboard keyboard;
+    keyboard.keys = &trace.keys;
+    ManualClock clock;
+
+    SessionState saved;
+    {
+        TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                  DelayRange{50, 100}, sessionImperfections());
+        engine.setClock(&clock);
+        engine.seed(9);
+        engine.setText(text);
+        for (int chunks = 0; engine.hasMoreToType(); chunks++) {
+            if (chunks == stopAfterChunks) {
+                EXPECT_TRUE(SessionState::deserialize(engine.checkpoint().serialize(), saved));
+                break;
+            }
+            trace.delays.push_back(engine.typeNextChunk());
+        }
+        if (stopAfterChunks < 0) return trace;
+    }
+
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, sessionImperfections());
+    engine.setClock(&clock);
+    engine.seed(1234);                  // Replaced by the checkpoint
+    EXPECT_TRUE(engine.resume(text, saved));
+    EXPECT_EQ(engine.currentPosition(), saved.position);
+    while (engine.hasMoreToType()) {
+        trace.delays.push_back(engine.typeNextChunk());
+    }
+    return trace;
+}
+
+TEST(SessionStateTest, ResumedRunMatchesUninterruptedRun) {
+    std::string text;
+    for (int i = 0; i < 20; i++) {
+        text += "The quick brown fox jumps over the lazy dog. Then it naps.\n";
+    }
+
+    SessionTrace straight = typeWithSession(text, -1);
+    for (int stopAt : {1, 37, 150}) {
+        SessionTrace resumed = typeWithSession(text, stopAt);
+        EXPECT_EQ(resumed.keys, straight.keys) << "stopped after " << stopAt;
+        EXPECT_EQ(resumed.delays, straight.delays) << "stopped after " << stopAt;
+    }
+}
+
+// Stops the run from inside a keystroke: after `stopAfterKeys` characters,
+// or at the first backspace
+class StoppingKeyboard : public RecordingKeyboard<char> {
+public:
+    CancellationToken* stop = nullptr;
+    int stopAfterKeys = -1;
+    bool stopAtBackspace = false;
+
+    void typeCharacter(char c, int holdTimeMs) override {
+        RecordingKeyboard<char>::typeCharacter(c, holdTimeMs);
+        if (--stopAfterKeys == 0) stop->cancel();
+    }
+
+    void pressBackspace() override {
+        RecordingKeyboard<char>::pressBackspace();
+        if (stopAtBackspace) stop->cancel();
+    }
+};
+
+// Text typed by a run stopped mid-chunk, then by a run resumed from the
+// checkpoint taken at the stop
+static std::string typeStoppedAndResumed(const std::string& text, const ImperfectionSettings& imperfections,
+                                         int stopAfterKeys, bool stopAtBackspace) {
+    ManualClock clock;
+    CancellationToken stop;
+    StoppingKeyboard keyboard;
+    keyboard.stop = &stop;
+    keyboard.stopAfterKeys = stopAfterKeys;
+    keyboard.stopAtBackspace = stopAtBackspace;
+
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, imperfections);
+    engine.setClock(&clock);
+    engine.setCancellationToken(&stop);
+    engine.seed(5);
+    engine.setText(text);
+    while (engine.hasMoreToType() && !stop.isCancelled()) {
+        engine.typeNextChunk();
+    }
+    SessionState saved;
+    EXPECT_TRUE(SessionState::deserialize(engine.checkpoint().serialize(), saved));
+
+    RecordingKeyboard<char> rest;
+    TypingEngine<char> resumed(&rest, nullptr, TimingProfile::humanAdvanced(),
+                               DelayRange{50, 100}, imperfections);
+    resumed.setClock(&clock);
+    EXPECT_TRUE(resumed.resume(text, saved));
+    while (resumed.hasMoreToType()) {
+        resumed.typeNextChunk();
+    }
+    return keyboard.typed + rest.typed;
+}
+
+TEST(SessionStateTest, StopInsideAChunkResumesAtTheNextCharacter) {
+    const std::string text = "The quick brown fox jumps over the lazy dog.";
+    for (int stopAfter = 1; stopAfter < static_cast<int>(text.size()); stopAfter++) {
+        EXPECT_EQ(typeStoppedAndResumed(text, noImperfections(), stopAfter, false), text)
+            << "stopped after " << stopAfter << " keys";
+    }
+
+    // Every typo corrected. Stopped on a typo key the engine takes the typo
+    // back before it stops; stopped between the backspace and the corrected
+    // key the character is typed again on resume.
+    ImperfectionSettings corrections = noImperfections();
+    corrections.enableTypos = true;
+    corrections.typoMin = 3;
+    corrections.typoMax = 6;
+    corrections.correctionProbability = 100;
+    for (int stopAfter = 1; stopAfter < static_cast<int>(text.size()); stopAfter++) {
+        EXPECT_EQ(typeStoppedAndResumed(text, corrections, stopAfter, false), text)
+            << "stopped after " << stopAfter << " keys, with corrections";
+    }
+    EXPECT_EQ(typeStoppedAndResumed(text, corrections, -1, true), text);
+}
+
+TEST(SessionStateTest, SerializeRoundTrip) {
+    RecordingKeyboard<char16_t> keyboard;
+    TypingEngine<char16_t> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                                  DelayRange{50, 100}, noImperfections());
+    engine.seed(3);
+    engine.setText(u"round trip ü");
+    engine.typeNextChunk();
+    engine.typeNextChunk();
+
+    SessionState state = engine.checkpoint();
+    std::string data = state.serialize();
+    SessionState back;
+    ASSERT_TRUE(SessionState::deserialize(data, back));
+    EXPECT_EQ(data.size(), 133u);
+    EXPECT_EQ(back.serialize(), data);
+    EXPECT_EQ(back.position, 6);
+    EXPECT_EQ(back.progressPercent(), 50);
+    EXPECT_EQ(back.previousChar, U' ');
+
+    EXPECT_FALSE(SessionState::deserialize(data.substr(0, data.size() - 1), back));
+    EXPECT_FALSE(SessionState::deserialize("QTS0" + data.substr(4), back));
+    EXPECT_FALSE(SessionState::deserialize("QTS1" + data.substr(4), back));     // Phase-angle rhythm
+}
+
+TEST(SessionStateTest, RejectsOtherText) {
+    RecordingKeyboard<char> keyboard;
+    TypingEngine<char> engine(&keyboard, nullptr, TimingProfile::humanAdvanced(),
+                              DelayRange{50, 100}, noImperfections());
+    engine.setText("first document");
+    engine.typeNextChunk();
+    SessionState state = engine.checkpoint();
+
+    EXPECT_FALSE(engine.resume("other document", state));
+    EXPECT_EQ(engine.currentPosition(), 0);
+    EXPECT_TRUE(engine.resume("first document", state));
+    EXPECT_EQ(engine.currentPosition(), 5);
+}
+
+TEST(SessionStateTest, SaveAndLoad) {
+    SessionState state;
+    state.textHash = 42;
+    state.textLength = 10;
+    state.position = 4;
+    std::string path = ::testing::TempDir() + "qtype_session_test";
+
+    ASSERT_TRUE(state.save(path));
+    SessionState loaded;
+    ASSERT_TRUE(SessionState::load(path, loaded));
+    EXPECT_EQ(loaded.serialize(), state.serialize());
+    std::remove(path.c_str());
+    EXPECT_FALSE(SessionState::load(path, loaded));
+}
+
+// ============================================================================
+// SessionHost Tests
+// ============================================================================
+
+class TraceSink : public IKeyboardSimulator<char> {
+public:
+    std::string keys;
+
+    void typeCharacter(char c, int holdTimeMs) override { keys.push_back(c); }
+    void pressBackspace() override { keys.push_back('\b'); }
+    void releaseAllKeys() override {}
+};
+
+// Keystrokes of every session, hosted on `workers` threads
+static std::vector<std::string> hostRun(int workers, const std::vector<std::string>& texts) {
+    SessionHostOptions options;
+    options.workers = workers;
+    options.seed = 17;
+    options.timeScale = 1e-4;       // 100 ms of typing in 10 us
+
+    std::vector<TraceSink> sinks(texts.size());
+    SessionHost<char> host(options);
+    for (size_t i = 0; i < texts.size(); i++) {
+        host.addSession(&sinks[i], texts[i], TimingProfile::humanAdvanced(),
+                        DelayRange{50, 100}, sessionImperfections());
+    }
+    host.wait();
+    EXPECT_EQ(host.activeSessions(), 0u);
+
+    std::vector<std::string> keys;
+    for (TraceSink& sink : sinks) keys.push_back(sink.keys);
+    return keys;
+}
+
+TEST(SessionHostTest, SessionsDontDependOnScheduling) {
+    std::vector<std::string> texts;
+    for (int i = 0; i < 12; i++) {
+        std::string text;
+        for (int j = 0; j <= i; j++) text += "Session text for the host, typed with typos. ";
+        texts.push_back(text);
+    }
+
+    std::vector<std::string> one = hostRun(1, texts);
+    std::vector<std::string> four = hostRun(4, texts);
+    ASSERT_EQ(one.size(), texts.size());
+    for (size_t i = 0; i < texts.size(); i++) {
+        EXPECT_EQ(one[i], four[i]) << "session " << i;
+    }
+    EXPECT_NE(one.back().find('\b'), std::string::npos);     // Corrections too
+    EXPECT_NE(one[0], one[1].substr(0, one[0].size()));     // Own random streams
+}
+
+TEST(SessionHostTest, StopAllEndsWaitingSessions) {
+    SessionHostOptions options;
+    options.workers = 2;
+    SessionHost<char> host(options);        // Real time: minutes of typing each
+
+    std::vector<TraceSink> sinks(8);
+    for (TraceSink& sink : sinks) {
+        host.addSession(&sink, std::string(2000, 'x'), TimingProfile::humanAdvanced(),
+                        DelayRange{200, 400}, noImperfections());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    host.stopAll();
+    host.wait();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_GT(host.keystrokes(), 0);
+    EXPECT_LT(host.keystrokes(), 8 * 2000);
+}
+
+// ============================================================================
+// TypingPipeline Tests
+// ============================================================================
+
+TEST(SpscRingTest, KeepsOrderAcrossThreads) {
+    SpscRing<int> ring(100);
+    EXPECT_EQ(ring.capacity(), 128u);
+
+    constexpr int COUNT = 100000;
+    std::thread producer([&ring] {
+        for (int i = 0; i < COUNT; i++) {
+            while (!ring.tryPush(i)) std::this_thread::yield();
+        }
+    });
+
+    int expected = 0;
+    int item = 0;
+    while (expected < COUNT) {
+        if (!ring.tryPop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(item, expected);
+        ASSERT_LE(ring.size(), ring.capacity());
+        expected++;
+    }
+    producer.join();
+    EXPECT_EQ(ring.size(), 0u);
+    EXPECT_FALSE(ring.tryPop(item));
+}
+
+class MoveCounter : public IMouseSimulator {
+public:
+    int moves = 0;
+
+    void moveRelative(int deltaX, int deltaY) override { moves++; }
+    void scroll(int amount) override {}
+};
+
+// Hands out `text` in pieces of `pieceSize`, the way a stream arrives
+static TypingPipeline<char>::Source pieces(const std::string& text, size_t pieceSize) {
+    auto offset = std::make_shared<size_t>(0);
+    return [text, pieceSize, offset](std::string& piece) {
+        if (*offset >= text.size()) return false;
+        piece = text.substr(*offset, pieceSize);
+        *offset += piece.size();
+        return true;
+    };
+}
+
+TEST(TypingPipelineTest, PlaysWhatTheBlockingEngineTypes) {
+    std::string text;
+    for (int i = 0; i < 6; i++) text += "Planned on one thread, played on another, typos and all. ";
+
+    ManualClock blockingClock;
+    TraceSink blockingKeys;
+    MoveCounter blockingMouse;
+    TypingEngine<char> blocking(&blockingKeys, &blockingMouse, TimingProfile::humanAdvanced(),
+                                DelayRange{50, 100}, sessionImperfections());
+    blocking.setClock(&blockingClock);
+    blocking.seed(3);
+    blocking.setMouseMovementEnabled(true);
+    blocking.setText(std::string());
+    for (size_t offset = 0; offset < text.size(); offset += 40) {
+        std::string piece = text.substr(offset, 40);
+        blocking.appendText(piece.data(), piece.size());
+        while (blocking.hasMoreToType()) blocking.typeNextChunk();
+    }
+
+    TraceSink keys;
+    MoveCounter mouse;
+    ScaledClock clock(systemClock(), 1e-4);
+    TypingPipeline<char> pipeline(&keys, &mouse, TimingProfile::humanAdvanced(),
+                                  DelayRange{50, 100}, sessionImperfections());
+    pipeline.setClock(&clock);
+    pipeline.engine().seed(3);
+    pipeline.engine().setMouseMovementEnabled(true);
+
+    CancellationToken stop;
+    int lastPosition = 0;
+    pipeline.run(pieces(text, 40), stop, [&lastPosition](int position) { lastPosition = position; });
+
+    EXPECT_EQ(keys.keys, blockingKeys.keys);
+    EXPECT_NE(keys.keys.find('\b'), std::string::npos);
+    EXPECT_EQ(mouse.moves, blockingMouse.moves);
+    EXPECT_GT(mouse.moves, 0);
+    EXPECT_EQ(lastPosition, static_cast<int>(text.size()));
+
+    PipelineStats stats = pipeline.stats();
+    EXPECT_EQ(stats.capacity, size_t(TypingConstants::PIPELINE_RING_EVENTS));
+    EXPECT_EQ(stats.played + 1, stats.planned);     // All but the end marker
+    EXPECT_EQ(stats.fill, 0u);
+}
+
+TEST(TypingPipelineTest, RingBoundsThePlanAndStopEndsTheRun) {
+    TraceSink keys;
+    ScaledClock clock(systemClock(), 1e-2);         // 100 ms of typing in 1 ms
+    TypingPipeline<char> pipeline(&keys, nullptr, TimingProfile::humanAdvanced(),
+                                  DelayRange{50, 100}, noImperfections(),
+                                  KeyboardLayoutType::US_QWERTY, 16);
+    pipeline.setClock(&clock);
+
+    const std::string text(5000, 'x');
+    CancellationToken stop;
+    int chunks = 0;
+    pipeline.run(pieces(text, text.size()), stop, [&](int position) {
+        if (++chunks == 8) stop.cancel();
+    });
+
+    PipelineStats stats = pipeline.stats();
+    EXPECT_EQ(stats.capacity, 16u);
+    EXPECT_LE(stats.peakFill, 16u);
+    EXPECT_GT(stats.plannerStalls, 0u);             // The planner waited for room
+    EXPECT_LT(stats.planned, 40 * 16u);             // instead of planning all 5000 keys
+    EXPECT_LT(keys.keys.size(), text.size());
+    EXPECT_GT(keys.keys.size(), 0u);
+}
+
+// ============================================================================
+// PlanCache Tests
+// ============================================================================
+
+// A fresh cache directory per test
+static std::string cacheDirectory(const char* name) {
+    std::string directory = ::testing::TempDir() + "qtype_plans_" + name;
+    std::filesystem::remove_all(directory);
+    return directory;
+}
+
+static std::vector<PlanRecord> recordRun(int count) {
+    std::vector<PlanRecord> records(count);
+    for (int i = 0; i < count; i++) {
+        records[i].atUs = int64_t(i) * 1000;
+        records[i].code = 'a' + i % 26;
+        records[i].value = 50 + i;
+    }
+    return records;
+}
+
+TEST(PlanCacheTest, StoresMapsAndRejectsDamagedEntries) {
+    PlanCache cache(cacheDirectory("validate"));
+    std::vector<PlanRecord> records = recordRun(100);
+    ASSERT_TRUE(cache.store(42, records.data(), records.size()));
+
+    PlanView plan;
+    ASSERT_TRUE(cache.load(42, plan));
+    ASSERT_EQ(plan.size(), records.size());
+    EXPECT_EQ(std::memcmp(plan.begin(), records.data(), records.size() * sizeof(PlanRecord)), 0);
+    EXPECT_FALSE(cache.load(43, plan));
+    EXPECT_EQ(plan.size(), records.size());      // A miss leaves the view alone
+
+    // A flipped byte fails the checksum; the entry goes away
+    {
+        std::fstream file(cache.pathFor(42), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(64 + 5);
+        file.put('\x7f');
+    }
+    PlanView damaged;
+    EXPECT_FALSE(cache.load(42, damaged));
+    EXPECT_FALSE(std::filesystem::exists(cache.pathFor(42)));
+
+    // So do truncated files and files stored under another key's name
+    ASSERT_TRUE(cache.store(7, records.data(), records.size()));
+    std::filesystem::resize_file(cache.pathFor(7), 64 + 10 * sizeof(PlanRecord) + 3);
+    ASSERT_TRUE(cache.store(8, records.data(), records.size()));
+    std::filesystem::copy_file(cache.pathFor(8), cache.pathFor(9));
+    ASSERT_TRUE(cache.store(10, records.data(), records.size()));
+
+    EXPECT_EQ(cache.validate(), 2u);
+    EXPECT_TRUE(cache.load(8, plan));
+    EXPECT_TRUE(cache.load(10, plan));
+    EXPECT_FALSE(std::filesystem::exists(cache.pathFor(7)));
+    EXPECT_FALSE(std::filesystem::exists(cache.pathFor(9)));
+    EXPECT_EQ(cache.hits(), 3u);
+}
+
+TEST(PlanCacheTest, EvictsLeastRecentlyUsed) {
+    std::vector<PlanRecord> records = recordRun(100);
+    uint64_t entryBytes = 64 + records.size() * sizeof(PlanRecord);
+    PlanCache cache(cacheDirectory("lru"), 2 * entryBytes);
+
+    ASSERT_TRUE(cache.store(1, records.data(), records.size()));
+    ASSERT_TRUE(cache.store(2, records.data(), records.size()));
+    PlanView plan;
+    ASSERT_TRUE(cache.load(1, plan));               // 2 is now the oldest
+    ASSERT_TRUE(cache.store(3, records.data(), records.size()));
+
+    EXPECT_EQ(cache.sizeBytes(), 2 * entryBytes);
+    EXPECT_TRUE(std::filesystem::exists(cache.pathFor(1)));
+    EXPECT_FALSE(std::filesystem::exists(cache.pathFor(2)));
+    EXPECT_TRUE(std::filesystem::exists(cache.pathFor(3)));
+    EXPECT_EQ(plan.size(), records.size());         // Still mapped, whatever happens on disk
+
+    std::vector<PlanRecord> huge = recordRun(1000);
+    EXPECT_FALSE(cache.store(4, huge.data(), huge.size()));
+}
+
+TEST(PlanCacheTest, RepeatRunsPlayTheStoredPlan) {
+    std::string text;
+    for (int i = 0; i < 4; i++) text += "Typed once, planned once: the second run plays the stored timeline. ";
+    PlanSettings settings;
+    settings.profile = TimingProfile::humanAdvanced();
+    settings.delays = DelayRange{50, 100};
+    settings.imperfections = sessionImperfections();
+    settings.imperfections.correctionProbability = 100;
+    settings.seed = 11;
+
+    PlanCache cache(cacheDirectory("runs"));
+    ScaledClock clock(systemClock(), 1e-4);
+    std::string typed[2];
+    bool hits[2];
+    for (int run = 0; run < 2; run++) {
+        TraceSink keys;
+        TypingPipeline<char> pipeline(&keys, nullptr, settings.profile, settings.delays,
+                                      settings.imperfections);
+        pipeline.setClock(&clock);
+        pipeline.engine().seed(settings.seed);
+
+        CancellationToken stop;
+        uint64_t key = planKey(text.data(), text.size(), settings, keys);
+        hits[run] = pipeline.run(text, key, cache, stop);
+        typed[run] = keys.keys;
+    }
+
+    EXPECT_FALSE(hits[0]);
+    EXPECT_TRUE(hits[1]);
+    EXPECT_EQ(typed[0], typed[1]);
+    EXPECT_NE(typed[0].find('\b'), std::string::npos);
+
+    // Any other input is another entry
+    TraceSink keys;
+    PlanSettings reseeded = settings;
+    reseeded.seed = 12;
+    uint64_t key = planKey(text.data(), text.size(), settings, keys);
+    EXPECT_NE(planKey(text.data(), text.size(), reseeded, keys), key);
+    EXPECT_NE(planKey(text.data(), text.size() - 1, settings, keys), key);
+    RecordingKeyboard<char> unicodeKeys;
+    unicodeKeys.typeEverything = true;
+    const std::string accented = "caf\xc3\xa9";
+    EXPECT_NE(planKey(accented.data(), accented.size(), settings, unicodeKeys),
+              planKey(accented.data(), accented.size(), settings, keys));
+}
+
+// ============================================================================
+// ydotoold Socket Tests
+// ============================================================================
+
+#ifdef __linux__
+
+// Stands in for ydotoold: a bound datagram socket that collects the events
+class FakeYdotoold {
+public:
+    FakeYdotoold()
+        : path_(::testing::TempDir() + "qtype_ydotool_" + std::to_string(getpid()))
+    {
+        unlink(path_.c_str());
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", path_.c_str());
+        fd_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+        bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    }
+
+    ~FakeYdotoold() { stop(); }
+
+    const std::string& path() const { return path_; }
+
+    void stop() {
+        if (fd_ < 0) return;
+        close(fd_);
+        unlink(path_.c_str());
+        fd_ = -1;
+    }
+
+    // Events delivered so far; each datagram must be exactly one event
+    std::vector<input_event> receive() {
+        std::vector<input_event> events;
+        input_event event;
+        ssize_t size;
+        while ((size = recv(fd_, &event, sizeof(event), MSG_DONTWAIT)) > 0) {
+            EXPECT_EQ(size, static_cast<ssize_t>(sizeof(event)));
+            events.push_back(event);
+        }
+        return events;
+    }
+
+    // The key events only, as code and value
+    std::vector<std::pair<int, int>> receiveKeys() {
+        std::vector<std::pair<int, int>> keys;
+        for (const input_event& event : receive()) {
+            if (event.type == EV_KEY) keys.emplace_back(event.code, event.value);
+        }
+        return keys;
+    }
+
+private:
+    std::string path_;
+    int fd_ = -1;
+};
+
+TEST(YdotoolSocketTest, KeysGoOutWithModifiersAndReports) {
+    FakeYdotoold daemon;
+    ManualClock clock;
+    YdotoolKeyboardSimulator<char> keyboard(daemon.path(), KeyboardLayoutType::GERMAN_QWERTZ);
+    ASSERT_TRUE(keyboard.isConnected());
+    keyboard.setClock(&clock);
+
+    keyboard.typeCharacter('@', 50);
+    std::vector<input_event> down = daemon.receive();
+    ASSERT_EQ(down.size(), 4u);             // AltGr, Q, each with its report
+    EXPECT_EQ(down[0].type, EV_KEY);
+    EXPECT_EQ(down[0].code, KEY_RIGHTALT);
+    EXPECT_EQ(down[1].type, EV_SYN);
+    EXPECT_EQ(down[2].code, KEY_Q);
+    EXPECT_EQ(clock.now, 50000);
+
+    // The release waits for the next press
+    keyboard.typeCharacter('Z', 50);
+    std::vector<std::pair<int, int>> expected = {
+        {KEY_Q, 0}, {KEY_RIGHTALT, 0}, {KEY_LEFTSHIFT, 1}, {KEY_Y, 1}};
+    EXPECT_EQ(daemon.receiveKeys(), expected);
+
+    keyboard.flush();
+    expected = {{KEY_Y, 0}, {KEY_LEFTSHIFT, 0}};
+    EXPECT_EQ(daemon.receiveKeys(), expected);
+
+    EXPECT_FALSE(keyboard.canType('^'));        // Dead key
+    EXPECT_TRUE(keyboard.canType('\n'));
+}
+
+TEST(YdotoolSocketTest, MouseAndLostDaemon) {
+    FakeYdotoold daemon;
+    YdotoolMouseSimulator mouse(daemon.path());
+    ASSERT_TRUE(mouse.isConnected());
+
+    mouse.moveRelative(5, -2);
+    mouse.scroll(3);
+    std::vector<input_event> events = daemon.receive();
+    ASSERT_EQ(events.size(), 5u);
+    EXPECT_EQ(events[0].code, REL_X);
+    EXPECT_EQ(events[0].value, 5);
+    EXPECT_EQ(events[1].code, REL_Y);
+    EXPECT_EQ(events[1].value, -2);
+    EXPECT_EQ(events[3].code, REL_WHEEL);
+    EXPECT_EQ(events[3].value, -3);         // Down is negative on the wheel axis
+
+    daemon.stop();
+    mouse.scroll(1);
+    EXPECT_FALSE(mouse.isConnected());
+
+    YdotoolMouseSimulator nobody(daemon.path());
+    EXPECT_FALSE(nobody.isConnected());
+}
+
+#endif // __linux__
+
+// ============================================================================
+// XTest Tests
+// ============================================================================
+
+#ifdef QTYPE_HAVE_XTEST
+
+// Needs an X server: run under xvfb-run (the qtype_core_x11_xvfb test)
+TEST(X11InputTest, TypesIntoAFocusedWindow) {
+    Display* display = std::getenv("DISPLAY") ? XOpenDisplay(nullptr) : nullptr;
+    if (!display) GTEST_SKIP() << "no X display";
+
+    Window window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, 200, 100, 0, 0, 0);
+    XSelectInput(display, window, KeyPressMask | StructureNotifyMask);
+    XMapWindow(display, window);
+    for (XEvent event; XNextEvent(display, &event), event.type != MapNotify;) {}
+    XSetInputFocus(display, window, RevertToParent, CurrentTime);
+    XSync(display, False);
+
+    ManualClock clock;
+    X11KeyboardSimulator<char> keyboard;
+    ASSERT_TRUE(keyboard.isConnected());
+    keyboard.setClock(&clock);
+    EXPECT_TRUE(keyboard.canType('!'));
+    for (char c : std::string("Hi!")) keyboard.typeCharacter(c, 1);
+
+    std::string typed;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (typed.size() < 3 && std::chrono::steady_clock::now() < deadline) {
+        if (!XPending(display)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type != KeyPress) continue;
+
+        char buffer[8];
+        int length = XLookupString(&event.xkey, buffer, sizeof(buffer), nullptr, nullptr);
+        typed.append(buffer, static_cast<size_t>(std::max(length, 0)));
+    }
+    EXPECT_EQ(typed, "Hi!");
+
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+}
+
+#endif // QTYPE_HAVE_XTEST
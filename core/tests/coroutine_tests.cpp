@@ -0,0 +1,191 @@
+// coroutine_tests.cpp - Google Test Unit Tests for the coroutine engine (C++20)
+#include "coroutine_engine.h"
+#include <gtest/gtest.h>
+
+using namespace qtype;
+
+class ManualClock : public IClock {
+public:
+    int64_t now = 0;
+
+    int64_t nowUs() const override { return now; }
+    void sleepUntilUs(int64_t deadlineUs) override { now = std::max(now, deadlineUs); }
+};
+
+// Records keys and waits out each hold on its clock, like the ydotoold and
+// XTest simulators
+class HoldingKeyboard : public IKeyboardSimulator<char> {
+public:
+    explicit HoldingKeyboard(IClock* clock) : clock_(clock) {}
+
+    std::string keys;
+
+    void setClock(IClock* clock) { clock_ = clock; }
+
+    void typeCharacter(char c, int holdTimeMs) override {
+        keys.push_back(c);
+        clock_->sleepForMs(holdTimeMs);
+    }
+    void pressBackspace() override {
+        keys.push_back('\b');
+        clock_->sleepForMs(TypingConstants::BACKSPACE_HOLD_MS);
+    }
+    void releaseAllKeys() override {}
+
+private:
+    IClock* clock_;
+};
+
+static ImperfectionSettings withTypos() {
+    ImperfectionSettings imperfections;
+    imperfections.typoMin = 10;
+    imperfections.typoMax = 20;
+    imperfections.doubleMin = 15;
+    imperfections.doubleMax = 25;
+    return imperfections;
+}
+
+static const std::string TEXT =
+    "The coroutine engine types this the same way the blocking one does. "
+    "Typos, doubled keys and their corrections included!";
+
+// Runs the loop the way a frontend would: sleep until the next timer, run it
+static void runLoop(ManualClock& clock, EventTimers& timers, const bool& running) {
+    while (running) {
+        int ms = timers.msUntilNextRun();
+        ASSERT_GE(ms, 0) << "a running engine always has a timer";
+        clock.now += int64_t(ms) * 1000;
+        timers.run();
+    }
+}
+
+TEST(CoroutineEngineTest, TypesLikeTheBlockingEngine) {
+    ManualClock blockingClock;
+    HoldingKeyboard blockingKeys(&blockingClock);
+    TypingEngine<char> blocking(&blockingKeys, nullptr, TimingProfile::humanAdvanced(),
+                                DelayRange{80, 180}, withTypos());
+    blocking.setClock(&blockingClock);
+    blocking.seed(1);
+    blocking.setText(TEXT);
+    while (blocking.hasMoreToType()) {
+        blockingClock.sleepForMs(blocking.typeNextChunk());
+    }
+
+    ManualClock clock;
+    EventTimers timers(clock);
+    HoldingKeyboard keys(nullptr);
+    CoroutineTypingEngine<char> engine(&keys, nullptr, TimingProfile::humanAdvanced(),
+                                       DelayRange{80, 180}, withTypos());
+    keys.setClock(&engine.holdClock());
+    engine.engine().seed(1);
+    engine.engine().setText(TEXT);
+
+    bool running = true;
+    engine.start(timers, [&running] { running = false; });
+    EXPECT_TRUE(engine.isRunning());
+    EXPECT_LT(keys.keys.size(), TEXT.size());       // Returned at the first wait
+    runLoop(clock, timers, running);
+
+    EXPECT_FALSE(engine.isRunning());
+    EXPECT_EQ(keys.keys, blockingKeys.keys);
+    EXPECT_NE(keys.keys.find('\b'), std::string::npos);
+
+    // Same waits, give or take the timers' millisecond ticks
+    EXPECT_NEAR(double(clock.now), double(blockingClock.now), 0.01 * blockingClock.now);
+}
+
+TEST(CoroutineEngineTest, StopWakesTheSleepingTask) {
+    ManualClock clock;
+    EventTimers timers(clock);
+    HoldingKeyboard keys(nullptr);
+    CoroutineTypingEngine<char> engine(&keys, nullptr, TimingProfile::humanAdvanced(),
+                                       DelayRange{1000, 2000}, withTypos());
+    keys.setClock(&engine.holdClock());
+    engine.engine().setText(TEXT);
+
+    int finished = 0;
+    engine.start(timers, [&finished] { finished++; });
+    clock.now += int64_t(timers.msUntilNextRun()) * 1000;
+    timers.run();
+    ASSERT_TRUE(engine.isRunning());
+    size_t typed = keys.keys.size();
+
+    engine.stop();
+    EXPECT_FALSE(engine.isRunning());
+    EXPECT_EQ(finished, 1);
+    EXPECT_EQ(timers.msUntilNextRun(), -1);
+    EXPECT_EQ(keys.keys.size(), typed);
+    EXPECT_TRUE(engine.engine().hasMoreToType());
+
+    // And starts again where it stopped
+    bool running = true;
+    engine.start(timers, [&running] { running = false; });
+    runLoop(clock, timers, running);
+    EXPECT_FALSE(engine.engine().hasMoreToType());
+}
+
+// Stops its engine after a number of keys, from inside the keystroke
+class StoppingKeyboard : public HoldingKeyboard {
+public:
+    using HoldingKeyboard::HoldingKeyboard;
+
+    std::function<void()> stop;
+    int stopAfterKeys = -1;
+
+    void typeCharacter(char c, int holdTimeMs) override {
+        HoldingKeyboard::typeCharacter(c, holdTimeMs);
+        if (--stopAfterKeys == 0) stop();
+    }
+    void pressBackspace() override {
+        HoldingKeyboard::pressBackspace();
+        if (--stopAfterKeys == 0) stop();
+    }
+};
+
+// What the keys leave on screen
+static std::string onScreen(const std::string& keys) {
+    std::string text;
+    for (char c : keys) {
+        if (c != '\b') text.push_back(c);
+        else if (!text.empty()) text.pop_back();
+    }
+    return text;
+}
+
+TEST(CoroutineEngineTest, StopInsideAChunkResumesAtTheNextCharacter) {
+    // Every typo corrected, so all that reaches the screen is the text
+    ImperfectionSettings corrections;
+    corrections.enableDoubleKeys = false;
+    corrections.typoMin = 3;
+    corrections.typoMax = 6;
+    corrections.correctionProbability = 100;
+
+    for (int stopAfter = 1; stopAfter < static_cast<int>(TEXT.size()); stopAfter++) {
+        ManualClock clock;
+        EventTimers timers(clock);
+        StoppingKeyboard keys(nullptr);
+        CoroutineTypingEngine<char> engine(&keys, nullptr, TimingProfile::humanAdvanced(),
+                                           DelayRange{80, 180}, corrections);
+        keys.setClock(&engine.holdClock());
+        keys.stop = [&engine] { engine.stop(); };
+        keys.stopAfterKeys = stopAfter;
+        engine.engine().seed(1);
+        engine.engine().setText(TEXT);
+
+        bool running = true;
+        engine.start(timers, [&running] { running = false; });
+        runLoop(clock, timers, running);
+        SessionState saved = engine.engine().checkpoint();
+
+        HoldingKeyboard rest(nullptr);
+        CoroutineTypingEngine<char> resumed(&rest, nullptr, TimingProfile::humanAdvanced(),
+                                            DelayRange{80, 180}, corrections);
+        rest.setClock(&resumed.holdClock());
+        ASSERT_TRUE(resumed.engine().resume(TEXT, saved));
+        running = true;
+        resumed.start(timers, [&running] { running = false; });
+        runLoop(clock, timers, running);
+
+        EXPECT_EQ(onScreen(keys.keys) + onScreen(rest.keys), TEXT) << "stopped after " << stopAfter << " keys";
+    }
+}
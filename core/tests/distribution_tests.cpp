@@ -0,0 +1,287 @@
+// distribution_tests.cpp - Reference vs candidate samplers, by distribution
+//
+// Fast paths that only approximate the reference samplers (compile-time
+// gamma constants, table-based normals, recurrences in place of sin) can't
+// match the golden traces bit for bit; what must not change is the
+// distribution they draw from. For every sampler pair this draws
+// QTYPE_DIST_SAMPLES values (default 2^20) from each side with independent
+// seeds and runs two-sample Kolmogorov-Smirnov and Anderson-Darling tests.
+// Pairs are spread over all cores. A pair fails when either test rejects
+// at the 0.1% level; seeds are fixed, so results are repeatable.
+#include "typing_core.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace qtype;
+
+namespace {
+
+constexpr double REJECT_BELOW = 0.001;
+
+// Anderson-Darling critical values for two samples (Scholz & Stephens 1987,
+// k = 2), from the most to the least significant
+constexpr double AD_LEVELS[] = {0.25, 0.10, 0.05, 0.025, 0.01, 0.005, 0.001};
+constexpr double AD_CRITICAL[] = {0.325, 1.226, 1.961, 2.718, 3.752, 4.592, 6.546};
+constexpr double AD_REJECT = AD_CRITICAL[6];
+
+size_t sampleCount() {
+    if (const char* samples = std::getenv("QTYPE_DIST_SAMPLES")) {
+        long long count = std::atoll(samples);
+        if (count >= 1000) return static_cast<size_t>(count);
+    }
+    return size_t(1) << 20;
+}
+
+// ============================================================================
+// Two-Sample Tests
+// ============================================================================
+
+struct Comparison {
+    double ksD = 0.0;           // Largest gap between the empirical CDFs
+    double ksP = 1.0;
+    double adT = 0.0;           // Standardized statistic
+    double adP = 1.0;           // Interpolated, so only within the table's range
+};
+
+// Asymptotic Kolmogorov distribution, with Stephens' small-sample correction
+double ksPValue(double d, size_t n, size_t m) {
+    double en = std::sqrt(double(n) * double(m) / double(n + m));
+    double lambda = (en + 0.12 + 0.11 / en) * d;
+    if (lambda < 0.2) return 1.0;
+
+    double sum = 0.0;
+    for (int j = 1; j <= 100; j++) {
+        double term = std::exp(-2.0 * j * j * lambda * lambda);
+        sum += (j % 2 ? 1.0 : -1.0) * term;
+        if (term < 1e-12) break;
+    }
+    return std::min(1.0, std::max(0.0, 2.0 * sum));
+}
+
+double adPValue(double t) {
+    if (t <= AD_CRITICAL[0]) return AD_LEVELS[0];
+    constexpr int last = sizeof(AD_LEVELS) / sizeof(AD_LEVELS[0]) - 1;
+    if (t >= AD_CRITICAL[last]) return AD_LEVELS[last];
+    int i = 0;
+    while (t > AD_CRITICAL[i + 1]) i++;
+    double f = (t - AD_CRITICAL[i]) / (AD_CRITICAL[i + 1] - AD_CRITICAL[i]);
+    return std::exp(std::log(AD_LEVELS[i]) + f * (std::log(AD_LEVELS[i + 1]) - std::log(AD_LEVELS[i])));
+}
+
+// Both tests in one pass over the pooled order. a and b are sorted.
+Comparison compare(const std::vector<double>& a, const std::vector<double>& b) {
+    const double n1 = double(a.size());
+    const double n2 = double(b.size());
+    const double total = n1 + n2;
+
+    Comparison result;
+    size_t i = 0, j = 0;
+    double sum1 = 0.0, sum2 = 0.0;      // Anderson-Darling terms per sample
+    while (i < a.size() || j < b.size()) {
+        // Ties move together, so the CDFs are compared between values
+        double x = (j == b.size() || (i < a.size() && a[i] <= b[j])) ? a[i] : b[j];
+        while (i < a.size() && a[i] == x) i++;
+        while (j < b.size() && b[j] == x) j++;
+
+        double seen = double(i + j);
+        result.ksD = std::max(result.ksD, std::fabs(double(i) / n1 - double(j) / n2));
+        if (seen < total) {
+            double weight = seen * (total - seen);
+            double d1 = total * double(i) - seen * n1;
+            double d2 = total * double(j) - seen * n2;
+            sum1 += d1 * d1 / weight;
+            sum2 += d2 * d2 / weight;
+        }
+    }
+    result.ksP = ksPValue(result.ksD, a.size(), b.size());
+
+    // A2 and its variance under the null for k = 2; the double sum in the
+    // variance tends to pi^2/6 and is taken at its limit
+    double a2 = (sum1 / n1 + sum2 / n2) / total;
+    double h = 0.0;
+    for (double k = 1; k < total; k++) h += 1.0 / k;
+    const double g = 1.6449340668482264;
+    const double k = 2.0;
+    double H = 1.0 / n1 + 1.0 / n2;
+    double va = (4 * g - 6) * (k - 1) + (10 - 6 * g) * H;
+    double vb = (2 * g - 4) * k * k + 8 * h * k + (2 * g - 14 * h - 4) * H - 8 * h + 4 * g - 6;
+    double vc = (6 * h + 2 * g - 2) * k * k + (4 * h - 4 * g + 6) * k + (2 * h - 6) * H + 4 * h;
+    double vd = (2 * h + 6) * k * k - 4 * h * k;
+    double N = total;
+    double variance = (va * N * N * N + vb * N * N + vc * N + vd) / ((N - 1) * (N - 2) * (N - 3));
+
+    result.adT = (a2 - (k - 1)) / std::sqrt(variance);
+    result.adP = adPValue(result.adT);
+    return result;
+}
+
+// ============================================================================
+// Sampler Pairs
+// ============================================================================
+
+using Sampler = std::function<double(Random&)>;
+
+struct SamplerPair {
+    std::string name;
+    Sampler reference;
+    Sampler candidate;
+};
+
+struct NamedProfile {
+    const char* name;
+    TimingProfile profile;
+};
+
+const NamedProfile PROFILES[] = {
+    {"humanAdvanced", TimingProfile::humanAdvanced()},
+    {"fastHuman", TimingProfile::fastHuman()},
+    {"slowTired", TimingProfile::slowTired()},
+    {"professional", TimingProfile::professional()},
+};
+
+// Reference: what Random does at run time. Candidate: the fast path the
+// engine takes instead; add a pair here with every new one.
+std::vector<SamplerPair> samplerPairs() {
+    std::vector<SamplerPair> pairs;
+
+    // Marsaglia-Tsang constants worked out at compile time (StaticProfile)
+    // and ziggurat normals, versus constants at the call and Box-Muller
+    auto gammaPair = [](std::string name, double shape, double scale) {
+        GammaParams params = GammaParams::of(shape);
+        return SamplerPair{std::move(name),
+                           [shape, scale](Random& rng) { return rng.gamma(shape, scale); },
+                           [params, scale](Random& rng) { return rng.fastGamma(params, scale); }};
+    };
+
+    for (const NamedProfile& p : PROFILES) {
+        std::string prefix = std::string(p.name) + " ";
+        pairs.push_back(gammaPair(prefix + "delay gamma", p.profile.gammaShape, p.profile.gammaScale));
+
+        double noise = p.profile.noiseLevel;
+        pairs.push_back({prefix + "noise normal",
+                         [noise](Random& rng) { return rng.normal(0.0, noise); },
+                         [noise](Random& rng) { return rng.fastNormal(0.0, noise); }});
+    }
+
+    pairs.push_back(gammaPair("hold gamma", 2.5, 20.0));
+    pairs.push_back(gammaPair("sentence pause gamma", 2.0, 150.0));
+    pairs.push_back(gammaPair("thinking pause gamma", 3.0, 800.0));
+    pairs.push_back(gammaPair("gamma below shape 1", 0.5, 1.0));
+
+    // Only the wedges and the tail leave the ziggurat's fast path; check
+    // they're drawn right where most of the rest isn't
+    pairs.push_back({"normal beyond 2 sd",
+                     [](Random& rng) {
+                         double x;
+                         do x = rng.normal(0.0, 1.0); while (std::fabs(x) < 2.0);
+                         return x;
+                     },
+                     [](Random& rng) {
+                         double x;
+                         do x = rng.fastNormal(0.0, 1.0); while (std::fabs(x) < 2.0);
+                         return x;
+                     }});
+    return pairs;
+}
+
+struct Outcome {
+    std::string name;
+    Comparison comparison;
+};
+
+std::vector<double> draw(const Sampler& sampler, uint64_t seed, size_t count) {
+    Random rng(seed);
+    std::vector<double> samples(count);
+    for (double& sample : samples) sample = sampler(rng);
+    std::sort(samples.begin(), samples.end());
+    return samples;
+}
+
+// One pair per task, as many workers as cores
+std::vector<Outcome> runPairs(const std::vector<SamplerPair>& pairs, size_t samples) {
+    std::vector<Outcome> outcomes(pairs.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next++; i < pairs.size(); i = next++) {
+            std::vector<double> reference = draw(pairs[i].reference, 1000 + i, samples);
+            std::vector<double> candidate = draw(pairs[i].candidate, 2000 + i, samples);
+            outcomes[i] = {pairs[i].name, compare(reference, candidate)};
+        }
+    };
+
+    unsigned workers = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                      static_cast<unsigned>(pairs.size())));
+    std::vector<std::thread> threads;
+    for (unsigned w = 1; w < workers; w++) threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads) thread.join();
+    return outcomes;
+}
+
+void report(const std::vector<Outcome>& outcomes, size_t samples) {
+    std::printf("%zu samples per side, reject below p = %g\n", samples, REJECT_BELOW);
+    std::printf("%-32s %10s %10s %10s %10s\n", "sampler", "KS D", "KS p", "AD T", "AD p");
+    for (const Outcome& outcome : outcomes) {
+        const Comparison& c = outcome.comparison;
+        std::printf("%-32s %10.6f %10.4f %10.3f %10.4f\n", outcome.name.c_str(), c.ksD, c.ksP, c.adT, c.adP);
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+TEST(DistributionTest, CandidatesDrawFromTheReferenceDistributions) {
+    size_t samples = sampleCount();
+    std::vector<Outcome> outcomes = runPairs(samplerPairs(), samples);
+    report(outcomes, samples);
+
+    for (const Outcome& outcome : outcomes) {
+        EXPECT_GE(outcome.comparison.ksP, REJECT_BELOW) << outcome.name << ": KS D = " << outcome.comparison.ksD;
+        EXPECT_LE(outcome.comparison.adT, AD_REJECT) << outcome.name;
+    }
+}
+
+// The harness has to notice a sampler that is only slightly off
+TEST(DistributionTest, RejectsASlightlyWrongSampler) {
+    std::vector<SamplerPair> pairs = {
+        {"gamma scaled 2% up",
+         [](Random& rng) { return rng.gamma(2.0, 1.0); },
+         [](Random& rng) { return rng.gamma(2.0, 1.02); }},
+        {"normal shifted 0.01 sd",
+         [](Random& rng) { return rng.normal(0.0, 1.0); },
+         [](Random& rng) { return rng.normal(0.01, 1.0); }},
+    };
+    std::vector<Outcome> outcomes = runPairs(pairs, sampleCount());
+    report(outcomes, sampleCount());
+
+    for (const Outcome& outcome : outcomes) {
+        EXPECT_LT(outcome.comparison.ksP, REJECT_BELOW) << outcome.name;
+        EXPECT_GT(outcome.comparison.adT, AD_REJECT) << outcome.name;
+    }
+}
+
+TEST(DistributionTest, StatisticsOfKnownSamples) {
+    // Identical samples: no gap at all
+    std::vector<double> a = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    Comparison same = compare(a, a);
+    EXPECT_DOUBLE_EQ(same.ksD, 0.0);
+    EXPECT_DOUBLE_EQ(same.ksP, 1.0);
+
+    // Disjoint samples: the CDFs are a whole step apart
+    std::vector<double> b = {11, 12, 13, 14, 15, 16, 17, 18, 19, 20};
+    Comparison apart = compare(a, b);
+    EXPECT_DOUBLE_EQ(apart.ksD, 1.0);
+    EXPECT_LT(apart.ksP, 0.001);
+    EXPECT_GT(apart.adT, AD_CRITICAL[4]);
+}
@@ -0,0 +1,319 @@
+// golden_tests.cpp - Bit-exact golden traces of the engine and its kernels
+//
+// Runs fixed seeds over a fixed corpus (input.txt and a few texts that hit
+// the special cases) and compares every event - characters, holds, pauses,
+// delays, flags and random draws, doubles in hex - with the traces checked
+// in under tests/golden. An optimization of the random stream, the
+// dynamics, the imperfections or the chunker has to reproduce them exactly;
+// the first event that differs is reported.
+//
+// Changing behavior on purpose means regenerating the goldens and
+// reviewing their diff:
+//     QTYPE_UPDATE_GOLDEN=1 ./qtype_core_golden_tests   (or: make update_golden)
+// Traces hold libm results (sin, log, pow), so they are generated on
+// x86-64 glibc; other C libraries may differ in the last bit.
+#include "typing_core.h"
+#include <gtest/gtest.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+using namespace qtype;
+
+namespace {
+
+// ============================================================================
+// Traces
+// ============================================================================
+
+class Trace {
+public:
+    void add(const char* format, ...) {
+        char line[128];
+        va_list args;
+        va_start(args, format);
+        std::vsnprintf(line, sizeof line, format, args);
+        va_end(args);
+        events_.emplace_back(line);
+    }
+
+    const std::vector<std::string>& events() const { return events_; }
+
+private:
+    std::vector<std::string> events_;
+};
+
+bool updating() {
+    const char* update = std::getenv("QTYPE_UPDATE_GOLDEN");
+    return update && *update && std::string(update) != "0";
+}
+
+std::string goldenPath(const std::string& name) {
+    return std::string(QTYPE_GOLDEN_DIR) + "/" + name + ".trace";
+}
+
+// Compares with the golden trace, or rewrites it in update mode
+void checkGolden(const std::string& name, const std::string& description, const Trace& trace) {
+    const std::vector<std::string>& actual = trace.events();
+    std::string path = goldenPath(name);
+
+    if (updating()) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        ASSERT_TRUE(file) << "can't write " << path;
+        file << "# " << description << "\n";
+        for (const std::string& event : actual) file << event << "\n";
+        return;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    ASSERT_TRUE(file) << "no golden trace " << path
+                      << "; generate it with QTYPE_UPDATE_GOLDEN=1";
+    std::vector<std::string> golden;
+    for (std::string line; std::getline(file, line);) {
+        if (!line.empty() && line[0] != '#') golden.push_back(line);
+    }
+
+    size_t common = std::min(golden.size(), actual.size());
+    for (size_t i = 0; i < common; i++) {
+        if (golden[i] == actual[i]) continue;
+
+        std::string context;
+        for (size_t j = i > 3 ? i - 3 : 0; j < i; j++) context += "\n    " + golden[j];
+        ADD_FAILURE() << name << ": first divergence at event " << i
+                      << "\n  expected: " << golden[i]
+                      << "\n  actual:   " << actual[i]
+                      << "\n  after:" << (context.empty() ? " (start of trace)" : context);
+        return;
+    }
+    EXPECT_EQ(actual.size(), golden.size())
+        << name << ": the traces agree for " << common << " events, then "
+        << (actual.size() < golden.size() ? "the run ends early" : "the run goes on past the golden");
+}
+
+// ============================================================================
+// Corpus
+// ============================================================================
+
+const std::string& inputText() {
+    static const std::string text = [] {
+        std::ifstream file(QTYPE_GOLDEN_INPUT, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }();
+    return text;
+}
+
+// Digits, capitals, newlines, tabs, punctuation runs, long words and
+// characters outside ASCII
+const std::string MIXED_TEXT =
+    "Invoice #2024-117: 3 items, $42.50 total.\n"
+    "\tWAIT... Really?! Yes -- \"quoted\" (and nested [brackets]).\n"
+    "Supercalifragilisticexpialidocious antidisestablishmentarianism\n"
+    "Caf\xc3\xa9 na\xc3\xafve \xe2\x80\x94 r\xc3\xa9sum\xc3\xa9; x=y+z*2/7%3 & a|b ~c^d @e\n";
+
+const std::u16string MIXED_TEXT_16 =
+    u"Invoice #2024-117: 3 items, $42.50 total.\n"
+    u"\tWAIT... Really?! Yes -- \"quoted\" (and nested [brackets]).\n"
+    u"Café naïve — résumé; x=y+z*2/7%3 & a|b ~c^d @e\n";
+
+ImperfectionSettings frequentImperfections() {
+    ImperfectionSettings settings;
+    settings.typoMin = 20;
+    settings.typoMax = 40;
+    settings.doubleMin = 30;
+    settings.doubleMax = 50;
+    settings.correctionProbability = 60;
+    return settings;
+}
+
+// ============================================================================
+// Recorders
+// ============================================================================
+
+// Keyboard, mouse and clock in one: every call the engine makes becomes an
+// event, and time only moves on paper
+template<typename CharT>
+class TraceRecorder : public IKeyboardSimulator<CharT>, public IMouseSimulator, public IClock {
+public:
+    explicit TraceRecorder(Trace& trace) : trace_(trace) {}
+
+    void typeCharacter(CharT c, int holdTimeMs) override {
+        trace_.add("k %u %d", unsigned(CharTraits<CharT>::code(c)), holdTimeMs);
+    }
+    void pressBackspace() override { trace_.add("b"); }
+    void releaseAllKeys() override { trace_.add("r"); }
+    void flush() override { trace_.add("f"); }
+
+    void moveRelative(int deltaX, int deltaY) override { trace_.add("m %d %d", deltaX, deltaY); }
+    void scroll(int amount) override { trace_.add("s %d", amount); }
+
+    int64_t nowUs() const override { return nowUs_; }
+    void sleepUntilUs(int64_t deadlineUs) override {
+        trace_.add("p %lld", static_cast<long long>(deadlineUs - nowUs_));
+        nowUs_ = std::max(nowUs_, deadlineUs);
+    }
+
+private:
+    Trace& trace_;
+    int64_t nowUs_ = 0;
+};
+
+struct EngineCase {
+    TimingProfile profile;
+    DelayRange delays;
+    ImperfectionSettings imperfections;
+    uint64_t seed;
+    bool mouse;
+};
+
+// The whole run: keystrokes and pauses, then each chunk's delay and position
+template<typename CharT, typename Profile = DynamicProfile>
+Trace engineTrace(const std::basic_string<CharT>& text, const EngineCase& run) {
+    Trace trace;
+    TraceRecorder<CharT> recorder(trace);
+    TypingEngine<CharT, CharTraits<CharT>, Profile> engine(
+        &recorder, &recorder, run.profile, run.delays, run.imperfections);
+    engine.setClock(&recorder);
+    engine.seed(run.seed);
+    engine.setMouseMovementEnabled(run.mouse);
+    engine.setText(text);
+    while (engine.hasMoreToType()) {
+        int delay = engine.typeNextChunk();
+        trace.add("d %d %d", delay, engine.currentPosition());
+    }
+    trace.add("skipped %d", engine.getSkippedCharCount());
+    return trace;
+}
+
+// The dynamics on their own, the way the engine drives them per character:
+// hold, burst and thinking flags, delay
+template<typename Profile = DynamicProfile>
+Trace dynamicsTrace(const TimingProfile& profile, uint64_t seed) {
+    Trace trace;
+    Random rng(seed);
+    TypingDynamics<char, CharTraits<char>, Profile> dynamics(profile, DelayRange{80, 180}, rng);
+
+    int words = 0;
+    for (char ch : inputText()) {
+        int hold = dynamics.generateHoldTime(ch);
+        bool sentenceEnd = ch == '.' || ch == '!' || ch == '?';
+        bool burst = dynamics.shouldBurst();
+        bool thinking = dynamics.shouldThinkingPause(words);
+        if (thinking) words = 0;
+        if (ch == ' ') words++;
+
+        int delay = dynamics.calculateDelay(ch, sentenceEnd, burst, thinking);
+        dynamics.updateState(ch);
+        trace.add("%u %d %d %c%c%c", unsigned(static_cast<unsigned char>(ch)), hold, delay,
+                  sentenceEnd ? 'S' : '-', burst ? 'B' : '-', thinking ? 'T' : '-');
+    }
+    return trace;
+}
+
+const char* profileName(int index) {
+    static const char* const names[] = {"humanAdvanced", "fastHuman", "slowTired", "professional"};
+    return names[index];
+}
+
+TimingProfile profileAt(int index) {
+    switch (index) {
+        case 0: return TimingProfile::humanAdvanced();
+        case 1: return TimingProfile::fastHuman();
+        case 2: return TimingProfile::slowTired();
+        default: return TimingProfile::professional();
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// Golden Traces
+// ============================================================================
+
+TEST(GoldenTraceTest, CorpusIsThere) {
+    ASSERT_FALSE(inputText().empty()) << "can't read " << QTYPE_GOLDEN_INPUT;
+}
+
+// Every sampler, bit for bit
+TEST(GoldenTraceTest, RandomStreams) {
+    const double shapes[] = {0.5, 1.5, 1.8, 2.0, 2.2, 2.5, 3.0};
+    for (uint64_t seed : {uint64_t(1), uint64_t(2026)}) {
+        Trace trace;
+        Random rng(seed);
+        for (int i = 0; i < 200; i++) {
+            trace.add("u %a", rng.uniform());
+            trace.add("n %a", rng.normal(0.0, 1.0));
+            trace.add("r %d", rng.range(-50, 50));
+            for (double shape : shapes) trace.add("g %a", rng.gamma(shape, 1.0));
+            trace.add("G %a", rng.gamma(GammaParams::of(shapes[i % 7]), 20.0));
+        }
+        checkGolden("random_seed" + std::to_string(seed),
+                    "uniform, normal, range and gamma draws, seed " + std::to_string(seed), trace);
+    }
+}
+
+TEST(GoldenTraceTest, Chunker) {
+    auto chunks = [](const std::string& text, size_t pieceSize) {
+        Trace trace;
+        TextChunker<char> chunker;
+        chunker.setText(std::string());
+        for (size_t offset = 0; offset < text.size(); offset += pieceSize) {
+            chunker.append(text.data() + offset, std::min(pieceSize, text.size() - offset));
+            while (chunker.hasMore()) {
+                int position = chunker.currentPosition();
+                trace.add("%d %zu", position, chunker.next().size);
+            }
+        }
+        return trace;
+    };
+
+    checkGolden("chunks_input", "chunk positions and sizes over input.txt",
+                chunks(inputText(), inputText().size()));
+    checkGolden("chunks_input_appended", "input.txt appended 37 characters at a time",
+                chunks(inputText(), 37));
+    checkGolden("chunks_mixed", "chunk positions and sizes over the mixed text",
+                chunks(MIXED_TEXT, MIXED_TEXT.size()));
+}
+
+// Hold, flags and delay per character of input.txt, per profile. The
+// compile-time profiles must match the run-time ones exactly.
+TEST(GoldenTraceTest, Dynamics) {
+    for (int i = 0; i < 4; i++) {
+        std::string name = std::string("dynamics_") + profileName(i);
+        std::string description = std::string("hold, delay and S/B/T flags per character of input.txt, ") +
+                                  profileName(i) + ", seed 7";
+        checkGolden(name, description, dynamicsTrace(profileAt(i), 7));
+    }
+    if (updating()) return;
+    checkGolden("dynamics_humanAdvanced", "", dynamicsTrace<HumanAdvancedProfile>(TimingProfile(), 7));
+    checkGolden("dynamics_fastHuman", "", dynamicsTrace<FastHumanProfile>(TimingProfile(), 7));
+    checkGolden("dynamics_slowTired", "", dynamicsTrace<SlowTiredProfile>(TimingProfile(), 7));
+    checkGolden("dynamics_professional", "", dynamicsTrace<ProfessionalProfile>(TimingProfile(), 7));
+}
+
+TEST(GoldenTraceTest, EngineRuns) {
+    EngineCase human{TimingProfile::humanAdvanced(), DelayRange{80, 180}, ImperfectionSettings(), 1, true};
+    checkGolden("engine_input_human_seed1",
+                "engine over input.txt: humanAdvanced, 80-180 ms, default imperfections, mouse, seed 1",
+                engineTrace(inputText(), human));
+
+    EngineCase professional{TimingProfile::professional(), DelayRange{50, 120}, frequentImperfections(), 2026, false};
+    checkGolden("engine_input_professional_seed2026",
+                "engine over input.txt: professional, 50-120 ms, frequent imperfections, seed 2026",
+                engineTrace(inputText(), professional));
+
+    EngineCase tired{TimingProfile::slowTired(), DelayRange{120, 400}, frequentImperfections(), 3, true};
+    checkGolden("engine_mixed_tired_seed3",
+                "engine over the mixed text: slowTired, 120-400 ms, frequent imperfections, mouse, seed 3",
+                engineTrace(MIXED_TEXT, tired));
+    checkGolden("engine_mixed16_tired_seed3",
+                "char16_t engine over the mixed text: slowTired, 120-400 ms, frequent imperfections, mouse, seed 3",
+                engineTrace(MIXED_TEXT_16, tired));
+
+    if (updating()) return;
+    checkGolden("engine_input_human_seed1", "",
+                engineTrace<char, HumanAdvancedProfile>(inputText(), human));
+    checkGolden("engine_input_professional_seed2026", "",
+                engineTrace<char, ProfessionalProfile>(inputText(), professional));
+}
@@ -0,0 +1,558 @@
+// typing_core.cpp - Non-template parts of the typing core and the
+// instantiations for the standard character types
+#include "typing_core.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace qtype {
+
+// ============================================================================
+// Random
+// ============================================================================
+
+Random::Random() {
+    std::random_device rd;
+    seed((static_cast<uint64_t>(rd()) << 32) ^ rd());
+}
+
+Random::Random(uint64_t seed) {
+    this->seed(seed);
+}
+
+// Expands the seed with splitmix64, as recommended for xoshiro
+void Random::seed(uint64_t seed) {
+    for (uint64_t& word : s_) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        word = z ^ (z >> 31);
+    }
+    hasSpare_ = false;
+}
+
+double Random::normal(double mean, double stddev) {
+    if (hasSpare_) {
+        hasSpare_ = false;
+        return mean + stddev * spare_;
+    }
+
+    double u, v, s;
+    do {
+        u = uniform() * 2.0 - 1.0;
+        v = uniform() * 2.0 - 1.0;
+        s = u * u + v * v;
+    } while (s >= 1.0 || s == 0.0);
+
+    s = std::sqrt(-2.0 * std::log(s) / s);
+    spare_ = v * s;
+    hasSpare_ = true;
+
+    return mean + stddev * u * s;
+}
+
+double Random::gamma(double shape, double scale) {
+    GammaParams params;
+    double boosted = shape < 1.0 ? shape + 1.0 : shape;
+    params.d = boosted - 1.0 / 3.0;
+    params.c = 1.0 / std::sqrt(9.0 * params.d);
+    params.invShape = shape < 1.0 ? 1.0 / shape : 0.0;
+    return gamma(params, scale);
+}
+
+// Doornik's construction: the base strip and the 127 layers above it all
+// have area AREA
+detail::Ziggurat::Ziggurat() {
+    double f = std::exp(-0.5 * TAIL * TAIL);
+    x[0] = AREA / f;
+    x[1] = TAIL;
+    x[LAYERS] = 0.0;
+    for (int i = 2; i < LAYERS; ++i) {
+        x[i] = std::sqrt(-2.0 * std::log(AREA / x[i - 1] + f));
+        f = std::exp(-0.5 * x[i] * x[i]);
+    }
+    for (int i = 0; i < LAYERS; ++i) {
+        ratio[i] = x[i + 1] / x[i];
+    }
+}
+
+double Random::zigguratEdge(int layer, double u) {
+    const detail::Ziggurat& z = detail::ziggurat();
+    while (true) {
+        if (layer == 0) {
+            // Beyond TAIL: Marsaglia's exponential rejection
+            double x, y;
+            do {
+                x = std::log(1.0 - uniform()) / detail::Ziggurat::TAIL;
+                y = std::log(1.0 - uniform());
+            } while (-2.0 * y < x * x);
+            return u < 0.0 ? x - detail::Ziggurat::TAIL : detail::Ziggurat::TAIL - x;
+        }
+
+        // In the wedge between the layer's rectangle and the curve
+        double x = u * z.x[layer];
+        double below = std::exp(-0.5 * (z.x[layer] * z.x[layer] - x * x));
+        double above = std::exp(-0.5 * (z.x[layer + 1] * z.x[layer + 1] - x * x));
+        if (above + uniform() * (below - above) < 1.0) {
+            return x;
+        }
+
+        uint64_t bits = next();
+        layer = static_cast<int>(bits & (detail::Ziggurat::LAYERS - 1));
+        u = (bits >> 11) * 0x1.0p-52 - 1.0;
+        if (std::fabs(u) < z.ratio[layer]) {
+            return u * z.x[layer];
+        }
+    }
+}
+
+Random& RandomGenerator::local() {
+    thread_local Random rng;
+    return rng;
+}
+
+// ============================================================================
+// SessionState
+// ============================================================================
+
+namespace {
+
+constexpr char SESSION_MAGIC[4] = {'Q', 'T', 'S', '2'};
+
+class ByteWriter {
+public:
+    void u8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) u8(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; ++i) u8(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void i32(int v) { u32(static_cast<uint32_t>(v)); }
+
+    void f64(double v) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof bits);
+        u64(bits);
+    }
+
+    std::string take() { return std::move(out_); }
+
+private:
+    std::string out_;
+};
+
+class ByteReader {
+public:
+    explicit ByteReader(const std::string& in) : in_(in) {}
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return pos_ == in_.size(); }
+
+    uint8_t u8() {
+        if (pos_ >= in_.size()) {
+            ok_ = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(in_[pos_++]);
+    }
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= uint32_t(u8()) << (8 * i);
+        return v;
+    }
+
+    uint64_t u64() {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) v |= uint64_t(u8()) << (8 * i);
+        return v;
+    }
+
+    int i32() { return static_cast<int>(u32()); }
+
+    double f64() {
+        uint64_t bits = u64();
+        double v;
+        std::memcpy(&v, &bits, sizeof v);
+        return v;
+    }
+
+private:
+    const std::string& in_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+} // namespace
+
+std::string SessionState::serialize() const {
+    ByteWriter w;
+    for (char c : SESSION_MAGIC) w.u8(static_cast<uint8_t>(c));
+
+    w.u64(textHash);
+    w.i32(textLength);
+    w.i32(position);
+
+    for (uint64_t word : rng.s) w.u64(word);
+    w.f64(rng.spare);
+    w.u8(rng.hasSpare ? 1 : 0);
+
+    w.u32(static_cast<uint32_t>(previousChar));
+    w.f64(rhythmSin);
+    w.f64(rhythmCos);
+    w.f64(fatigueFactor);
+    w.i32(burstRemaining);
+    w.i32(totalCharsTyped);
+
+    w.i32(charsTypedTotal);
+    w.i32(charsSinceLastTypo);
+    w.i32(charsSinceLastDouble);
+    w.i32(nextTypoAt);
+    w.i32(nextDoubleAt);
+
+    w.i32(wordsSinceBreak);
+    w.i32(charsSinceMouseMove);
+    w.i32(nextMouseMoveAt);
+    w.i32(skippedCharCount);
+    return w.take();
+}
+
+bool SessionState::deserialize(const std::string& data, SessionState& out) {
+    ByteReader r(data);
+    for (char c : SESSION_MAGIC) {
+        if (r.u8() != static_cast<uint8_t>(c)) return false;
+    }
+
+    SessionState state;
+    state.textHash = r.u64();
+    state.textLength = r.i32();
+    state.position = r.i32();
+
+    for (uint64_t& word : state.rng.s) word = r.u64();
+    state.rng.spare = r.f64();
+    state.rng.hasSpare = r.u8() != 0;
+
+    state.previousChar = r.u32();
+    state.rhythmSin = r.f64();
+    state.rhythmCos = r.f64();
+    state.fatigueFactor = r.f64();
+    state.burstRemaining = r.i32();
+    state.totalCharsTyped = r.i32();
+
+    state.charsTypedTotal = r.i32();
+    state.charsSinceLastTypo = r.i32();
+    state.charsSinceLastDouble = r.i32();
+    state.nextTypoAt = r.i32();
+    state.nextDoubleAt = r.i32();
+
+    state.wordsSinceBreak = r.i32();
+    state.charsSinceMouseMove = r.i32();
+    state.nextMouseMoveAt = r.i32();
+    state.skippedCharCount = r.i32();
+
+    if (!r.ok() || !r.atEnd()) return false;
+    if (state.position < 0 || state.position > state.textLength) return false;
+
+    out = state;
+    return true;
+}
+
+bool SessionState::save(const std::string& path) const {
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        std::string data = serialize();
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file.flush()) return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());      // rename() doesn't replace on Windows
+#endif
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool SessionState::load(const std::string& path, SessionState& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return deserialize(data, out);
+}
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+void CancellationToken::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_.store(true, std::memory_order_release);
+    wake_.notify_all();
+    if (notifier_) notifier_(true);
+}
+
+void CancellationToken::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_.store(false, std::memory_order_release);
+    if (notifier_) notifier_(false);
+}
+
+bool CancellationToken::waitUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !wake_.wait_until(lock, deadline, [this] { return isCancelled(); });
+}
+
+void CancellationToken::setNotifier(std::function<void(bool)> notifier) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    notifier_ = std::move(notifier);
+}
+
+IClock& systemClock() {
+    static SteadyClock clock;
+    return clock;
+}
+
+// ============================================================================
+// TimingWheel
+// ============================================================================
+
+TimingWheel::TimingWheel(int64_t nowTick) : now_(nowTick) {
+    for (auto& level : slots_) {
+        for (Timer& head : level) {
+            head.prev_ = head.next_ = &head;
+        }
+    }
+}
+
+TimingWheel::~TimingWheel() {
+    // Leave the callers' timers unscheduled rather than pointing into us
+    for (auto& level : slots_) {
+        for (Timer& head : level) {
+            while (head.next_ != &head) unlink(*head.next_);
+        }
+    }
+}
+
+void TimingWheel::schedule(Timer& timer, int64_t expiryTick) {
+    if (timer.isScheduled()) {
+        unlink(timer);
+        size_--;
+    }
+    timer.expiry_ = std::max(expiryTick, now_ + 1);
+    place(timer);
+    size_++;
+}
+
+void TimingWheel::cancel(Timer& timer) {
+    if (!timer.isScheduled()) return;
+    unlink(timer);
+    size_--;
+}
+
+void TimingWheel::advance(int64_t nowTick) {
+    while (now_ < nowTick) {
+        if (size_ == 0) {
+            now_ = nowTick;
+            return;
+        }
+        now_++;
+
+        // A finer ring wrapping means the next coarse slot is now within
+        // its reach; move those timers down, coarsest first
+        for (int level = LEVELS - 1; level > 0; level--) {
+            if ((now_ & ((int64_t(1) << (SLOT_BITS * level)) - 1)) == 0) cascade(level);
+        }
+
+        Timer& head = slots_[0][now_ & (SLOTS - 1)];
+        while (head.next_ != &head) {
+            Timer& timer = *head.next_;
+            unlink(timer);
+            size_--;
+            if (timer.callback) timer.callback();
+        }
+    }
+}
+
+int64_t TimingWheel::nextWakeup() const {
+    if (size_ == 0) return INT64_MAX;
+
+    int64_t wakeup = INT64_MAX;
+    for (int level = 0; level < LEVELS; level++) {
+        // Slot ticks of this level still to come, nearest first
+        int shift = SLOT_BITS * level;
+        int64_t base = (now_ >> shift) + 1;
+        for (int64_t slot = base; slot < base + SLOTS; slot++) {
+            const Timer& head = slots_[level][slot & (SLOTS - 1)];
+            if (head.next_ != &head) {
+                wakeup = std::min(wakeup, slot << shift);
+                break;
+            }
+        }
+    }
+    return wakeup;
+}
+
+void TimingWheel::place(Timer& timer) {
+    int64_t delta = timer.expiry_ - now_;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (int64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    int shift = SLOT_BITS * level;
+    int64_t slotTick = timer.expiry_;
+    if (delta >= (int64_t(1) << (SLOT_BITS * LEVELS))) {
+        // Beyond the top ring: park in its last slot and re-bucket from there
+        slotTick = now_ + (int64_t(SLOTS - 1) << shift);
+    }
+
+    Timer& head = slots_[level][(slotTick >> shift) & (SLOTS - 1)];
+    timer.prev_ = head.prev_;
+    timer.next_ = &head;
+    head.prev_->next_ = &timer;
+    head.prev_ = &timer;
+}
+
+void TimingWheel::cascade(int level) {
+    Timer& head = slots_[level][(now_ >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    Timer* timer = head.next_;
+    head.prev_ = head.next_ = &head;
+
+    while (timer != &head) {
+        Timer* next = timer->next_;
+        place(*timer);
+        timer = next;
+    }
+}
+
+void TimingWheel::unlink(Timer& timer) {
+    timer.prev_->next_ = timer.next_;
+    timer.next_->prev_ = timer.prev_;
+    timer.prev_ = timer.next_ = nullptr;
+}
+
+// ============================================================================
+// EventTimers
+// ============================================================================
+
+EventTimers::EventTimers(IClock& clock)
+    : clock_(&clock)
+    , wheel_(clock.nowUs() / 1000)
+{}
+
+void EventTimers::start(TimingWheel::Timer& timer, int delayMs) {
+    wheel_.schedule(timer, clock_->nowUs() / 1000 + delayMs);
+}
+
+void EventTimers::run() {
+    int64_t now = clock_->nowUs();
+    if (plannedUs_ != INT64_MAX && now >= plannedUs_) {
+        int64_t late = now - plannedUs_;
+        slack_.wakeups++;
+        slack_.totalUs += late;
+        slack_.maxUs = std::max(slack_.maxUs, late);
+    }
+    plannedUs_ = INT64_MAX;
+    wheel_.advance(now / 1000);
+}
+
+int EventTimers::msUntilNextRun() {
+    int64_t tick = wheel_.nextWakeup();
+    if (tick == INT64_MAX) {
+        plannedUs_ = INT64_MAX;
+        return -1;
+    }
+    plannedUs_ = tick * 1000;
+    int64_t waitUs = std::max<int64_t>(0, plannedUs_ - clock_->nowUs());
+    return static_cast<int>((waitUs + 999) / 1000);
+}
+
+// ============================================================================
+// LayoutRows
+// ============================================================================
+
+LayoutRows::LayoutRows(KeyboardLayoutType type) {
+    switch (type) {
+        case KeyboardLayoutType::US_QWERTY:
+        case KeyboardLayoutType::UK_QWERTY:
+            rows_[0] = "qwertyuiop";
+            rows_[1] = "asdfghjkl";
+            rows_[2] = "zxcvbnm";
+            break;
+        case KeyboardLayoutType::GERMAN_QWERTZ:
+            rows_[0] = "qwertzuiop";
+            rows_[1] = "asdfghjkl";
+            rows_[2] = "yxcvbnm";
+            break;
+        case KeyboardLayoutType::FRENCH_AZERTY:
+            rows_[0] = "azertyuiop";
+            rows_[1] = "qsdfghjklm";
+            rows_[2] = "wxcvbn";
+            break;
+    }
+}
+
+char32_t LayoutRows::neighborOf(char32_t lowerAscii, Random& rng) const {
+    int rowIndex = -1;
+    int colIndex = -1;
+
+    for (int r = 0; r < 3; ++r) {
+        const char* pos = std::strchr(rows_[r], static_cast<char>(lowerAscii));
+        if (pos) {
+            rowIndex = r;
+            colIndex = static_cast<int>(pos - rows_[r]);
+            break;
+        }
+    }
+
+    if (rowIndex == -1) return lowerAscii;
+
+    char32_t candidates[8];
+    int count = 0;
+
+    auto addIfValid = [&](int r, int col) {
+        if (r < 0 || r >= 3) return;
+        if (col < 0 || col >= static_cast<int>(std::strlen(rows_[r]))) return;
+        char32_t ch = static_cast<unsigned char>(rows_[r][col]);
+        if (std::find(candidates, candidates + count, ch) == candidates + count)
+            candidates[count++] = ch;
+    };
+
+    addIfValid(rowIndex, colIndex - 1);
+    addIfValid(rowIndex, colIndex + 1);
+    addIfValid(rowIndex - 1, colIndex);
+    addIfValid(rowIndex + 1, colIndex);
+    addIfValid(rowIndex - 1, colIndex - 1);
+    addIfValid(rowIndex - 1, colIndex + 1);
+    addIfValid(rowIndex + 1, colIndex - 1);
+    addIfValid(rowIndex + 1, colIndex + 1);
+
+    if (count == 0) return lowerAscii;
+
+    return candidates[rng.range(0, count - 1)];
+}
+
+// ============================================================================
+// Instantiations
+// ============================================================================
+
+template class TextChunker<char>;
+template class TextChunker<wchar_t>;
+template class TextChunker<char16_t>;
+template class TypingDynamics<char>;
+template class TypingDynamics<wchar_t>;
+template class TypingDynamics<char16_t>;
+template class ImperfectionGenerator<char>;
+template class ImperfectionGenerator<wchar_t>;
+template class ImperfectionGenerator<char16_t>;
+template class TypingEngine<char>;
+template class TypingEngine<wchar_t>;
+template class TypingEngine<char16_t>;
+
+} // namespace qtype
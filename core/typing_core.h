@@ -0,0 +1,1875 @@
+// typing_core.h - Qt-free typing engine shared by the GUI, the network client
+// and the Windows console. Everything that depends on the character type is a
+// template; the library (typing_core.cpp) holds the rest plus instantiations
+// for char, wchar_t and char16_t. Frontends with their own character type
+// (QChar) specialize CharTraits and instantiate the templates themselves.
+#ifndef TYPING_CORE_H
+#define TYPING_CORE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// ============================================================================
+// Constants
+// ============================================================================
+
+namespace TypingConstants {
+    // Math constants
+    constexpr double TWO_PI = 6.28318530718;
+
+    // Timing bounds
+    constexpr int MIN_DELAY_MS = 15;
+    constexpr int MAX_DELAY_MS = 8000;
+    constexpr int MIN_HOLD_TIME_MS = 40;
+    constexpr int MAX_HOLD_TIME_MS = 180;
+
+    // Rhythm: the phase advances by a fixed step per keystroke
+    constexpr double RHYTHM_STEP = 0.03;
+    constexpr double RHYTHM_STEP_COS = 0.9995500337489875;     // cos(RHYTHM_STEP)
+    constexpr double RHYTHM_STEP_SIN = 0.02999550020249566;    // sin(RHYTHM_STEP)
+
+    // Fatigue calculation
+    constexpr int CHARS_BEFORE_FATIGUE_UPDATE = 50;
+    constexpr int CHARS_FOR_MAX_FATIGUE = 1000;
+    constexpr double MAX_FATIGUE_FACTOR = 0.25;
+
+    // Word chunking
+    constexpr int MAX_CHUNK_LENGTH = 12;
+
+    // Thinking pauses
+    constexpr int MIN_WORDS_BEFORE_PAUSE = 8;
+    constexpr int MAX_WORDS_BEFORE_PAUSE = 15;
+    constexpr double THINKING_PAUSE_PROBABILITY = 0.3;
+
+    // Backspace timing
+    constexpr int BACKSPACE_HOLD_MS = 10;
+    constexpr int MIN_BACKSPACE_DELAY_MS = 40;
+    constexpr int MAX_BACKSPACE_DELAY_MS = 90;
+    constexpr int MIN_CORRECTION_DELAY_MS = 60;
+    constexpr int MAX_CORRECTION_DELAY_MS = 160;
+
+    // Double key timing
+    constexpr int MIN_DOUBLE_KEY_DELAY_MS = 10;
+    constexpr int MAX_DOUBLE_KEY_DELAY_MS = 40;
+
+    // Platform-specific delays
+    constexpr int MAC_SHIFT_DELAY_MS = 10;
+
+    // Mouse movement
+    constexpr int MIN_MOUSE_MOVE_INTERVAL_CHARS = 20;
+    constexpr int MAX_MOUSE_MOVE_INTERVAL_CHARS = 60;
+    constexpr int MIN_MOUSE_PIXELS = 3;
+    constexpr int MAX_MOUSE_PIXELS = 15;
+    constexpr int MIN_MOUSE_PAUSE_MS = 100;
+    constexpr int MAX_MOUSE_PAUSE_MS = 300;
+
+    // Scroll
+    constexpr int MIN_SCROLL_INTERVAL_CHARS = 40;
+    constexpr int MAX_SCROLL_INTERVAL_CHARS = 120;
+    constexpr int MIN_SCROLL_AMOUNT = 1;
+    constexpr int MAX_SCROLL_AMOUNT = 3;
+    constexpr int MIN_SCROLL_PAUSE_MS = 150;
+    constexpr int MAX_SCROLL_PAUSE_MS = 400;
+    constexpr double SCROLL_DOWN_PROBABILITY = 0.8; // 80% scroll down, 20% up
+
+    // Session checkpoints
+    constexpr int CHECKPOINT_INTERVAL_MS = 5000;
+
+    // Planner/player pipeline
+    constexpr int PIPELINE_RING_EVENTS = 1024;  // Seconds of planned typing
+    constexpr int PIPELINE_REFILL_MS = 50;      // Full ring: the planner checks again after this
+    constexpr int PIPELINE_POLL_MS = 5;         // Empty ring: the player checks again after this
+
+    // Plan cache
+    constexpr uint64_t PLAN_CACHE_MAX_BYTES = uint64_t(64) << 20;
+    constexpr uint32_t PLAN_FORMAT_VERSION = 2;     // Bump when the same inputs plan differently
+
+    // Memory layout
+    constexpr int CACHE_LINE_BYTES = 64;
+}
+
+namespace qtype {
+
+// ============================================================================
+// Profile & Settings Structs
+// ============================================================================
+
+struct TimingProfile {
+    double baseSpeedFactor = 1.0;
+    double microStutterProb = 0.1;
+    double idlePauseProb = 0.009;
+    double burstProb = 0.14;
+    int burstMin = 2;
+    int burstMax = 6;
+    double gammaShape = 2.0;
+    double gammaScale = 1.0;
+    double noiseLevel = 0.15;
+
+    static constexpr TimingProfile humanAdvanced();
+    static constexpr TimingProfile fastHuman();
+    static constexpr TimingProfile slowTired();
+    static constexpr TimingProfile professional();
+};
+
+constexpr TimingProfile TimingProfile::humanAdvanced() {
+    TimingProfile p;
+    p.baseSpeedFactor = 1.0;
+    p.microStutterProb = 0.1;
+    p.idlePauseProb = 0.009;
+    p.burstProb = 0.14;
+    p.burstMin = 2;
+    p.burstMax = 6;
+    p.gammaShape = 2.0;
+    p.gammaScale = 1.0;
+    p.noiseLevel = 0.15;
+    return p;
+}
+
+constexpr TimingProfile TimingProfile::fastHuman() {
+    TimingProfile p;
+    p.baseSpeedFactor = 0.7;
+    p.microStutterProb = 0.06;
+    p.idlePauseProb = 0.004;
+    p.burstProb = 0.2;
+    p.burstMin = 3;
+    p.burstMax = 8;
+    p.gammaShape = 1.8;
+    p.gammaScale = 0.9;
+    p.noiseLevel = 0.12;
+    return p;
+}
+
+constexpr TimingProfile TimingProfile::slowTired() {
+    TimingProfile p;
+    p.baseSpeedFactor = 1.5;
+    p.microStutterProb = 0.15;
+    p.idlePauseProb = 0.025;
+    p.burstProb = 0.08;
+    p.burstMin = 2;
+    p.burstMax = 4;
+    p.gammaShape = 2.5;
+    p.gammaScale = 1.3;
+    p.noiseLevel = 0.22;
+    return p;
+}
+
+constexpr TimingProfile TimingProfile::professional() {
+    TimingProfile p;
+    p.baseSpeedFactor = 0.75;
+    p.microStutterProb = 0.04;
+    p.idlePauseProb = 0.003;
+    p.burstProb = 0.25;
+    p.burstMin = 4;
+    p.burstMax = 10;
+    p.gammaShape = 1.6;
+    p.gammaScale = 0.85;
+    p.noiseLevel = 0.08;
+    return p;
+}
+
+struct ImperfectionSettings {
+    bool enableTypos = true;
+    int typoMin = 300;
+    int typoMax = 500;
+
+    bool enableDoubleKeys = true;
+    int doubleMin = 250;
+    int doubleMax = 400;
+
+    bool enableAutoCorrection = true;
+    int correctionProbability = 15;
+};
+
+struct DelayRange {
+    int minMs = 80;
+    int maxMs = 180;
+};
+
+enum class KeyboardLayoutType {
+    US_QWERTY,
+    UK_QWERTY,
+    GERMAN_QWERTZ,
+    FRENCH_AZERTY
+};
+
+// ============================================================================
+// Random Number Generator
+// ============================================================================
+
+namespace detail {
+    // std::sqrt isn't constexpr; Newton from above, stopping once it no
+    // longer decreases. Within an ulp of std::sqrt.
+    constexpr double constexprSqrt(double x) {
+        if (x <= 0.0) return 0.0;
+        double r = x > 1.0 ? x : 1.0;
+        for (int i = 0; i < 128; ++i) {
+            double next = 0.5 * (r + x / r);
+            if (next >= r) break;
+            r = next;
+        }
+        return r;
+    }
+
+    // Ziggurat layers for the standard normal (Marsaglia & Tsang 2000, in
+    // Doornik's 128-layer form). x[0] is the base strip's width, x[1] where
+    // the tail begins; ratio[i] = x[i + 1] / x[i] bounds the part of layer
+    // i that lies under the curve.
+    struct Ziggurat {
+        static constexpr int LAYERS = 128;
+        static constexpr double TAIL = 3.442619855899;
+        static constexpr double AREA = 9.91256303526217e-3;
+
+        double x[LAYERS + 1];
+        double ratio[LAYERS];
+
+        Ziggurat();
+    };
+
+    inline const Ziggurat& ziggurat() {
+        static const Ziggurat tables;
+        return tables;
+    }
+}
+
+// Marsaglia-Tsang constants for one gamma shape. Shapes below 1 sample
+// shape + 1 and scale the result by U^(1/shape).
+struct GammaParams {
+    double d = 0.0;
+    double c = 0.0;
+    double invShape = 0.0;      // Non-zero only for shapes below 1
+
+    static constexpr GammaParams of(double shape) {
+        GammaParams p;
+        double boosted = shape < 1.0 ? shape + 1.0 : shape;
+        p.d = boosted - 1.0 / 3.0;
+        p.c = 1.0 / detail::constexprSqrt(9.0 * p.d);
+        p.invShape = shape < 1.0 ? 1.0 / shape : 0.0;
+        return p;
+    }
+};
+
+// xoshiro256** with explicit state, so every engine owns its own stream and
+// can be seeded. Not thread-safe; share one per thread at most.
+class Random {
+public:
+    // Everything that decides the rest of the stream
+    struct State {
+        uint64_t s[4];
+        double spare;
+        bool hasSpare;
+    };
+
+    Random();                           // Seeded from std::random_device
+    explicit Random(uint64_t seed);
+
+    void seed(uint64_t seed);
+
+    State state() const {
+        return State{{s_[0], s_[1], s_[2], s_[3]}, spare_, hasSpare_};
+    }
+
+    void setState(const State& state) {
+        std::copy(state.s, state.s + 4, s_);
+        spare_ = state.spare;
+        hasSpare_ = state.hasSpare;
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // [0, 1) with 53 random bits
+    double uniform() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    // Inclusive on both ends
+    int range(int min, int max) {
+        if (min > max) std::swap(min, max);
+        uint64_t span = static_cast<uint64_t>(static_cast<int64_t>(max) - min) + 1;
+        return static_cast<int>(min + static_cast<int64_t>(((next() >> 32) * span) >> 32));
+    }
+
+    double normal(double mean, double stddev);
+    double gamma(double shape, double scale);
+
+    // Gamma with the shape's constants worked out in advance. With constexpr
+    // params the compiler drops the branch for the other shape range.
+    double gamma(const GammaParams& params, double scale) {
+        double value = marsagliaTsang<false>(params.d, params.c) * scale;
+        if (params.invShape != 0.0) {
+            value *= std::pow(uniform(), params.invShape);
+        }
+        return value;
+    }
+
+    // Same distributions as normal() and gamma(), drawn through the
+    // ziggurat: about 99% of normals cost one draw, a table lookup and a
+    // compare, with exp and log left to the wedges and the tail. The
+    // streams differ from the Box-Muller ones.
+    double fastNormal(double mean, double stddev) {
+        const detail::Ziggurat& z = detail::ziggurat();
+        uint64_t bits = next();
+        int layer = static_cast<int>(bits & (detail::Ziggurat::LAYERS - 1));
+        double u = (bits >> 11) * 0x1.0p-52 - 1.0;
+        if (std::fabs(u) < z.ratio[layer]) {
+            return mean + stddev * u * z.x[layer];
+        }
+        return mean + stddev * zigguratEdge(layer, u);
+    }
+
+    double fastGamma(const GammaParams& params, double scale) {
+        double value = marsagliaTsang<true>(params.d, params.c) * scale;
+        if (params.invShape != 0.0) {
+            value *= std::pow(uniform(), params.invShape);
+        }
+        return value;
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    // The wedge and tail cases of fastNormal()
+    double zigguratEdge(int layer, double u);
+
+    template<bool Ziggurat>
+    double marsagliaTsang(double d, double c) {
+        while (true) {
+            double x, v;
+            do {
+                x = Ziggurat ? fastNormal(0.0, 1.0) : normal(0.0, 1.0);
+                v = 1.0 + c * x;
+            } while (v <= 0.0);
+
+            v = v * v * v;
+            double u = uniform();
+
+            if (u < 1.0 - 0.0331 * x * x * x * x) {
+                return d * v;
+            }
+            if (std::log(u) < 0.5 * x * x + d * (1.0 - v + std::log(v))) {
+                return d * v;
+            }
+        }
+    }
+
+    uint64_t s_[4];
+    double spare_ = 0.0;      // Second Box-Muller value
+    bool hasSpare_ = false;
+};
+
+// Static helpers over a per-thread Random, for code that isn't tied to an
+// engine (idle scrolling, the GUI's one-off choices)
+class RandomGenerator {
+public:
+    static double gamma(double shape, double scale) { return local().gamma(shape, scale); }
+    static double normal(double mean, double stddev) { return local().normal(mean, stddev); }
+    static int range(int min, int max) { return local().range(min, max); }
+    static double uniform() { return local().uniform(); }
+
+    static Random& local();
+};
+
+// ============================================================================
+// Compile-Time Profiles
+// ============================================================================
+
+// Default profile policy: the profile is a run-time value, e.g. picked in the
+// GUI
+struct DynamicProfile {};
+
+// A preset fixed at compile time. Engines built on one fold the profile's
+// fields into the delay code and use a gamma sampler specialized for its
+// shape.
+template<TimingProfile (*Make)()>
+struct StaticProfile {
+    static constexpr TimingProfile value = Make();
+};
+
+using HumanAdvancedProfile = StaticProfile<&TimingProfile::humanAdvanced>;
+using FastHumanProfile = StaticProfile<&TimingProfile::fastHuman>;
+using SlowTiredProfile = StaticProfile<&TimingProfile::slowTired>;
+using ProfessionalProfile = StaticProfile<&TimingProfile::professional>;
+
+namespace detail {
+    // Where the dynamics read their profile from
+    template<typename Profile>
+    class ProfileSource {
+    public:
+        explicit ProfileSource(const TimingProfile&) {}
+
+        static constexpr const TimingProfile& get() { return Profile::value; }
+        static constexpr const GammaParams& delayGamma() { return delayGamma_; }
+
+    private:
+        static constexpr GammaParams delayGamma_ = GammaParams::of(Profile::value.gammaShape);
+    };
+
+    template<>
+    class ProfileSource<DynamicProfile> {
+    public:
+        explicit ProfileSource(const TimingProfile& profile)
+            : profile_(profile)
+            , delayGamma_(GammaParams::of(profile.gammaShape))
+        {}
+
+        const TimingProfile& get() const { return profile_; }
+        const GammaParams& delayGamma() const { return delayGamma_; }
+
+    private:
+        TimingProfile profile_;
+        GammaParams delayGamma_;
+    };
+
+    // Fixed-shape distributions used for every profile
+    constexpr GammaParams HOLD_GAMMA = GammaParams::of(2.5);
+    constexpr GammaParams SENTENCE_PAUSE_GAMMA = GammaParams::of(2.0);
+    constexpr GammaParams THINKING_PAUSE_GAMMA = GammaParams::of(3.0);
+}
+
+// ============================================================================
+// Character Classification
+// ============================================================================
+
+namespace detail {
+    // Characters the chunker always emits on their own
+    constexpr bool isChunkPunct(char32_t c) {
+        switch (c) {
+            case '*': case '-': case '#': case '`': case '_': case '[': case ']':
+            case '(': case ')': case '{': case '}': case '<': case '>': case '!':
+            case '~': case '+': case '|': case '"': case '\'': case '.': case ',':
+            case ':': case ';': case '/': case '?': case '\\':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    constexpr bool isSpaceCode(char32_t c) {
+        if (c < 128) return c == ' ' || (c >= '\t' && c <= '\r');
+        return c == 0x85 || c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A) ||
+               c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+    }
+
+    // ASCII plus Latin-1, which covers what the backends can type
+    constexpr bool isUpperCode(char32_t c) {
+        return (c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7);
+    }
+
+    constexpr bool isLowerCode(char32_t c) {
+        return (c >= 'a' && c <= 'z') || (c >= 0xDF && c <= 0xFF && c != 0xF7);
+    }
+
+    constexpr bool isLetterCode(char32_t c) {
+        return isUpperCode(c) || isLowerCode(c) || c == 0xAA || c == 0xB5 || c == 0xBA;
+    }
+
+    constexpr char32_t toLowerAscii(char32_t c) {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    // Bit n set for letter 'a' + n
+    constexpr uint32_t letterMask(const char* letters) {
+        uint32_t mask = 0;
+        for (; *letters; ++letters) mask |= 1u << (*letters - 'a');
+        return mask;
+    }
+
+    constexpr bool inLetterMask(uint32_t mask, char32_t lower) {
+        return lower >= 'a' && lower <= 'z' && (mask >> (lower - 'a')) & 1u;
+    }
+
+    // Speed factor for typing curr right after prev
+    inline double digraphFactor(char32_t prev, char32_t curr) {
+        char32_t a = toLowerAscii(prev);
+        char32_t b = toLowerAscii(curr);
+
+        switch ((a << 8) | b) {
+            case ('t' << 8) | 'h': case ('h' << 8) | 'e': case ('i' << 8) | 'n':
+            case ('e' << 8) | 'r': case ('a' << 8) | 'n': case ('r' << 8) | 'e':
+            case ('o' << 8) | 'n': case ('a' << 8) | 't': case ('e' << 8) | 'n':
+            case ('n' << 8) | 'd':
+                if (a < 128 && b < 128) return 0.75;
+                break;
+        }
+
+        if ((prev == 'q' && curr == 'z') ||
+            (prev == 'z' && curr == 'q') ||
+            (prev == 'p' && curr == 'q')) {
+            return 1.4;
+        }
+
+        constexpr uint32_t leftHand = letterMask("qwertasdfgzxcvb");
+        constexpr uint32_t rightHand = letterMask("yuiophjklnm");
+
+        bool bothLeft = inLetterMask(leftHand, a) && inLetterMask(leftHand, b);
+        bool bothRight = inLetterMask(rightHand, a) && inLetterMask(rightHand, b);
+
+        if (bothLeft || bothRight) {
+            return 1.08;
+        }
+
+        return 1.0;
+    }
+}
+
+// Per-character-type operations the engine needs. The generic version covers
+// the standard character types; other types (QChar) provide a specialization
+// with the same members.
+template<typename CharT>
+struct CharTraits {
+    using String = std::basic_string<CharT>;
+
+    static char32_t code(CharT c) { return static_cast<std::make_unsigned_t<CharT>>(c); }
+    static CharT fromAscii(char c) { return static_cast<CharT>(c); }
+    static CharT fromCode(char32_t c) { return static_cast<CharT>(c); }
+
+    static bool isSpace(CharT c) { return detail::isSpaceCode(code(c)); }
+    static bool isDigit(CharT c) { return code(c) >= '0' && code(c) <= '9'; }
+    static bool isUpper(CharT c) { return detail::isUpperCode(code(c)); }
+    static bool isLetter(CharT c) { return detail::isLetterCode(code(c)); }
+    static CharT toUpper(CharT c) {
+        char32_t u = code(c);
+        return (u >= 'a' && u <= 'z') ? static_cast<CharT>(u - ('a' - 'A')) : c;
+    }
+};
+
+namespace detail {
+    // Everything a keystroke asks about its character, in one byte: the
+    // delay class in the low bits, then the Traits predicates
+    constexpr uint8_t CHAR_DELAY_MASK = 0x07;
+    constexpr uint8_t CHAR_SPACE = 0x08;
+    constexpr uint8_t CHAR_DIGIT = 0x10;
+    constexpr uint8_t CHAR_UPPER = 0x20;
+    constexpr uint8_t CHAR_LETTER = 0x40;
+
+    enum DelayClass : uint8_t {
+        DELAY_PLAIN,
+        DELAY_DIGIT,
+        DELAY_SPACE,
+        DELAY_NEWLINE,
+        DELAY_SENTENCE_END,         // . ! ?
+    };
+
+    // What calculateDelay() multiplies by, per class. A newline is a space
+    // and a newline, so it takes both factors, in that order; the 1.0s are
+    // exact and leave every other delay as it was.
+    constexpr double DELAY_CLASS_FACTOR[] = {1.0, 1.05, 1.12, 1.12, 1.4};
+    constexpr double DELAY_CLASS_EXTRA[] = {1.0, 1.0, 1.0, 1.5, 1.0};
+
+    constexpr uint8_t charFlags(bool space, bool digit, bool upper, bool letter, uint8_t delayClass) {
+        return static_cast<uint8_t>((space ? CHAR_SPACE : 0) | (digit ? CHAR_DIGIT : 0) |
+                                    (upper ? CHAR_UPPER : 0) | (letter ? CHAR_LETTER : 0) | delayClass);
+    }
+
+    // ASCII means the same to every Traits, so it is worked out once
+    struct AsciiClasses {
+        uint8_t flags[128];
+
+        constexpr AsciiClasses() : flags() {
+            for (char32_t c = 0; c < 128; ++c) {
+                bool digit = c >= '0' && c <= '9';
+                bool space = isSpaceCode(c);
+                uint8_t delay = c == '\n' ? DELAY_NEWLINE
+                              : space ? DELAY_SPACE
+                              : digit ? DELAY_DIGIT
+                              : (c == '.' || c == '!' || c == '?') ? DELAY_SENTENCE_END
+                              : DELAY_PLAIN;
+                flags[c] = charFlags(space, digit, isUpperCode(c), isLetterCode(c), delay);
+            }
+        }
+    };
+
+    inline constexpr AsciiClasses ASCII_CLASSES{};
+
+    // The rest asks Traits, which for QChar means Qt's Unicode tables
+    template<typename Traits, typename CharT>
+    uint8_t unicodeCharClass(CharT c) {
+        bool space = Traits::isSpace(c);
+        bool digit = Traits::isDigit(c);
+        uint8_t delay = space ? DELAY_SPACE : digit ? DELAY_DIGIT : DELAY_PLAIN;
+        return charFlags(space, digit, Traits::isUpper(c), Traits::isLetter(c), delay);
+    }
+
+    // One table load for ASCII
+    template<typename Traits, typename CharT>
+    uint8_t charClass(CharT c) {
+        char32_t code = Traits::code(c);
+        if (code < 128) return ASCII_CLASSES.flags[code];
+        return unicodeCharClass<Traits>(c);
+    }
+}
+
+// ============================================================================
+// Keyboard Layout Logic
+// ============================================================================
+
+// Letter rows of a physical layout, used to pick plausible typos
+class LayoutRows {
+public:
+    explicit LayoutRows(KeyboardLayoutType type = KeyboardLayoutType::US_QWERTY);
+
+    // A key next to lowerAscii, or lowerAscii itself if it isn't on the rows
+    char32_t neighborOf(char32_t lowerAscii, Random& rng) const;
+
+private:
+    const char* rows_[3];
+};
+
+template<typename CharT, typename Traits = CharTraits<CharT>>
+class KeyboardLayout {
+public:
+    explicit KeyboardLayout(KeyboardLayoutType type = KeyboardLayoutType::US_QWERTY)
+        : rows_(type)
+    {}
+
+    CharT getNeighborKey(CharT c) const { return getNeighborKey(c, RandomGenerator::local()); }
+
+    CharT getNeighborKey(CharT c, Random& rng) const {
+        char32_t lower = detail::toLowerAscii(Traits::code(c));
+        if (lower < 'a' || lower > 'z') return c;
+
+        char32_t neighbor = rows_.neighborOf(lower, rng);
+        if (neighbor == lower) return c;
+
+        CharT out = Traits::fromAscii(static_cast<char>(neighbor));
+        return Traits::isUpper(c) ? Traits::toUpper(out) : out;
+    }
+
+    bool isLetter(CharT c) const { return Traits::isLetter(c); }
+
+private:
+    LayoutRows rows_;
+};
+
+// ============================================================================
+// Key Strokes
+// ============================================================================
+
+// Key codes shared by the layouts: PC set 1 make codes, which for these keys
+// are also the Linux evdev codes (ydotool, uinput); X11 keycodes are 8 more.
+// Right Alt is evdev's code; in set 1 it is the extended (E0) 0x38.
+namespace Scancodes {
+    constexpr uint8_t BACKSPACE = 14;
+    constexpr uint8_t TAB = 15;
+    constexpr uint8_t ENTER = 28;
+    constexpr uint8_t LEFT_SHIFT = 42;
+    constexpr uint8_t SPACE = 57;
+    constexpr uint8_t RIGHT_ALT = 100;
+    constexpr uint8_t RIGHT_ALT_SET1 = 0x38;
+}
+
+// How to type one ASCII character on a layout, for backends that inject
+// keys rather than text
+struct KeyStroke {
+    uint8_t scancode = 0;       // 0: no key types it directly (not on the layout, or a dead key)
+    bool needsShift = false;
+    bool needsAltGr = false;
+
+    constexpr bool isTypable() const { return scancode != 0; }
+};
+
+using KeyStrokeTable = std::array<KeyStroke, 128>;
+
+namespace detail {
+    // Keys with consecutive scancodes, one character per key and level. A
+    // space marks a key with no ASCII character on that level.
+    struct KeyRun {
+        uint8_t firstScancode;
+        const char* plain;
+        const char* shifted;
+        const char* altGr;      // nullptr: nothing on AltGr
+    };
+
+    constexpr void assignKey(KeyStrokeTable& table, char c, uint8_t scancode, bool shift, bool altGr) {
+        unsigned char index = static_cast<unsigned char>(c);
+        if (c == ' ' || index >= 128 || table[index].isTypable()) return;
+        table[index] = KeyStroke{scancode, shift, altGr};
+    }
+
+    // Unshifted keys win over shifted ones, and both over AltGr
+    template<size_t N>
+    constexpr KeyStrokeTable buildKeyStrokes(const KeyRun (&runs)[N]) {
+        KeyStrokeTable table{};
+        table[' '] = KeyStroke{Scancodes::SPACE, false, false};
+        table['\t'] = KeyStroke{Scancodes::TAB, false, false};
+        table['\n'] = KeyStroke{Scancodes::ENTER, false, false};
+        table['\b'] = KeyStroke{Scancodes::BACKSPACE, false, false};
+
+        for (const KeyRun& run : runs) {
+            for (int i = 0; run.plain[i]; i++) {
+                assignKey(table, run.plain[i], static_cast<uint8_t>(run.firstScancode + i), false, false);
+            }
+        }
+        for (const KeyRun& run : runs) {
+            for (int i = 0; run.shifted[i]; i++) {
+                assignKey(table, run.shifted[i], static_cast<uint8_t>(run.firstScancode + i), true, false);
+            }
+        }
+        for (const KeyRun& run : runs) {
+            for (int i = 0; run.altGr && run.altGr[i]; i++) {
+                assignKey(table, run.altGr[i], static_cast<uint8_t>(run.firstScancode + i), false, true);
+            }
+        }
+        return table;
+    }
+
+    constexpr KeyRun US_KEY_RUNS[] = {
+        {41, "`", "~", nullptr},
+        {2, "1234567890-=", "!@#$%^&*()_+", nullptr},
+        {16, "qwertyuiop[]", "QWERTYUIOP{}", nullptr},
+        {30, "asdfghjkl;'", "ASDFGHJKL:\"", nullptr},
+        {43, "\\", "|", nullptr},
+        {44, "zxcvbnm,./", "ZXCVBNM<>?", nullptr},
+    };
+
+    // ISO: # next to Enter, \ next to left Shift
+    constexpr KeyRun UK_KEY_RUNS[] = {
+        {41, "`", " ", nullptr},
+        {2, "1234567890-=", "!\" $%^&*()_+", nullptr},
+        {16, "qwertyuiop[]", "QWERTYUIOP{}", nullptr},
+        {30, "asdfghjkl;'", "ASDFGHJKL:@", nullptr},
+        {43, "#", "~", nullptr},
+        {86, "\\", "|", nullptr},
+        {44, "zxcvbnm,./", "ZXCVBNM<>?", nullptr},
+    };
+
+    // ^ and the two accent keys are dead and left out
+    constexpr KeyRun GERMAN_KEY_RUNS[] = {
+        {2, "1234567890 ", "!\" $%&/()=?", "      {[]}\\"},
+        {16, "qwertzuiop +", "QWERTZUIOP *", "@          ~"},
+        {30, "asdfghjkl", "ASDFGHJKL", nullptr},
+        {43, "#", "'", nullptr},
+        {86, "<", ">", "|"},
+        {44, "yxcvbnm,.-", "YXCVBNM;:_", nullptr},
+    };
+
+    // Digits are shifted; AltGr's ~ and ` are dead and left out, as is ^
+    constexpr KeyRun FRENCH_KEY_RUNS[] = {
+        {2, "& \"'(- _  )=", "1234567890 +", "  #{[| \\^@]}"},
+        {16, "azertyuiop $", "AZERTYUIOP  ", nullptr},
+        {30, "qsdfghjklm ", "QSDFGHJKLM%", nullptr},
+        {43, "*", " ", nullptr},
+        {86, "<", ">", nullptr},
+        {44, "wxcvbn,;:!", "WXCVBN?./ ", nullptr},
+    };
+
+    inline constexpr KeyStrokeTable US_KEY_STROKES = buildKeyStrokes(US_KEY_RUNS);
+    inline constexpr KeyStrokeTable UK_KEY_STROKES = buildKeyStrokes(UK_KEY_RUNS);
+    inline constexpr KeyStrokeTable GERMAN_KEY_STROKES = buildKeyStrokes(GERMAN_KEY_RUNS);
+    inline constexpr KeyStrokeTable FRENCH_KEY_STROKES = buildKeyStrokes(FRENCH_KEY_RUNS);
+}
+
+// Indexed by ASCII code. Backends keep the table and do one load per key.
+constexpr const KeyStrokeTable& keyStrokes(KeyboardLayoutType type) {
+    switch (type) {
+        case KeyboardLayoutType::UK_QWERTY: return detail::UK_KEY_STROKES;
+        case KeyboardLayoutType::GERMAN_QWERTZ: return detail::GERMAN_KEY_STROKES;
+        case KeyboardLayoutType::FRENCH_AZERTY: return detail::FRENCH_KEY_STROKES;
+        case KeyboardLayoutType::US_QWERTY: break;
+    }
+    return detail::US_KEY_STROKES;
+}
+
+constexpr KeyStroke keyStrokeFor(KeyboardLayoutType type, char32_t c) {
+    return c < 128 ? keyStrokes(type)[c] : KeyStroke{};
+}
+
+// ============================================================================
+// Typing Dynamics Calculator
+// ============================================================================
+
+template<typename CharT, typename Traits = CharTraits<CharT>,
+         typename Profile = DynamicProfile>
+class TypingDynamics {
+public:
+    TypingDynamics(const TimingProfile& profile, const DelayRange& delays,
+                   Random& rng = RandomGenerator::local())
+        : rng_(&rng)
+        , previousChar_()
+        , fatigueFactor_(1.0)
+        , burstRemaining_(0)
+        , totalCharsTyped_(0)
+        , delays_(delays)
+        , profile_(profile)
+    {
+        startRhythm(rng.uniform() * TypingConstants::TWO_PI);
+    }
+
+    void reset() {
+        previousChar_ = CharT();
+        startRhythm(rng_->uniform() * TypingConstants::TWO_PI);
+        fatigueFactor_ = 1.0;
+        burstRemaining_ = 0;
+        totalCharsTyped_ = 0;
+    }
+
+    void setDelayRange(const DelayRange& delays) { delays_ = delays; }
+
+    struct State {
+        char32_t previousChar;
+        double rhythmSin;       // The rhythm's phase, as a point on the unit circle
+        double rhythmCos;
+        double fatigueFactor;
+        int burstRemaining;
+        int totalCharsTyped;
+    };
+
+    State state() const {
+        return State{Traits::code(previousChar_), rhythmSin_, rhythmCos_, fatigueFactor_,
+                     burstRemaining_, totalCharsTyped_};
+    }
+
+    void setState(const State& state) {
+        previousChar_ = Traits::fromCode(state.previousChar);
+        rhythmSin_ = state.rhythmSin;
+        rhythmCos_ = state.rhythmCos;
+        fatigueFactor_ = state.fatigueFactor;
+        burstRemaining_ = state.burstRemaining;
+        totalCharsTyped_ = state.totalCharsTyped;
+    }
+
+    void updateState(CharT currentChar) {
+        previousChar_ = currentChar;
+        totalCharsTyped_++;
+
+        if (totalCharsTyped_ % TypingConstants::CHARS_BEFORE_FATIGUE_UPDATE == 0) {
+            fatigueFactor_ = 1.0 + TypingConstants::MAX_FATIGUE_FACTOR *
+                             std::min(1.0, totalCharsTyped_ / static_cast<double>(TypingConstants::CHARS_FOR_MAX_FATIGUE));
+        }
+    }
+
+    int calculateDelay(CharT ch, bool isSentenceEnd, bool isBurst, bool isThinkingPause) {
+        const TimingProfile& profile = profile_.get();
+
+        double range = delays_.maxMs - delays_.minMs;
+        double gammaValue = rng_->fastGamma(profile_.delayGamma(), profile.gammaScale);
+        double normalized = std::min(gammaValue / 6.0, 1.0);
+
+        double delay = delays_.minMs + range * normalized;
+        delay *= rhythmicVariation();
+
+        uint8_t delayClass = detail::charClass<Traits>(ch) & detail::CHAR_DELAY_MASK;
+        delay *= detail::DELAY_CLASS_FACTOR[delayClass];
+        delay *= detail::DELAY_CLASS_EXTRA[delayClass];
+
+        if (previousChar_ != CharT()) {
+            delay *= digraphFactor(previousChar_, ch);
+        }
+
+        if (isSentenceEnd)
+            delay += rng_->fastGamma(detail::SENTENCE_PAUSE_GAMMA, 150);
+
+        if (isThinkingPause)
+            delay += rng_->fastGamma(detail::THINKING_PAUSE_GAMMA, 800);
+
+        if (rng_->uniform() < profile.microStutterProb)
+            delay *= 1.3 + rng_->uniform() * 0.4;
+
+        if (isBurst)
+            delay *= 0.65;
+
+        delay *= fatigueFactor_;
+
+        double noise = rng_->fastNormal(0.0, profile.noiseLevel);
+        delay *= (1.0 + noise);
+
+        return std::max(TypingConstants::MIN_DELAY_MS, std::min(int(delay), TypingConstants::MAX_DELAY_MS));
+    }
+
+    int generateHoldTime(CharT ch) {
+        double hold = rng_->fastGamma(detail::HOLD_GAMMA, 20.0);
+
+        if (detail::charClass<Traits>(ch) & detail::CHAR_UPPER) {
+            hold *= 1.2;
+        }
+
+        hold *= (0.9 + rng_->uniform() * 0.2);
+
+        return std::max(TypingConstants::MIN_HOLD_TIME_MS, std::min(int(hold), TypingConstants::MAX_HOLD_TIME_MS));
+    }
+
+    bool shouldBurst() {
+        if (burstRemaining_ > 0) {
+            burstRemaining_--;
+            return true;
+        }
+        const TimingProfile& profile = profile_.get();
+        if (rng_->uniform() < profile.burstProb) {
+            burstRemaining_ = rng_->range(profile.burstMin, profile.burstMax);
+            return true;
+        }
+        return false;
+    }
+
+    bool shouldThinkingPause(int wordsSinceBreak) {
+        return wordsSinceBreak > rng_->range(TypingConstants::MIN_WORDS_BEFORE_PAUSE,
+                                             TypingConstants::MAX_WORDS_BEFORE_PAUSE) &&
+               rng_->uniform() < TypingConstants::THINKING_PAUSE_PROBABILITY;
+    }
+
+    double digraphFactor(CharT prev, CharT curr) const {
+        return detail::digraphFactor(Traits::code(prev), Traits::code(curr));
+    }
+
+private:
+    // Per-keystroke state first; the profile is only read once per chunk
+    Random* rng_;
+    CharT previousChar_;
+    double rhythmSin_;
+    double rhythmCos_;
+    double fatigueFactor_;
+    int burstRemaining_;
+    int totalCharsTyped_;
+
+    DelayRange delays_;
+    detail::ProfileSource<Profile> profile_;
+
+    void startRhythm(double phase) {
+        rhythmSin_ = std::sin(phase);
+        rhythmCos_ = std::cos(phase);
+    }
+
+    // Steps the phase by rotating (sin, cos) instead of calling std::sin.
+    // Pulling the point back onto the unit circle every step keeps rounding
+    // from growing or shrinking the amplitude over long runs.
+    double rhythmicVariation() {
+        double s = rhythmSin_ * TypingConstants::RHYTHM_STEP_COS + rhythmCos_ * TypingConstants::RHYTHM_STEP_SIN;
+        double c = rhythmCos_ * TypingConstants::RHYTHM_STEP_COS - rhythmSin_ * TypingConstants::RHYTHM_STEP_SIN;
+        double norm = 1.5 - 0.5 * (s * s + c * c);
+        rhythmSin_ = s * norm;
+        rhythmCos_ = c * norm;
+
+        double rhythm = rhythmSin_ * 0.5 + 0.5;
+        return 0.85 + rhythm * 0.3;
+    }
+};
+
+// ============================================================================
+// Imperfection Generator
+// ============================================================================
+
+template<typename CharT>
+struct ImperfectionResult {
+    CharT character;
+    bool shouldDouble = false;
+    bool shouldCorrect = false;
+};
+
+template<typename CharT, typename Traits = CharTraits<CharT>>
+class ImperfectionGenerator {
+public:
+    ImperfectionGenerator(const ImperfectionSettings& settings,
+                          const KeyboardLayout<CharT, Traits>& layout,
+                          Random& rng = RandomGenerator::local())
+        : charsTypedTotal_(0)
+        , charsSinceLastTypo_(0)
+        , charsSinceLastDouble_(0)
+        , nextTypoAt_(INT_MAX)
+        , nextDoubleAt_(INT_MAX)
+        , rng_(&rng)
+        , layout_(&layout)
+        , settings_(settings)
+    {
+        reset();
+    }
+
+    void reset() {
+        charsTypedTotal_ = 0;
+        charsSinceLastTypo_ = 0;
+        charsSinceLastDouble_ = 0;
+        scheduleNextTypo();
+        scheduleNextDouble();
+    }
+
+    struct State {
+        int charsTypedTotal;
+        int charsSinceLastTypo;
+        int charsSinceLastDouble;
+        int nextTypoAt;
+        int nextDoubleAt;
+    };
+
+    State state() const {
+        return State{charsTypedTotal_, charsSinceLastTypo_, charsSinceLastDouble_,
+                     nextTypoAt_, nextDoubleAt_};
+    }
+
+    void setState(const State& state) {
+        charsTypedTotal_ = state.charsTypedTotal;
+        charsSinceLastTypo_ = state.charsSinceLastTypo;
+        charsSinceLastDouble_ = state.charsSinceLastDouble;
+        nextTypoAt_ = state.nextTypoAt;
+        nextDoubleAt_ = state.nextDoubleAt;
+    }
+
+    ImperfectionResult<CharT> processCharacter(CharT original) {
+        return processCharacter(original, detail::charClass<Traits>(original));
+    }
+
+    // With the character's detail::charClass() already looked up
+    ImperfectionResult<CharT> processCharacter(CharT original, uint8_t charClass) {
+        ImperfectionResult<CharT> result;
+        result.character = original;
+
+        charsTypedTotal_++;
+        charsSinceLastTypo_++;
+        charsSinceLastDouble_++;
+
+        if (charsSinceLastTypo_ >= nextTypoAt_ && (charClass & detail::CHAR_LETTER)) {
+            result.character = layout_->getNeighborKey(original, *rng_);
+            charsSinceLastTypo_ = 0;
+            scheduleNextTypo();
+
+            if (settings_.enableAutoCorrection &&
+                rng_->range(0, 99) < settings_.correctionProbability) {
+                result.shouldCorrect = true;
+            }
+        }
+
+        if (charsSinceLastDouble_ >= nextDoubleAt_ && !(charClass & detail::CHAR_SPACE)) {
+            result.shouldDouble = true;
+            charsSinceLastDouble_ = 0;
+            scheduleNextDouble();
+        }
+
+        return result;
+    }
+
+private:
+    // Counters are touched on every keystroke, the rest only on a typo or double
+    int charsTypedTotal_;
+    int charsSinceLastTypo_;
+    int charsSinceLastDouble_;
+    int nextTypoAt_;
+    int nextDoubleAt_;
+
+    Random* rng_;
+    const KeyboardLayout<CharT, Traits>* layout_;
+    ImperfectionSettings settings_;
+
+    void scheduleNextTypo() {
+        nextTypoAt_ = settings_.enableTypos ? rng_->range(settings_.typoMin, settings_.typoMax) : INT_MAX;
+    }
+
+    void scheduleNextDouble() {
+        nextDoubleAt_ = settings_.enableDoubleKeys ? rng_->range(settings_.doubleMin, settings_.doubleMax) : INT_MAX;
+    }
+};
+
+// ============================================================================
+// Text Chunker
+// ============================================================================
+
+// A run of characters inside the chunker's buffer, valid until the next
+// setText()/append()
+template<typename CharT>
+struct ChunkView {
+    const CharT* data = nullptr;
+    int size = 0;
+
+    bool empty() const { return size == 0; }
+    const CharT* begin() const { return data; }
+    const CharT* end() const { return data + size; }
+    CharT back() const { return data[size - 1]; }
+};
+
+template<typename CharT, typename Traits = CharTraits<CharT>>
+class TextChunker {
+public:
+    using String = typename Traits::String;
+
+    TextChunker() = default;
+    TextChunker(const String& text) { setText(text); }
+
+    void setText(const String& text) { setText(text.data(), static_cast<size_t>(text.size())); }
+
+    void setText(const CharT* data, size_t length) {
+        text_.assign(data, data + length);
+        currentIndex_ = 0;
+        consumed_ = 0;
+    }
+
+    // Adds text to the end, for input that arrives in pieces. Text already
+    // chunked is dropped so the buffer only holds what is still to be typed;
+    // positions keep counting from the start of the whole input.
+    void append(const CharT* data, size_t length) {
+        if (currentIndex_ > 0) {
+            text_.erase(text_.begin(), text_.begin() + currentIndex_);
+            consumed_ += currentIndex_;
+            currentIndex_ = 0;
+        }
+        text_.insert(text_.end(), data, data + length);
+    }
+
+    bool hasMore() const { return currentIndex_ < static_cast<int>(text_.size()); }
+
+    ChunkView<CharT> next() {
+        ChunkView<CharT> chunk;
+        if (!hasMore()) return chunk;
+
+        int length = static_cast<int>(text_.size());
+        int start = currentIndex_;
+        chunk.data = text_.data() + start;
+
+        CharT ch = text_[currentIndex_];
+        if (isStandalone(ch)) {
+            currentIndex_++;
+            chunk.size = 1;
+            return chunk;
+        }
+
+        int limit = TypingConstants::MAX_CHUNK_LENGTH;
+        while (currentIndex_ < length && limit--) {
+            if (isStandalone(text_[currentIndex_])) break;
+            currentIndex_++;
+        }
+
+        chunk.size = currentIndex_ - start;
+        return chunk;
+    }
+
+    String nextChunk() {
+        ChunkView<CharT> chunk = next();
+        return chunk.empty() ? String() : String(chunk.data, chunk.size);
+    }
+
+    int currentPosition() const { return consumed_ + currentIndex_; }
+    int totalLength() const { return consumed_ + static_cast<int>(text_.size()); }
+
+    // Jumps to an absolute position still in the buffer; false if it isn't
+    bool seek(int position) {
+        if (position < consumed_ || position > totalLength()) return false;
+        currentIndex_ = position - consumed_;
+        return true;
+    }
+
+    int progressPercent() const {
+        if (totalLength() == 0) return 100;
+        return (currentPosition() * 100) / totalLength();
+    }
+
+private:
+    std::vector<CharT> text_;
+    int currentIndex_ = 0;
+    int consumed_ = 0;      // Characters dropped from the front by append()
+
+    // Newlines, tabs, punctuation and spaces are never part of a word chunk
+    static bool isStandalone(CharT ch) {
+        char32_t c = Traits::code(ch);
+        return c == '\n' || c == '\t' || detail::isChunkPunct(c) || Traits::isSpace(ch);
+    }
+};
+
+// ============================================================================
+// Simulator Interfaces
+// ============================================================================
+
+template<typename CharT, typename Traits = CharTraits<CharT>>
+class IKeyboardSimulator {
+public:
+    virtual ~IKeyboardSimulator() = default;
+
+    virtual void typeCharacter(CharT c, int holdTimeMs) = 0;
+    virtual void pressBackspace() = 0;
+    virtual void releaseAllKeys() = 0;
+
+    // Sends anything the backend held back to batch with the next keystroke.
+    // The engine calls it before every pause and at the end of each chunk.
+    virtual void flush() {}
+
+    // Called once every key for a character of the text has been sent, or
+    // once it was skipped. For backends that replay a planned chunk later
+    // and need to know how far a stopped replay got.
+    virtual void characterDone() {}
+
+    // Characters this backend can produce. Others are skipped and reported.
+    // Basic ASCII is always safe; ydotool/CGEvent may not handle all Unicode.
+    virtual bool canType(CharT c) const { return Traits::code(c) < 128; }
+};
+
+class IMouseSimulator {
+public:
+    virtual ~IMouseSimulator() = default;
+
+    virtual void moveRelative(int deltaX, int deltaY) = 0;
+    virtual void scroll(int amount) = 0;  // Positive = down, negative = up
+};
+
+// ============================================================================
+// Session State
+// ============================================================================
+
+// Everything a stopped run needs to continue exactly where it left off:
+// the position, the random stream and the state of dynamics and
+// imperfections. Taken between chunks with TypingEngine::checkpoint().
+struct SessionState {
+    uint64_t textHash = 0;      // Of the text it was taken on
+    int textLength = 0;
+    int position = 0;
+
+    Random::State rng = {};
+
+    char32_t previousChar = 0;
+    double rhythmSin = 0.0;
+    double rhythmCos = 1.0;
+    double fatigueFactor = 1.0;
+    int burstRemaining = 0;
+    int totalCharsTyped = 0;
+
+    int charsTypedTotal = 0;
+    int charsSinceLastTypo = 0;
+    int charsSinceLastDouble = 0;
+    int nextTypoAt = 0;
+    int nextDoubleAt = 0;
+
+    int wordsSinceBreak = 0;
+    int charsSinceMouseMove = 0;
+    int nextMouseMoveAt = 0;
+    int skippedCharCount = 0;
+
+    int progressPercent() const {
+        return textLength ? static_cast<int>(int64_t(position) * 100 / textLength) : 100;
+    }
+
+    // Fixed-size little-endian record (133 bytes)
+    std::string serialize() const;
+    static bool deserialize(const std::string& data, SessionState& out);
+
+    // Written to a temporary file and renamed, so a crash mid-save keeps
+    // the previous checkpoint
+    bool save(const std::string& path) const;
+    static bool load(const std::string& path, SessionState& out);
+};
+
+namespace detail {
+    // FNV-1a over code points, extended as text is appended
+    constexpr uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+
+    template<typename CharT, typename Traits>
+    uint64_t hashText(uint64_t hash, const CharT* data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ Traits::code(data[i])) * 0x100000001B3ull;
+        }
+        return hash;
+    }
+}
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+// Lets another thread (a stop button, an ESC watcher, a network command)
+// end a typing run. Waits that take the token return as soon as it is
+// cancelled instead of sleeping out the delay.
+class CancellationToken {
+public:
+    CancellationToken() = default;
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    void cancel();
+    void reset();
+
+    bool isCancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+    // Sleeps until the deadline; false if cancelled first
+    bool waitUntil(std::chrono::steady_clock::time_point deadline);
+
+    // Mirrors the state into a platform wait object (a Windows event) for
+    // waits the condition variable can't join. Called with true by cancel()
+    // and false by reset(), on the calling thread.
+    void setNotifier(std::function<void(bool)> notifier);
+
+private:
+    std::atomic<bool> cancelled_{false};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::function<void(bool)> notifier_;
+};
+
+// Monotonic time and sleeping, so platforms can plug in a precise timer and
+// tests can run the timing logic without waiting
+class IClock {
+public:
+    virtual ~IClock() = default;
+
+    virtual int64_t nowUs() const = 0;
+    virtual void sleepUntilUs(int64_t deadlineUs) = 0;
+
+    // Like sleepUntilUs(), but false as soon as token is cancelled. Clocks
+    // that can't be woken early only check the token around the sleep.
+    virtual bool waitUntilUs(int64_t deadlineUs, CancellationToken& token) {
+        if (token.isCancelled()) return false;
+        sleepUntilUs(deadlineUs);
+        return !token.isCancelled();
+    }
+
+    void sleepForMs(int ms) { sleepUntilUs(nowUs() + int64_t(ms) * 1000); }
+
+    // Cancellable when a token is given
+    bool waitForMs(int ms, CancellationToken* token) {
+        int64_t deadline = nowUs() + int64_t(ms) * 1000;
+        if (!token) {
+            sleepUntilUs(deadline);
+            return true;
+        }
+        return waitUntilUs(deadline, *token);
+    }
+};
+
+class SteadyClock : public IClock {
+public:
+    int64_t nowUs() const override {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void sleepUntilUs(int64_t deadlineUs) override {
+        std::this_thread::sleep_until(toTimePoint(deadlineUs));
+    }
+
+    bool waitUntilUs(int64_t deadlineUs, CancellationToken& token) override {
+        return token.waitUntil(toTimePoint(deadlineUs));
+    }
+
+private:
+    static std::chrono::steady_clock::time_point toTimePoint(int64_t us) {
+        return std::chrono::steady_clock::time_point(std::chrono::microseconds(us));
+    }
+};
+
+// Shared SteadyClock used when nothing else is set
+IClock& systemClock();
+
+// Waits out the delays between chunks. Whatever a wait overshoots its
+// deadline by (timer granularity, scheduling) is taken off the next waits,
+// so the run keeps the rhythm the dynamics asked for instead of drifting
+// late by a tick per chunk.
+class Pacer {
+public:
+    explicit Pacer(IClock& clock = systemClock()) : clock_(&clock) {}
+
+    void reset() { debtUs_ = 0; }
+
+    // False if token was cancelled before the delay ran out
+    bool wait(int delayMs, CancellationToken* token = nullptr) {
+        int64_t delayUs = int64_t(delayMs) * 1000;
+        int64_t repaid = std::min(debtUs_, delayUs);
+        int64_t deadline = clock_->nowUs() + delayUs - repaid;
+
+        if (!token) {
+            clock_->sleepUntilUs(deadline);
+        } else if (!clock_->waitUntilUs(deadline, *token)) {
+            debtUs_ = 0;
+            return false;
+        }
+
+        int64_t overshoot = clock_->nowUs() - deadline;
+        debtUs_ = debtUs_ - repaid + std::max<int64_t>(0, overshoot);
+        return true;
+    }
+
+    // Time still owed from past overshoots
+    int64_t debtUs() const { return debtUs_; }
+
+private:
+    IClock* clock_;
+    int64_t debtUs_ = 0;
+};
+
+// Many timers on one wakeup source. Hashed hierarchical wheel (Varghese &
+// Lauck): LEVELS rings of SLOTS buckets, each level SLOTS times coarser than
+// the one below, so schedule() and cancel() are O(1) and advance() costs one
+// bucket per tick plus a re-bucketing when a coarse slot comes due.
+// Times are in ticks; the caller picks the unit (milliseconds everywhere
+// in qtype). Not thread-safe: callers that share a wheel lock around it.
+class TimingWheel {
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 4;    // 2^24 ticks (4.6 h at 1 ms); later ones wait at the top
+
+    // Owned by the caller and linked into the wheel while scheduled. The
+    // callback runs from advance() after the timer is unlinked, so it may
+    // schedule it again.
+    class Timer {
+    public:
+        Timer() = default;
+        explicit Timer(std::function<void()> callback) : callback(std::move(callback)) {}
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        bool isScheduled() const { return prev_ != nullptr; }
+        int64_t expiry() const { return expiry_; }
+
+        std::function<void()> callback;
+
+    private:
+        friend class TimingWheel;
+        Timer* prev_ = nullptr;
+        Timer* next_ = nullptr;
+        int64_t expiry_ = 0;
+    };
+
+    explicit TimingWheel(int64_t nowTick = 0);
+    ~TimingWheel();
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    // Fires on the first advance() that reaches expiryTick; times already
+    // passed fire on the next tick. Rescheduling moves the timer.
+    void schedule(Timer& timer, int64_t expiryTick);
+    void cancel(Timer& timer);
+
+    // Runs every timer due up to nowTick, in expiry order across ticks
+    void advance(int64_t nowTick);
+
+    int64_t now() const { return now_; }
+    size_t size() const { return size_; }
+
+    // Tick to advance to next: the exact expiry for timers in the finest
+    // ring, otherwise when the nearest coarse slot is re-bucketed (at most
+    // one extra wakeup per level). INT64_MAX if empty.
+    int64_t nextWakeup() const;
+
+private:
+    Timer slots_[LEVELS][SLOTS];    // Sentinels of circular lists
+    int64_t now_;
+    size_t size_ = 0;
+
+    void place(Timer& timer);
+    void cascade(int level);
+    static void unlink(Timer& timer);
+};
+
+// A thread's timers on one millisecond TimingWheel, woken by a single source
+// the owner already has (a single-shot QTimer, a select() timeout): sleep
+// msUntilNextRun(), then run(). Records how late each wakeup came against
+// the time it was asked for, i.e. the timer slack of that source.
+class EventTimers {
+public:
+    struct Slack {
+        int64_t wakeups = 0;
+        int64_t totalUs = 0;
+        int64_t maxUs = 0;
+
+        double averageMs() const { return wakeups ? totalUs / 1000.0 / wakeups : 0.0; }
+    };
+
+    explicit EventTimers(IClock& clock = systemClock());
+
+    // One-shot; periodic timers start themselves again from their callback
+    void start(TimingWheel::Timer& timer, int delayMs);
+    void stop(TimingWheel::Timer& timer) { wheel_.cancel(timer); }
+
+    // Runs the callbacks that are due
+    void run();
+
+    // How long to sleep before the next run(); -1 if nothing is scheduled
+    int msUntilNextRun();
+
+    const Slack& slack() const { return slack_; }
+    void resetSlack() { slack_ = Slack(); }
+
+    IClock& clock() const { return *clock_; }
+
+private:
+    IClock* clock_;
+    TimingWheel wheel_;
+    int64_t plannedUs_ = INT64_MAX;
+    Slack slack_;
+};
+
+// ============================================================================
+// Main Typing Engine
+// ============================================================================
+
+// Profile is DynamicProfile for a profile chosen at run time, or one of the
+// StaticProfile presets for frontends that always type the same way
+template<typename CharT, typename Traits = CharTraits<CharT>,
+         typename Profile = DynamicProfile>
+class TypingEngine {
+public:
+    using String = typename Traits::String;
+
+    TypingEngine(IKeyboardSimulator<CharT, Traits>* simulator,
+                 IMouseSimulator* mouseSimulator,
+                 const TimingProfile& profile,
+                 const DelayRange& delays,
+                 const ImperfectionSettings& imperfections,
+                 KeyboardLayoutType layoutType = KeyboardLayoutType::US_QWERTY)
+        : layout_(layoutType)
+        , hot_(simulator, profile, delays, imperfections, layout_)
+        , mouseSimulator_(mouseSimulator)
+    {}
+
+    // Engines on a StaticProfile take their profile from the type
+    TypingEngine(IKeyboardSimulator<CharT, Traits>* simulator,
+                 IMouseSimulator* mouseSimulator,
+                 const DelayRange& delays,
+                 const ImperfectionSettings& imperfections,
+                 KeyboardLayoutType layoutType = KeyboardLayoutType::US_QWERTY)
+        : TypingEngine(simulator, mouseSimulator, defaultProfile(), delays,
+                       imperfections, layoutType)
+    {}
+
+    // Components keep pointers to the engine's Random and layout
+    TypingEngine(const TypingEngine&) = delete;
+    TypingEngine& operator=(const TypingEngine&) = delete;
+
+    void setText(const String& text) { setText(text.data(), static_cast<size_t>(text.size())); }
+
+    // Restarts the components in place; the text buffer keeps its capacity,
+    // so a new run of the same size doesn't allocate
+    void setText(const CharT* data, size_t length) {
+        hot_.chunker.setText(data, length);
+        textHash_ = detail::hashText<CharT, Traits>(detail::FNV_OFFSET, data, length);
+        hot_.dynamics.reset();
+        hot_.imperfections.reset();
+        hot_.hasText = true;
+        hot_.wordsSinceBreak = 0;
+        hot_.charsSinceMouseMove = 0;
+        hot_.skippedCharCount = 0;
+        skippedCharsPreview_.clear();
+        scheduleNextMouseMove();
+    }
+
+    // Continues the current text with more input (streamed documents)
+    void appendText(const CharT* data, size_t length) {
+        if (!hot_.hasText) {
+            setText(data, length);
+            return;
+        }
+        hot_.chunker.append(data, length);
+        textHash_ = detail::hashText<CharT, Traits>(textHash_, data, length);
+    }
+
+    // Snapshot to continue this run later; take it between chunks or after
+    // a stop, which leaves the position after the last character typed
+    SessionState checkpoint() const {
+        SessionState state;
+        if (!hot_.hasText) return state;
+
+        state.textHash = textHash_;
+        state.textLength = hot_.chunker.totalLength();
+        state.position = hot_.chunker.currentPosition();
+        state.rng = hot_.rng.state();
+
+        typename TypingDynamics<CharT, Traits, Profile>::State dynamics = hot_.dynamics.state();
+        state.previousChar = dynamics.previousChar;
+        state.rhythmSin = dynamics.rhythmSin;
+        state.rhythmCos = dynamics.rhythmCos;
+        state.fatigueFactor = dynamics.fatigueFactor;
+        state.burstRemaining = dynamics.burstRemaining;
+        state.totalCharsTyped = dynamics.totalCharsTyped;
+
+        typename ImperfectionGenerator<CharT, Traits>::State imperfections = hot_.imperfections.state();
+        state.charsTypedTotal = imperfections.charsTypedTotal;
+        state.charsSinceLastTypo = imperfections.charsSinceLastTypo;
+        state.charsSinceLastDouble = imperfections.charsSinceLastDouble;
+        state.nextTypoAt = imperfections.nextTypoAt;
+        state.nextDoubleAt = imperfections.nextDoubleAt;
+
+        state.wordsSinceBreak = hot_.wordsSinceBreak;
+        state.charsSinceMouseMove = hot_.charsSinceMouseMove;
+        state.nextMouseMoveAt = hot_.nextMouseMoveAt;
+        state.skippedCharCount = hot_.skippedCharCount;
+        return state;
+    }
+
+    // Loads text and continues from a checkpoint taken on the same text.
+    // Jumps straight to the saved position; nothing before it is replayed.
+    // Returns false (and starts from the beginning) if the checkpoint
+    // belongs to different text.
+    bool resume(const String& text, const SessionState& state) {
+        setText(text);
+        if (state.textHash != textHash_ || state.textLength != hot_.chunker.totalLength() ||
+            !hot_.chunker.seek(state.position)) {
+            return false;
+        }
+
+        hot_.rng.setState(state.rng);
+        hot_.dynamics.setState({state.previousChar, state.rhythmSin, state.rhythmCos,
+                                state.fatigueFactor, state.burstRemaining, state.totalCharsTyped});
+        hot_.imperfections.setState({state.charsTypedTotal, state.charsSinceLastTypo,
+                                     state.charsSinceLastDouble, state.nextTypoAt,
+                                     state.nextDoubleAt});
+
+        hot_.wordsSinceBreak = state.wordsSinceBreak;
+        hot_.charsSinceMouseMove = state.charsSinceMouseMove;
+        hot_.nextMouseMoveAt = state.nextMouseMoveAt;
+        hot_.skippedCharCount = state.skippedCharCount;
+        return true;
+    }
+
+    bool hasMoreToType() const { return hot_.chunker.hasMore(); }
+
+    void setMouseMovementEnabled(bool enabled) {
+        hot_.mouseMovementEnabled = enabled;
+        if (enabled) {
+            scheduleNextMouseMove();
+        }
+    }
+
+    void setDelayRange(const DelayRange& delays) { hot_.dynamics.setDelayRange(delays); }
+
+    // Replaces the random stream, for reproducible runs
+    void seed(uint64_t seed) { hot_.rng.seed(seed); }
+
+    // Clock for the pauses inside a chunk (double keys, corrections)
+    void setClock(IClock* clock) { clock_ = clock ? clock : &systemClock(); }
+
+    // Once the token is cancelled the engine stops typing, mid-chunk and
+    // mid-pause included
+    void setCancellationToken(CancellationToken* token) { hot_.cancel = token; }
+
+    bool isCancelled() const { return hot_.cancel && hot_.cancel->isCancelled(); }
+
+    // Types the next chunk and returns how long to wait before the next call
+    int typeNextChunk() {
+        if (!hasMoreToType() || isCancelled()) return 0;
+
+        // Check if we should move mouse before typing this chunk
+        if (shouldMoveMouse()) {
+            performMouseMovement();
+            // Return a pause delay - typing stops during mouse movement
+            return hot_.rng.range(TypingConstants::MIN_MOUSE_PAUSE_MS,
+                                  TypingConstants::MAX_MOUSE_PAUSE_MS);
+        }
+
+        ChunkView<CharT> chunk = hot_.chunker.next();
+        if (chunk.empty()) return 0;
+        int chunkStart = hot_.chunker.currentPosition() - chunk.size;
+        int done = 0;       // Characters of the chunk with all their keystrokes sent
+
+        IKeyboardSimulator<CharT, Traits>* simulator = hot_.simulator;
+        for (CharT originalChar : chunk) {
+            if (isCancelled()) break;
+            hot_.charsSinceMouseMove++;
+
+            // Check if character can be typed
+            if (!simulator->canType(originalChar)) {
+                recordSkippedChar(originalChar);
+                simulator->characterDone();
+                done++;
+                continue; // Skip this character
+            }
+
+            uint8_t charClass = detail::charClass<Traits>(originalChar);
+            ImperfectionResult<CharT> result = hot_.imperfections.processCharacter(originalChar, charClass);
+
+            int holdTime = hot_.dynamics.generateHoldTime(result.character);
+            simulator->typeCharacter(result.character, holdTime);
+
+            if (result.shouldDouble) {
+                int secondHold = hot_.dynamics.generateHoldTime(result.character);
+                simulator->flush();
+                if (!pause(hot_.rng.range(TypingConstants::MIN_DOUBLE_KEY_DELAY_MS,
+                                          TypingConstants::MAX_DOUBLE_KEY_DELAY_MS))) {
+                    if (result.shouldCorrect) simulator->pressBackspace();
+                    break;
+                }
+                simulator->typeCharacter(result.character, secondHold);
+            }
+
+            if (result.shouldCorrect) {
+                simulator->flush();
+                if (!pause(hot_.rng.range(TypingConstants::MIN_CORRECTION_DELAY_MS,
+                                          TypingConstants::MAX_CORRECTION_DELAY_MS))) {
+                    // The stop leaves this character to the next run, so the
+                    // typo can't stay on screen
+                    simulator->pressBackspace();
+                    break;
+                }
+                simulator->pressBackspace();
+                int corrHold = hot_.dynamics.generateHoldTime(originalChar);
+                simulator->flush();
+                if (!pause(hot_.rng.range(TypingConstants::MIN_BACKSPACE_DELAY_MS,
+                                          TypingConstants::MAX_BACKSPACE_DELAY_MS))) break;
+                simulator->typeCharacter(originalChar, corrHold);
+            }
+
+            if (charClass & detail::CHAR_SPACE) hot_.wordsSinceBreak++;
+
+            hot_.dynamics.updateState(originalChar);
+            simulator->characterDone();
+            done++;
+        }
+        simulator->flush();
+
+        // Stopped inside the chunk: the next chunk, and a checkpoint taken
+        // now, start at the first character that didn't go out completely
+        if (done < chunk.size) hot_.chunker.seek(chunkStart + done);
+        if (isCancelled()) return 0;
+
+        CharT lastChar = chunk.back();
+        char32_t lastCode = Traits::code(lastChar);
+        bool isSentenceEnd = (lastCode == '.' || lastCode == '!' || lastCode == '?');
+        bool isBurst = hot_.dynamics.shouldBurst();
+        bool isThinkingPause = hot_.dynamics.shouldThinkingPause(hot_.wordsSinceBreak);
+
+        if (isThinkingPause) hot_.wordsSinceBreak = 0;
+
+        return hot_.dynamics.calculateDelay(lastChar, isSentenceEnd, isBurst, isThinkingPause);
+    }
+
+    int progressPercent() const { return hot_.hasText ? hot_.chunker.progressPercent() : 0; }
+    int currentPosition() const { return hot_.chunker.currentPosition(); }
+
+    // Moves back to a position still in the buffer, for a player that
+    // stopped part-way through a chunk planned ahead. Only the position
+    // moves; false if it isn't in the buffer.
+    bool seek(int position) { return hot_.chunker.seek(position); }
+
+    void reset() {
+        hot_.dynamics.reset();
+        hot_.imperfections.reset();
+        hot_.wordsSinceBreak = 0;
+    }
+
+    int getSkippedCharCount() const { return hot_.skippedCharCount; }
+    String getSkippedCharsPreview() const { return skippedCharsPreview_; }
+
+    // Bytes of per-run state a keystroke works in (a whole number of cache lines)
+    static constexpr size_t hotStateSize() { return sizeof(HotState); }
+
+private:
+    // Everything typeNextChunk() reads or writes per keystroke, in one
+    // cache-line-aligned block inside the engine. Built once with the engine
+    // and restarted in place by setText(). Within each component the
+    // per-keystroke fields come first.
+    struct alignas(TypingConstants::CACHE_LINE_BYTES) HotState {
+        HotState(IKeyboardSimulator<CharT, Traits>* simulator,
+                 const TimingProfile& profile,
+                 const DelayRange& delays,
+                 const ImperfectionSettings& settings,
+                 const KeyboardLayout<CharT, Traits>& layout)
+            : simulator(simulator)
+            , imperfections(settings, layout, rng)
+            , dynamics(profile, delays, rng)
+        {}
+
+        Random rng;
+        IKeyboardSimulator<CharT, Traits>* simulator;
+        CancellationToken* cancel = nullptr;
+
+        int charsSinceMouseMove = 0;
+        int nextMouseMoveAt = 0;
+        int wordsSinceBreak = 0;
+        int skippedCharCount = 0;
+        bool mouseMovementEnabled = false;
+        bool hasText = false;
+
+        TextChunker<CharT, Traits> chunker;
+        ImperfectionGenerator<CharT, Traits> imperfections;
+        TypingDynamics<CharT, Traits, Profile> dynamics;
+    };
+
+    KeyboardLayout<CharT, Traits> layout_;
+    HotState hot_;
+
+    // Touched per run or per mouse move, not per keystroke
+    IMouseSimulator* mouseSimulator_;
+    IClock* clock_ = &systemClock();
+    uint64_t textHash_ = detail::FNV_OFFSET;
+    String skippedCharsPreview_;
+
+    static TimingProfile defaultProfile() {
+        if constexpr (std::is_same_v<Profile, DynamicProfile>) {
+            return TimingProfile();
+        } else {
+            return Profile::value;
+        }
+    }
+
+    // False if the run was cancelled during the pause
+    bool pause(int ms) {
+        return clock_->waitForMs(ms, hot_.cancel);
+    }
+
+    void scheduleNextMouseMove() {
+        hot_.nextMouseMoveAt = hot_.rng.range(TypingConstants::MIN_MOUSE_MOVE_INTERVAL_CHARS,
+                                              TypingConstants::MAX_MOUSE_MOVE_INTERVAL_CHARS);
+    }
+
+    bool shouldMoveMouse() const {
+        return hot_.mouseMovementEnabled && mouseSimulator_ &&
+               hot_.charsSinceMouseMove >= hot_.nextMouseMoveAt;
+    }
+
+    void performMouseMovement() {
+        if (!mouseSimulator_) return;
+
+        // Generate small random movement
+        int deltaX = hot_.rng.range(-TypingConstants::MAX_MOUSE_PIXELS,
+                                    TypingConstants::MAX_MOUSE_PIXELS);
+        int deltaY = hot_.rng.range(-TypingConstants::MAX_MOUSE_PIXELS,
+                                    TypingConstants::MAX_MOUSE_PIXELS);
+
+        // Avoid zero movement
+        if (deltaX == 0 && deltaY == 0) {
+            deltaX = hot_.rng.range(TypingConstants::MIN_MOUSE_PIXELS,
+                                    TypingConstants::MAX_MOUSE_PIXELS);
+        }
+
+        mouseSimulator_->moveRelative(deltaX, deltaY);
+
+        hot_.charsSinceMouseMove = 0;
+        scheduleNextMouseMove();
+    }
+
+    void recordSkippedChar(CharT c) {
+        hot_.skippedCharCount++;
+        if (skippedCharsPreview_.size() >= 20) return;
+
+        for (CharT seen : skippedCharsPreview_) {
+            if (seen == c) return;
+        }
+        if (!skippedCharsPreview_.empty()) {
+            skippedCharsPreview_.push_back(Traits::fromAscii(','));
+            skippedCharsPreview_.push_back(Traits::fromAscii(' '));
+        }
+        skippedCharsPreview_.push_back(c);
+    }
+};
+
+// Built once in the library for the standard character types
+extern template class TextChunker<char>;
+extern template class TextChunker<wchar_t>;
+extern template class TextChunker<char16_t>;
+extern template class TypingDynamics<char>;
+extern template class TypingDynamics<wchar_t>;
+extern template class TypingDynamics<char16_t>;
+extern template class ImperfectionGenerator<char>;
+extern template class ImperfectionGenerator<wchar_t>;
+extern template class ImperfectionGenerator<char16_t>;
+extern template class TypingEngine<char>;
+extern template class TypingEngine<wchar_t>;
+extern template class TypingEngine<char16_t>;
+
+} // namespace qtype
+
+#endif // TYPING_CORE_H
@@ -0,0 +1,422 @@
+// typing_pipeline.h - Planner and player threads joined by a bounded ring
+//
+// The blocking engine draws random numbers, chunks text and computes the
+// dynamics on the thread that injects the keys, so every keystroke waits on
+// that work. TypingPipeline splits the two: a planner thread runs the engine
+// on paper and queues timestamped events in a fixed-size single-producer/
+// single-consumer ring, and the player (the caller's thread) only pops them
+// and injects each at its deadline. The ring caps what is planned ahead, so
+// memory stays bounded however long the input is.
+#ifndef TYPING_PIPELINE_H
+#define TYPING_PIPELINE_H
+
+#include "plan_cache.h"
+#include "typing_core.h"
+
+namespace qtype {
+
+// ============================================================================
+// SPSC Ring
+// ============================================================================
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// Each side keeps its own index on its own cache line and caches the other
+// side's, so it only reads the shared line when the cached one says full
+// (or empty). Capacity is rounded up to a power of two.
+template<typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only; false if the ring is full
+    bool tryPush(const T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == slots_.size()) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == slots_.size()) return false;
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only; false if the ring is empty
+    bool tryPop(T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) return false;
+        }
+        item = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Items queued; exact on either side, a snapshot from any other thread
+    size_t size() const {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+    // Empties the ring; only while neither side is using it
+    void clear() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cachedHead_ = cachedTail_ = 0;
+    }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+
+    alignas(TypingConstants::CACHE_LINE_BYTES) std::atomic<size_t> head_{0};  // Consumer's
+    size_t cachedTail_ = 0;
+    alignas(TypingConstants::CACHE_LINE_BYTES) std::atomic<size_t> tail_{0};  // Producer's
+    size_t cachedHead_ = 0;
+};
+
+// ============================================================================
+// Planned Events
+// ============================================================================
+
+template<typename CharT>
+struct PlannedEvent {
+    enum Kind : uint8_t { Type, Backspace, Release, Flush, MouseMove, Scroll, ChunkEnd, End };
+
+    Kind kind = End;
+    CharT character = CharT();
+    int value = 0;          // Hold (Type), delta x (MouseMove), amount (Scroll), position (ChunkEnd)
+    int deltaY = 0;         // MouseMove only
+    int64_t atUs = 0;       // When to play it, from the start of the run
+};
+
+// Snapshot of a pipeline's counters, readable from any thread
+struct PipelineStats {
+    size_t capacity = 0;
+    size_t fill = 0;                // Events planned but not played yet
+    size_t peakFill = 0;
+    uint64_t planned = 0;
+    uint64_t played = 0;
+    uint64_t plannerStalls = 0;     // Times the planner found the ring full
+    uint64_t underruns = 0;         // Times the player found it empty mid-run
+
+    double fillLevel() const { return capacity ? double(fill) / double(capacity) : 0.0; }
+};
+
+// ============================================================================
+// Typing Pipeline
+// ============================================================================
+
+template<typename CharT, typename Traits = CharTraits<CharT>,
+         typename Profile = DynamicProfile>
+class TypingPipeline {
+public:
+    using Engine = TypingEngine<CharT, Traits, Profile>;
+    using String = typename Traits::String;
+    using Event = PlannedEvent<CharT>;
+
+    // Called on the planner thread for more text; false at the end of input
+    using Source = std::function<bool(String& text)>;
+
+    TypingPipeline(IKeyboardSimulator<CharT, Traits>* simulator,
+                   IMouseSimulator* mouseSimulator,
+                   const TimingProfile& profile,
+                   const DelayRange& delays,
+                   const ImperfectionSettings& imperfections,
+                   KeyboardLayoutType layout = KeyboardLayoutType::US_QWERTY,
+                   size_t ringEvents = TypingConstants::PIPELINE_RING_EVENTS)
+        : simulator_(simulator)
+        , mouseSimulator_(mouseSimulator)
+        , ring_(ringEvents)
+        , recorder_(*this)
+        , engine_(&recorder_, mouseSimulator ? &recorder_ : nullptr, profile, delays,
+                  imperfections, layout)
+    {
+        engine_.setClock(&recorder_);
+    }
+
+    // Pipelines on a StaticProfile take their profile from the type
+    TypingPipeline(IKeyboardSimulator<CharT, Traits>* simulator,
+                   IMouseSimulator* mouseSimulator,
+                   const DelayRange& delays,
+                   const ImperfectionSettings& imperfections,
+                   KeyboardLayoutType layout = KeyboardLayoutType::US_QWERTY,
+                   size_t ringEvents = TypingConstants::PIPELINE_RING_EVENTS)
+        : simulator_(simulator)
+        , mouseSimulator_(mouseSimulator)
+        , ring_(ringEvents)
+        , recorder_(*this)
+        , engine_(&recorder_, mouseSimulator ? &recorder_ : nullptr, delays, imperfections, layout)
+    {
+        engine_.setClock(&recorder_);
+    }
+
+    TypingPipeline(const TypingPipeline&) = delete;
+    TypingPipeline& operator=(const TypingPipeline&) = delete;
+
+    // Seeds, delays and mouse settings; configure it between runs only.
+    // Its simulator and clock are the planner's.
+    Engine& engine() { return engine_; }
+
+    // The player's clock; the planner keeps its own time
+    void setClock(IClock* clock) { clock_ = clock ? clock : &systemClock(); }
+
+    // Plans the source's text on a new thread and plays it on this one.
+    // Returns when everything is played or stop is cancelled; a source
+    // blocked waiting for input must also return when stop is cancelled.
+    // onChunkPlayed gets the text position after each chunk, on this thread.
+    void run(const Source& source, CancellationToken& stop,
+             const std::function<void(int position)>& onChunkPlayed = {}) {
+        ring_.clear();
+        resetCounters();
+
+        recorder_.restart(&stop);
+        engine_.setCancellationToken(&stop);
+        engine_.setText(String());
+
+        std::thread planner([this, &source, &stop] { plan(source, stop); });
+        play([this](Event& event) { return ring_.tryPop(event); }, stop, onChunkPlayed);
+        planner.join();
+    }
+
+    // Whole-text run through a plan cache. A plan stored under key is
+    // played straight from the cache, with no planner thread; otherwise the
+    // text is planned as usual and the plan stored once the run completes.
+    // key is planKey() over the text, the settings this pipeline was built
+    // with and the seed its engine was given.
+    // Returns true on a cache hit. A hit doesn't run the engine, so the
+    // engine's skipped-character count is not updated.
+    bool run(const String& text, uint64_t key, PlanCache& cache, CancellationToken& stop,
+             const std::function<void(int position)>& onChunkPlayed = {}) {
+        PlanView plan;
+        if (cache.load(key, plan)) {
+            resetCounters();
+            planned_.store(plan.size(), std::memory_order_relaxed);
+
+            const PlanRecord* next = plan.begin();
+            play([&](Event& event) {
+                event = next != plan.end() ? fromRecord(*next++) : Event();
+                return true;
+            }, stop, onChunkPlayed);
+            return true;
+        }
+
+        std::vector<PlanRecord> records;
+        recording_ = &records;
+        bool given = false;
+        run([&](String& piece) {
+            if (given) return false;
+            piece = text;
+            given = true;
+            return true;
+        }, stop, onChunkPlayed);
+        recording_ = nullptr;
+
+        if (!stop.isCancelled()) cache.store(key, records.data(), records.size());
+        return false;
+    }
+
+    PipelineStats stats() const {
+        PipelineStats stats;
+        stats.capacity = ring_.capacity();
+        stats.fill = ring_.size();
+        stats.peakFill = peakFill_.load(std::memory_order_relaxed);
+        stats.planned = planned_.load(std::memory_order_relaxed);
+        stats.played = played_.load(std::memory_order_relaxed);
+        stats.plannerStalls = plannerStalls_.load(std::memory_order_relaxed);
+        stats.underruns = underruns_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    // Share of the ring holding planned events, 0 to 1
+    double fillLevel() const { return double(ring_.size()) / double(ring_.capacity()); }
+
+private:
+    // Stands in for the simulators and the clock on the planner thread:
+    // keystrokes become events stamped with the time on paper, and holds
+    // and pauses move that time on
+    class Recorder : public IKeyboardSimulator<CharT, Traits>, public IMouseSimulator, public IClock {
+    public:
+        explicit Recorder(TypingPipeline& owner) : owner_(owner) {}
+
+        void restart(CancellationToken* stop) {
+            stop_ = stop;
+            nowUs_ = 0;
+        }
+
+        void typeCharacter(CharT c, int holdTimeMs) override {
+            push({Event::Type, c, holdTimeMs, 0, 0});
+            nowUs_ += int64_t(holdTimeMs) * 1000;
+        }
+        void pressBackspace() override {
+            push({Event::Backspace, CharT(), 0, 0, 0});
+            nowUs_ += int64_t(TypingConstants::BACKSPACE_HOLD_MS) * 1000;
+        }
+        void releaseAllKeys() override { push({Event::Release, CharT(), 0, 0, 0}); }
+        void flush() override { push({Event::Flush, CharT(), 0, 0, 0}); }
+
+        // Backends answer this from tables set up before the run
+        bool canType(CharT c) const override { return owner_.simulator_->canType(c); }
+
+        void moveRelative(int deltaX, int deltaY) override {
+            push({Event::MouseMove, CharT(), deltaX, deltaY, 0});
+        }
+        void scroll(int amount) override { push({Event::Scroll, CharT(), amount, 0, 0}); }
+
+        int64_t nowUs() const override { return nowUs_; }
+        void sleepUntilUs(int64_t deadlineUs) override { nowUs_ = std::max(nowUs_, deadlineUs); }
+
+        // Waits for room while the player catches up; the event is dropped
+        // if the run is stopped meanwhile
+        void push(Event event) {
+            event.atUs = nowUs_;
+            if (owner_.recording_ && event.kind != Event::End) {
+                owner_.recording_->push_back(toRecord(event));
+            }
+            if (!owner_.ring_.tryPush(event)) {
+                owner_.plannerStalls_.fetch_add(1, std::memory_order_relaxed);
+                do {
+                    auto retry = std::chrono::steady_clock::now() +
+                                 std::chrono::milliseconds(TypingConstants::PIPELINE_REFILL_MS);
+                    if (!stop_->waitUntil(retry)) return;
+                } while (!owner_.ring_.tryPush(event));
+            }
+            owner_.planned_.fetch_add(1, std::memory_order_relaxed);
+
+            size_t fill = owner_.ring_.size();
+            if (fill > owner_.peakFill_.load(std::memory_order_relaxed)) {
+                owner_.peakFill_.store(fill, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        TypingPipeline& owner_;
+        CancellationToken* stop_ = nullptr;
+        int64_t nowUs_ = 0;
+    };
+
+    IKeyboardSimulator<CharT, Traits>* simulator_;
+    IMouseSimulator* mouseSimulator_;
+    IClock* clock_ = &systemClock();
+
+    SpscRing<Event> ring_;
+    Recorder recorder_;
+    Engine engine_;             // Planner thread only while running
+
+    std::atomic<size_t> peakFill_{0};
+    std::atomic<uint64_t> planned_{0};
+    std::atomic<uint64_t> played_{0};
+    std::atomic<uint64_t> plannerStalls_{0};
+    std::atomic<uint64_t> underruns_{0};
+
+    std::vector<PlanRecord>* recording_ = nullptr;     // Planner's copy for the plan cache
+
+    void resetCounters() {
+        peakFill_.store(0, std::memory_order_relaxed);
+        planned_.store(0, std::memory_order_relaxed);
+        played_.store(0, std::memory_order_relaxed);
+        plannerStalls_.store(0, std::memory_order_relaxed);
+        underruns_.store(0, std::memory_order_relaxed);
+    }
+
+    static PlanRecord toRecord(const Event& event) {
+        PlanRecord record;
+        record.atUs = event.atUs;
+        record.code = static_cast<uint32_t>(Traits::code(event.character));
+        record.value = event.value;
+        record.deltaY = event.deltaY;
+        record.kind = event.kind;
+        return record;
+    }
+
+    static Event fromRecord(const PlanRecord& record) {
+        Event event;
+        event.kind = static_cast<typename Event::Kind>(record.kind);
+        event.character = Traits::fromCode(record.code);
+        event.value = record.value;
+        event.deltaY = record.deltaY;
+        event.atUs = record.atUs;
+        return event;
+    }
+
+    // Planner thread. Only takes more text once the engine has typed out
+    // what it has, so the chunker holds at most one piece of the input.
+    void plan(const Source& source, CancellationToken& stop) {
+        String text;
+        while (!stop.isCancelled()) {
+            if (!engine_.hasMoreToType()) {
+                if (!source(text)) break;
+                engine_.appendText(text.data(), static_cast<size_t>(text.size()));
+                continue;
+            }
+
+            int delayMs = engine_.typeNextChunk();
+            recorder_.push({Event::ChunkEnd, CharT(), engine_.currentPosition(), 0, 0});
+            recorder_.sleepForMs(delayMs);
+        }
+        recorder_.push({Event::End, CharT(), 0, 0, 0});
+    }
+
+    // Player thread: nothing here but waiting and injecting. next() yields
+    // the following event, or false if none is planned yet.
+    template<typename Next>
+    void play(Next&& next, CancellationToken& stop, const std::function<void(int)>& onChunkPlayed) {
+        int64_t baseUs = clock_->nowUs();
+        bool rebase = true;         // Before the first event and after an underrun
+        Event event;
+
+        while (!stop.isCancelled()) {
+            if (!next(event)) {
+                // Out of planned events: the input is late, not the planner.
+                // Resume from whenever the next event comes instead of
+                // bursting to catch up with the time lost.
+                if (!rebase) underruns_.fetch_add(1, std::memory_order_relaxed);
+                rebase = true;
+                stop.waitUntil(std::chrono::steady_clock::now() +
+                               std::chrono::milliseconds(TypingConstants::PIPELINE_POLL_MS));
+                continue;
+            }
+            if (event.kind == Event::End) break;
+
+            if (rebase) {
+                baseUs = std::max(baseUs, clock_->nowUs() - event.atUs);
+                rebase = false;
+            }
+            if (!clock_->waitUntilUs(baseUs + event.atUs, stop)) break;
+
+            switch (event.kind) {
+                case Event::Type:       simulator_->typeCharacter(event.character, event.value); break;
+                case Event::Backspace:  simulator_->pressBackspace(); break;
+                case Event::Release:    simulator_->releaseAllKeys(); break;
+                case Event::Flush:      simulator_->flush(); break;
+                case Event::MouseMove:
+                    if (mouseSimulator_) mouseSimulator_->moveRelative(event.value, event.deltaY);
+                    break;
+                case Event::Scroll:
+                    if (mouseSimulator_) mouseSimulator_->scroll(event.value);
+                    break;
+                case Event::ChunkEnd:
+                    if (onChunkPlayed) onChunkPlayed(event.value);
+                    break;
+                case Event::End:        break;
+            }
+            played_.fetch_add(1, std::memory_order_relaxed);
+        }
+        simulator_->flush();
+    }
+};
+
+} // namespace qtype
+
+#endif // TYPING_PIPELINE_H
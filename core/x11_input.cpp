@@ -0,0 +1,139 @@
+// x11_input.cpp - XTest display connection
+#include "x11_input.h"
+
+#ifdef QTYPE_HAVE_XTEST
+
+#include <cstdlib>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XTest.h>
+#include <X11/keysym.h>
+
+namespace qtype {
+
+X11Connection::X11Connection(const char* displayName) {
+    display_ = XOpenDisplay(displayName);
+    if (!display_) return;
+
+    int eventBase, errorBase, major, minor;
+    if (!XTestQueryExtension(display_, &eventBase, &errorBase, &major, &minor)) {
+        XCloseDisplay(display_);
+        display_ = nullptr;
+        return;
+    }
+    loadKeyboardMapping();
+}
+
+X11Connection::~X11Connection() {
+    if (display_) XCloseDisplay(display_);
+}
+
+// One XGetKeyboardMapping request for the whole table, instead of resolving
+// every keystroke with XKeysymToKeycode
+void X11Connection::loadKeyboardMapping() {
+    asciiKeys_.fill(Key());
+    shiftKey_ = returnKey_ = backspaceKey_ = 0;
+
+    int minKeycode = 0, maxKeycode = 0, symsPerKeycode = 0;
+    XDisplayKeycodes(display_, &minKeycode, &maxKeycode);
+    int count = maxKeycode - minKeycode + 1;
+    KeySym* syms = XGetKeyboardMapping(display_, static_cast<KeyCode>(minKeycode), count, &symsPerKeycode);
+    if (!syms) return;
+
+    auto assign = [this](KeySym sym, KeyCode keycode, bool shift) {
+        if (sym == XK_Tab) sym = '\t';
+        else if (sym == XK_Return) sym = '\r';
+        if (sym >= asciiKeys_.size()) return;
+
+        // Keep the first unshifted binding; a shifted one only fills a gap
+        Key& entry = asciiKeys_[sym];
+        if (entry.keycode == 0 || (entry.shift && !shift)) {
+            entry.keycode = keycode;
+            entry.shift = shift;
+        }
+    };
+
+    for (int i = 0; i < count; ++i) {
+        KeyCode keycode = static_cast<KeyCode>(minKeycode + i);
+        KeySym base = syms[i * symsPerKeycode];
+        KeySym shifted = symsPerKeycode > 1 ? syms[i * symsPerKeycode + 1] : NoSymbol;
+        if (base == NoSymbol) continue;
+
+        // A lone alphabetic keysym stands for both cases
+        if (shifted == NoSymbol) {
+            KeySym lower, upper;
+            XConvertCase(base, &lower, &upper);
+            base = lower;
+            if (upper != lower) shifted = upper;
+        }
+
+        if (base == XK_Shift_L && !shiftKey_) shiftKey_ = keycode;
+        if (base == XK_Return && !returnKey_) returnKey_ = keycode;
+        if (base == XK_BackSpace && !backspaceKey_) backspaceKey_ = keycode;
+
+        assign(base, keycode, false);
+        if (shifted != NoSymbol) assign(shifted, keycode, true);
+    }
+    XFree(syms);
+
+    // Shift_L is nearly always first on its key, but not on every layout.
+    // With no Shift at all, shifted characters can't be typed.
+    if (!shiftKey_) shiftKey_ = XKeysymToKeycode(display_, XK_Shift_L);
+    if (!shiftKey_) {
+        for (Key& key : asciiKeys_) {
+            if (key.shift) key = Key();
+        }
+    }
+}
+
+// MappingNotify is delivered to every client, so layout switches arrive
+// without polling the server
+void X11Connection::refreshMapping() {
+    while (XEventsQueued(display_, QueuedAfterReading) > 0) {
+        XEvent event;
+        XNextEvent(display_, &event);
+        if (event.type != MappingNotify) continue;
+
+        XRefreshKeyboardMapping(&event.xmapping);
+        if (event.xmapping.request == MappingKeyboard) {
+            loadKeyboardMapping();
+        }
+    }
+}
+
+void X11Connection::fakeKey(uint8_t keycode, bool down, unsigned long delayMs) {
+    XTestFakeKeyEvent(display_, keycode, down ? True : False, delayMs);
+}
+
+void X11Connection::fakeMotion(int deltaX, int deltaY) {
+    XTestFakeRelativeMotionEvent(display_, deltaX, deltaY, CurrentTime);
+}
+
+void X11Connection::fakeButton(unsigned int button, bool down) {
+    XTestFakeButtonEvent(display_, button, down ? True : False, CurrentTime);
+}
+
+void X11Connection::flush() {
+    XFlush(display_);
+}
+
+void X11MouseSimulator::moveRelative(int deltaX, int deltaY) {
+    if (!isConnected()) return;
+    connection_.fakeMotion(deltaX, deltaY);
+    connection_.flush();
+}
+
+// Buttons 4 and 5 are the wheel's up and down
+void X11MouseSimulator::scroll(int amount) {
+    if (!isConnected()) return;
+    unsigned int button = amount > 0 ? 5 : 4;
+    for (int i = 0; i < std::abs(amount); i++) {
+        connection_.fakeButton(button, true);
+        connection_.fakeButton(button, false);
+    }
+    connection_.flush();
+}
+
+} // namespace qtype
+
+#endif // QTYPE_HAVE_XTEST
@@ -0,0 +1,164 @@
+// x11_input.h - Keyboard and mouse through XTest on an X11 session
+//
+// Keeps one display connection per simulator and the keyboard mapping cached
+// per ASCII character, so a keystroke is a few requests on an open socket
+// rather than a process. Built when the X11 and XTest development files are
+// found (QTYPE_HAVE_XTEST); Xlib stays out of this header so it can sit next
+// to Qt, whose names clash with Xlib's macros.
+#ifndef X11_INPUT_H
+#define X11_INPUT_H
+
+#include "typing_core.h"
+
+#ifdef QTYPE_HAVE_XTEST
+
+struct _XDisplay;
+
+namespace qtype {
+
+// ============================================================================
+// Display Connection
+// ============================================================================
+
+class X11Connection {
+public:
+    struct Key {
+        uint8_t keycode = 0;    // 0: no key produces the character
+        bool shift = false;
+    };
+
+    // nullptr opens $DISPLAY
+    explicit X11Connection(const char* displayName = nullptr);
+    ~X11Connection();
+
+    X11Connection(const X11Connection&) = delete;
+    X11Connection& operator=(const X11Connection&) = delete;
+
+    // Open, and the server has XTest
+    bool isOpen() const { return display_ != nullptr; }
+
+    // Rereads the mapping if the layout changed since the last call; only
+    // looks at events that have already arrived
+    void refreshMapping();
+
+    Key keyFor(char32_t c) const { return c < asciiKeys_.size() ? asciiKeys_[c] : Key(); }
+    uint8_t shiftKey() const { return shiftKey_; }    // 0: none, keyFor() has no shifted keys
+    uint8_t returnKey() const { return returnKey_; }
+    uint8_t backspaceKey() const { return backspaceKey_; }
+
+    // Queued until flush(); the server waits delayMs before playing each one
+    void fakeKey(uint8_t keycode, bool down, unsigned long delayMs);
+    void fakeMotion(int deltaX, int deltaY);
+    void fakeButton(unsigned int button, bool down);
+    void flush();
+
+private:
+    _XDisplay* display_ = nullptr;
+    std::array<Key, 128> asciiKeys_{};  // Indexed by ASCII code
+    uint8_t shiftKey_ = 0;
+    uint8_t returnKey_ = 0;
+    uint8_t backspaceKey_ = 0;
+
+    void loadKeyboardMapping();
+};
+
+// ============================================================================
+// Simulators
+// ============================================================================
+
+// Types on the keys of the server's current layout. Each character goes out
+// as one batch whose hold times ride in the XTest delay fields, so the server
+// spaces the events while we wait out the same total.
+template<typename CharT, typename Traits = CharTraits<CharT>>
+class X11KeyboardSimulator : public IKeyboardSimulator<CharT, Traits> {
+public:
+    explicit X11KeyboardSimulator(const char* displayName = nullptr)
+        : connection_(displayName)
+    {}
+
+    bool isConnected() const { return connection_.isOpen(); }
+
+    // Waits run on this clock; a cancelled token cuts them short
+    void setClock(IClock* clock) { clock_ = clock ? clock : &systemClock(); }
+    void setCancellationToken(CancellationToken* token) { cancel_ = token; }
+
+    void typeCharacter(CharT c, int holdTimeMs) override {
+        if (!isConnected()) return;
+        connection_.refreshMapping();
+
+        char32_t code = Traits::code(c);
+        if (code == '\n') {
+            // Shift+Enter, so chat boxes insert a line instead of sending;
+            // plain Enter on a layout without Shift
+            uint8_t shift = connection_.shiftKey();
+            if (!connection_.returnKey()) return;
+            if (shift) connection_.fakeKey(shift, true, 0);
+            connection_.fakeKey(connection_.returnKey(), true, 10);
+            connection_.fakeKey(connection_.returnKey(), false, holdTimeMs);
+            if (shift) connection_.fakeKey(shift, false, 10);
+            connection_.flush();
+            clock_->waitForMs(20 + holdTimeMs, cancel_);
+            return;
+        }
+
+        X11Connection::Key key = connection_.keyFor(code);
+        if (key.keycode == 0) return;
+
+        int shiftDelayMs = key.shift ? 5 : 0;
+        if (key.shift) connection_.fakeKey(connection_.shiftKey(), true, 0);
+        connection_.fakeKey(key.keycode, true, shiftDelayMs);
+        connection_.fakeKey(key.keycode, false, holdTimeMs);
+        if (key.shift) connection_.fakeKey(connection_.shiftKey(), false, shiftDelayMs);
+        connection_.flush();
+        clock_->waitForMs(2 * shiftDelayMs + holdTimeMs, cancel_);
+    }
+
+    void pressBackspace() override {
+        if (!isConnected()) return;
+        connection_.refreshMapping();
+        if (!connection_.backspaceKey()) return;
+
+        connection_.fakeKey(connection_.backspaceKey(), true, 0);
+        connection_.fakeKey(connection_.backspaceKey(), false, TypingConstants::BACKSPACE_HOLD_MS);
+        connection_.flush();
+        clock_->waitForMs(TypingConstants::BACKSPACE_HOLD_MS, cancel_);
+    }
+
+    void releaseAllKeys() override {
+        if (!isConnected() || !connection_.shiftKey()) return;
+        connection_.fakeKey(connection_.shiftKey(), false, 0);
+        connection_.flush();
+    }
+
+    bool canType(CharT c) const override {
+        char32_t code = Traits::code(c);
+        if (code == '\n') return connection_.returnKey() != 0;
+        return connection_.keyFor(code).keycode != 0;
+    }
+
+private:
+    X11Connection connection_;
+    IClock* clock_ = &systemClock();
+    CancellationToken* cancel_ = nullptr;
+};
+
+class X11MouseSimulator : public IMouseSimulator {
+public:
+    explicit X11MouseSimulator(const char* displayName = nullptr)
+        : connection_(displayName)
+    {}
+
+    bool isConnected() const { return connection_.isOpen(); }
+
+    void moveRelative(int deltaX, int deltaY) override;
+    void scroll(int amount) override;
+
+private:
+    X11Connection connection_;
+};
+
+} // namespace qtype
+
+#endif // QTYPE_HAVE_XTEST
+
+#endif // X11_INPUT_H
@@ -0,0 +1,132 @@
+// ydotool_socket.cpp - Datagram connection to ydotoold
+#include "ydotool_socket.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <linux/input.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace qtype {
+
+std::string YdotoolSocket::defaultPath() {
+    if (const char* path = std::getenv("YDOTOOL_SOCKET")) {
+        if (*path) return path;
+    }
+    // Packaged services often run the daemon per user
+    if (const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR")) {
+        std::string path = std::string(runtimeDir) + "/.ydotool_socket";
+        if (access(path.c_str(), W_OK) == 0) return path;
+    }
+    return "/tmp/.ydotool_socket";
+}
+
+bool YdotoolSocket::connect(const std::string& path) {
+    disconnect();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+void YdotoolSocket::disconnect() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    queue_.clear();
+}
+
+void YdotoolSocket::key(uint16_t code, bool down) {
+    push(EV_KEY, code, down ? 1 : 0);
+    sync();
+}
+
+void YdotoolSocket::moveRelative(int deltaX, int deltaY) {
+    if (deltaX) push(EV_REL, REL_X, deltaX);
+    if (deltaY) push(EV_REL, REL_Y, deltaY);
+    sync();
+}
+
+void YdotoolSocket::wheel(int notches) {
+    push(EV_REL, REL_WHEEL, notches);
+    sync();
+}
+
+void YdotoolSocket::sync() {
+    push(EV_SYN, SYN_REPORT, 0);
+}
+
+bool YdotoolSocket::flush() {
+    if (queue_.empty()) return isConnected();
+    if (!isConnected()) {
+        queue_.clear();
+        return false;
+    }
+
+    // The daemon reads one input_event per datagram; the timestamps are
+    // its to fill in. Batches live on the stack, so a flush doesn't allocate.
+    constexpr size_t BATCH = 16;
+    input_event events[BATCH];
+    iovec iov[BATCH];
+    mmsghdr messages[BATCH];
+
+    for (size_t done = 0; done < queue_.size();) {
+        size_t count = std::min(BATCH, queue_.size() - done);
+        for (size_t i = 0; i < count; i++) {
+            const Event& event = queue_[done + i];
+            events[i] = input_event();
+            events[i].type = event.type;
+            events[i].code = event.code;
+            events[i].value = event.value;
+            iov[i].iov_base = &events[i];
+            iov[i].iov_len = sizeof(input_event);
+            messages[i] = mmsghdr();
+            messages[i].msg_hdr.msg_iov = &iov[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        size_t sent = 0;
+        while (sent < count) {
+            int n = sendmmsg(fd_, messages + sent, static_cast<unsigned>(count - sent), 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                disconnect();
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        done += count;
+    }
+    queue_.clear();
+    return true;
+}
+
+void YdotoolMouseSimulator::moveRelative(int deltaX, int deltaY) {
+    socket_.moveRelative(deltaX, deltaY);
+    socket_.flush();
+}
+
+void YdotoolMouseSimulator::scroll(int amount) {
+    socket_.wheel(-amount);
+    socket_.flush();
+}
+
+} // namespace qtype
+
+#endif // __linux__
@@ -0,0 +1,158 @@
+// ydotool_socket.h - Keyboard and mouse through a running ydotoold
+//
+// ydotoold owns /dev/uinput and replays raw input events it reads from a Unix
+// datagram socket, one event per datagram. Writing them there ourselves saves
+// the ydotool process each event used to cost, and works on hosts where we
+// may not open /dev/uinput. Linux only.
+#ifndef YDOTOOL_SOCKET_H
+#define YDOTOOL_SOCKET_H
+
+#include "typing_core.h"
+
+#ifdef __linux__
+
+namespace qtype {
+
+// ============================================================================
+// Daemon Connection
+// ============================================================================
+
+// Events are queued and go out in one sendmmsg() per flush
+class YdotoolSocket {
+public:
+    YdotoolSocket() = default;
+    ~YdotoolSocket() { disconnect(); }
+
+    YdotoolSocket(const YdotoolSocket&) = delete;
+    YdotoolSocket& operator=(const YdotoolSocket&) = delete;
+
+    // $YDOTOOL_SOCKET if set, else where ydotoold puts it by default
+    static std::string defaultPath();
+
+    bool connect(const std::string& path);
+    void disconnect();
+    bool isConnected() const { return fd_ >= 0; }
+
+    // Each is followed by a sync report, as ydotool sends them
+    void key(uint16_t code, bool down);
+    void moveRelative(int deltaX, int deltaY);
+    void wheel(int notches);        // Positive = up, as the wheel axis counts
+
+    // Sends the queue; false if the daemon has gone away, which disconnects
+    bool flush();
+
+    size_t pending() const { return queue_.size(); }
+
+private:
+    struct Event {
+        uint16_t type;
+        uint16_t code;
+        int32_t value;
+    };
+
+    int fd_ = -1;
+    std::vector<Event> queue_;
+
+    void push(uint16_t type, uint16_t code, int32_t value) { queue_.push_back({type, code, value}); }
+    void sync();
+};
+
+// ============================================================================
+// Simulators
+// ============================================================================
+
+// Presses the layout's keys; characters the layout has no key for are left
+// to the engine to skip. The key-up of one character is held back until the
+// next key-down or flush, so a keystroke costs one send per press.
+template<typename CharT, typename Traits = CharTraits<CharT>>
+class YdotoolKeyboardSimulator : public IKeyboardSimulator<CharT, Traits> {
+public:
+    explicit YdotoolKeyboardSimulator(const std::string& socketPath = YdotoolSocket::defaultPath(),
+                                      KeyboardLayoutType layout = KeyboardLayoutType::US_QWERTY)
+        : keys_(&keyStrokes(layout))
+    {
+        socket_.connect(socketPath);
+    }
+
+    bool isConnected() const { return socket_.isConnected(); }
+
+    // Must match the layout the desktop uses
+    void setLayout(KeyboardLayoutType layout) { keys_ = &keyStrokes(layout); }
+
+    // Holds run on this clock; a cancelled token cuts them short
+    void setClock(IClock* clock) { clock_ = clock ? clock : &systemClock(); }
+    void setCancellationToken(CancellationToken* token) { cancel_ = token; }
+
+    void typeCharacter(CharT c, int holdTimeMs) override {
+        char32_t code = Traits::code(c);
+        if (code == '\n') {
+            // Shift+Enter, so chat boxes insert a line instead of sending
+            press(KeyStroke{Scancodes::ENTER, true, false}, holdTimeMs);
+            return;
+        }
+
+        if (code >= 128 || !(*keys_)[code].isTypable()) return;
+        press((*keys_)[code], holdTimeMs);
+    }
+
+    void pressBackspace() override {
+        press(KeyStroke{Scancodes::BACKSPACE, false, false}, TypingConstants::BACKSPACE_HOLD_MS);
+    }
+
+    void releaseAllKeys() override {
+        for (uint16_t code : {Scancodes::LEFT_SHIFT, Scancodes::RIGHT_ALT, Scancodes::ENTER}) {
+            socket_.key(code, false);
+        }
+        socket_.flush();
+    }
+
+    void flush() override {
+        socket_.flush();
+    }
+
+    bool canType(CharT c) const override {
+        char32_t code = Traits::code(c);
+        return code < 128 && (*keys_)[code].isTypable();
+    }
+
+private:
+    YdotoolSocket socket_;
+    const KeyStrokeTable* keys_;
+    IClock* clock_ = &systemClock();
+    CancellationToken* cancel_ = nullptr;
+
+    // Modifiers go down before the key and up after it
+    void press(const KeyStroke& key, int holdTimeMs) {
+        if (key.needsShift) socket_.key(Scancodes::LEFT_SHIFT, true);
+        if (key.needsAltGr) socket_.key(Scancodes::RIGHT_ALT, true);
+        socket_.key(key.scancode, true);
+        socket_.flush();
+
+        clock_->waitForMs(holdTimeMs, cancel_);
+
+        socket_.key(key.scancode, false);
+        if (key.needsAltGr) socket_.key(Scancodes::RIGHT_ALT, false);
+        if (key.needsShift) socket_.key(Scancodes::LEFT_SHIFT, false);
+    }
+};
+
+class YdotoolMouseSimulator : public IMouseSimulator {
+public:
+    explicit YdotoolMouseSimulator(const std::string& socketPath = YdotoolSocket::defaultPath()) {
+        socket_.connect(socketPath);
+    }
+
+    bool isConnected() const { return socket_.isConnected(); }
+
+    void moveRelative(int deltaX, int deltaY) override;
+    void scroll(int amount) override;
+
+private:
+    YdotoolSocket socket_;
+};
+
+} // namespace qtype
+
+#endif // __linux__
+
+#endif // YDOTOOL_SOCKET_H
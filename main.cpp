@@ -16,6 +16,10 @@
 #include <QCheckBox>
 #include <QDateTime>
 #include <QRegularExpression>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
 
 class AutoTyperWindow : public QMainWindow {
     Q_OBJECT
@@ -26,8 +30,39 @@ public:
         
         // Create platform-specific simulator
 #ifdef Q_OS_LINUX
-        simulator_ = new LinuxKeyboardSimulator();
-        mouseSimulator_ = new LinuxMouseSimulator();
+#ifdef QTYPE_HAVE_XTEST
+        // X11 session: XTest over one open display connection
+        if (qEnvironmentVariableIsSet("DISPLAY") && !qEnvironmentVariableIsSet("WAYLAND_DISPLAY")) {
+            X11KeyboardSimulator *x11Keyboard = new X11KeyboardSimulator();
+            if (x11Keyboard->isConnected()) {
+                x11Keyboard->setCancellationToken(&cancel_);
+                simulator_ = x11Keyboard;
+                mouseSimulator_ = new X11MouseSimulator();
+            } else {
+                delete x11Keyboard;
+            }
+        }
+#endif
+        // Otherwise straight to ydotoold's socket when we may, else a ydotool
+        // process per event
+        if (!simulator_) {
+            YdotoolKeyboardSimulator *socketKeyboard = new YdotoolKeyboardSimulator();
+            if (socketKeyboard->isConnected()) {
+                socketKeyboard->setCancellationToken(&cancel_);
+                simulator_ = socketKeyboard;
+            } else {
+                delete socketKeyboard;
+                simulator_ = new LinuxKeyboardSimulator();
+            }
+            
+            YdotoolMouseSimulator *socketMouse = new YdotoolMouseSimulator();
+            if (socketMouse->isConnected()) {
+                mouseSimulator_ = socketMouse;
+            } else {
+                delete socketMouse;
+                mouseSimulator_ = new LinuxMouseSimulator();
+            }
+        }
 #elif defined(Q_OS_MAC)
         simulator_ = new MacKeyboardSimulator();
         mouseSimulator_ = new MacMouseSimulator();
@@ -36,19 +71,19 @@ public:
         mouseSimulator_ = nullptr;
 #endif
         
-        typingTimer_ = new QTimer(this);
-        connect(typingTimer_, &QTimer::timeout, this, &AutoTyperWindow::typeNextChunk);
+        // All timers share one wheel; a single precise QTimer wakes it
+        wakeup_ = new QTimer(this);
+        wakeup_->setSingleShot(true);
+        wakeup_->setTimerType(Qt::PreciseTimer);
+        connect(wakeup_, &QTimer::timeout, this, &AutoTyperWindow::runTimers);
         
-        countdownTimer_ = new QTimer(this);
-        connect(countdownTimer_, &QTimer::timeout, this, &AutoTyperWindow::updateCountdown);
-        
-        watchdog_ = new QTimer(this);
-        connect(watchdog_, &QTimer::timeout, this, &AutoTyperWindow::watchdogCheck);
+        typingTimer_.callback = [this] { typeNextChunk(); };
+        countdownTimer_.callback = [this] { updateCountdown(); };
+        watchdog_.callback = [this] { watchdogCheck(); };
+        idleScrollTimer_.callback = [this] { checkIdleScroll(); };
         
         // Idle scroll timer - checks every second if we should scroll
-        idleScrollTimer_ = new QTimer(this);
-        connect(idleScrollTimer_, &QTimer::timeout, this, &AutoTyperWindow::checkIdleScroll);
-        idleScrollTimer_->start(1000);  // Check every second
+        scheduleTimer(idleScrollTimer_, 1000);
         
         lastActivityTime_ = QDateTime::currentMSecsSinceEpoch();
         
@@ -105,13 +140,31 @@ private slots:
         imperfections.correctionProbability = autoCorrectProbSpin_->value();
         
         KeyboardLayoutType layout = getSelectedLayout();
+#ifdef Q_OS_LINUX
+        // XTest follows the server's own layout
+        if (auto *socketKeyboard = dynamic_cast<YdotoolKeyboardSimulator *>(simulator_)) {
+            socketKeyboard->setLayout(layout);
+        } else if (auto *processKeyboard = dynamic_cast<LinuxKeyboardSimulator *>(simulator_)) {
+            processKeyboard->setLayout(layout);
+        }
+#endif
         
         delete engine_;
         engine_ = new TypingEngine(simulator_, mouseSimulator_, profile, delays, imperfections, layout);
-        engine_->setText(text);
         engine_->setMouseMovementEnabled(mouseMovementCheck_->isChecked());
+        cancel_.reset();
+        engine_->setCancellationToken(&cancel_);
         // Scroll is now idle-based, not typing-based
         
+        // Continue a stopped run of the same text instead of starting over
+        SessionState session;
+        bool resumed = resumeCheck_->isChecked() && loadSession(session) &&
+                       engine_->resume(text, session);
+        if (!resumed) {
+            engine_->setText(text);
+        }
+        lastCheckpointTime_ = QDateTime::currentMSecsSinceEpoch();
+        
         // Hide warning from previous session
         warningLabel_->setVisible(false);
         
@@ -121,17 +174,20 @@ private slots:
         startButton_->setEnabled(false);
         stopButton_->setEnabled(true);
         
-        statusLabel_->setText("Get ready... 5");
-        countdownTimer_->start(1000);
+        statusLabel_->setText(resumed ? QString("Get ready... 5 (resuming at %1%)").arg(session.progressPercent())
+                                      : QString("Get ready... 5"));
+        timers_.resetSlack();
+        scheduleTimer(countdownTimer_, 1000);
         
         lastActionTime_ = QDateTime::currentMSecsSinceEpoch();
-        watchdog_->start(1000);
+        scheduleTimer(watchdog_, 1000);
     }
     
     void stopTyping() {
-        typingTimer_->stop();
-        countdownTimer_->stop();
-        watchdog_->stop();
+        cancel_.cancel();
+        stopTimer(typingTimer_);
+        stopTimer(countdownTimer_);
+        stopTimer(watchdog_);
         isTyping_ = false;
         
         if (simulator_) {
@@ -142,15 +198,26 @@ private slots:
         stopButton_->setEnabled(false);
         
         bool finished = engine_ && !engine_->hasMoreToType();
+        if (finished) {
+            QFile::remove(sessionPath());
+        } else {
+            saveSession();
+        }
         statusLabel_->setText(finished ? "Completed!" : "Stopped");
+        
+        const EventTimers::Slack &slack = timers_.slack();
+        statusLabel_->setToolTip(QString("Timer slack: %1 ms average, %2 ms max over %3 wakeups")
+                                 .arg(slack.averageMs(), 0, 'f', 2)
+                                 .arg(slack.maxUs / 1000.0, 0, 'f', 2)
+                                 .arg(slack.wakeups));
     }
     
     void updateCountdown() {
         countdownValue_--;
         if (countdownValue_ > 0) {
             statusLabel_->setText(QString("Get ready... %1").arg(countdownValue_));
+            scheduleTimer(countdownTimer_, 1000);
         } else {
-            countdownTimer_->stop();
             statusLabel_->setText("Processing...");
             typeNextChunk();
         }
@@ -178,8 +245,13 @@ private slots:
             warningLabel_->setVisible(true);
         }
         
+        if (lastActionTime_ - lastCheckpointTime_ >= TypingConstants::CHECKPOINT_INTERVAL_MS) {
+            saveSession();
+            lastCheckpointTime_ = lastActionTime_;
+        }
+        
         if (engine_->hasMoreToType()) {
-            typingTimer_->start(delayMs);
+            scheduleTimer(typingTimer_, delayMs);
         } else {
             stopTyping();
         }
@@ -187,6 +259,7 @@ private slots:
     
     void watchdogCheck() {
         if (!isTyping_) return;
+        scheduleTimer(watchdog_, 1000);
         
         qint64 now = QDateTime::currentMSecsSinceEpoch();
         if (now - lastActionTime_ > 10000) {
@@ -199,6 +272,7 @@ private slots:
     }
     
     void checkIdleScroll() {
+        scheduleTimer(idleScrollTimer_, 1000);
         if (!scrollCheck_->isChecked()) return;
         if (!mouseSimulator_) return;
         
@@ -265,6 +339,54 @@ private slots:
     }
 
 private:
+    void runTimers() {
+        timers_.run();
+        armWakeup();
+    }
+    
+    void scheduleTimer(TimingWheel::Timer &timer, int delayMs) {
+        timers_.start(timer, delayMs);
+        armWakeup();
+    }
+    
+    void stopTimer(TimingWheel::Timer &timer) {
+        timers_.stop(timer);
+        armWakeup();
+    }
+    
+    // Sleeps the QTimer until the wheel's next due timer
+    void armWakeup() {
+        int ms = timers_.msUntilNextRun();
+        if (ms < 0) {
+            wakeup_->stop();
+        } else {
+            wakeup_->start(ms);
+        }
+    }
+    
+    QString sessionPath() const {
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+        return dir + "/session.qts";
+    }
+    
+    void saveSession() {
+        if (!engine_) return;
+        std::string data = engine_->checkpoint().serialize();
+        QSaveFile file(sessionPath());
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(data.data(), static_cast<qint64>(data.size()));
+            file.commit();
+        }
+    }
+    
+    bool loadSession(SessionState &session) const {
+        QFile file(sessionPath());
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        QByteArray data = file.readAll();
+        return SessionState::deserialize(data.toStdString(), session);
+    }
+    
     void setupUI() {
         setWindowTitle("qtype - Text Input Practice & Analysis");
         setMinimumSize(780, 520);
@@ -397,11 +519,18 @@ private:
         scrollCheck_->setToolTip("Scrolls automatically after 30 seconds of keyboard/mouse inactivity");
         scrollLayout->addWidget(scrollCheck_);
         
+        QHBoxLayout *resumeLayout = new QHBoxLayout();
+        resumeCheck_ = new QCheckBox("Resume where the last run stopped", this);
+        resumeCheck_->setChecked(true);
+        resumeCheck_->setToolTip("Continues the same text from its last checkpoint instead of starting over");
+        resumeLayout->addWidget(resumeCheck_);
+        
         imperfLayout->addLayout(typoLayout);
         imperfLayout->addLayout(doubleLayout);
         imperfLayout->addLayout(autoLayout);
         imperfLayout->addLayout(mouseLayout);
         imperfLayout->addLayout(scrollLayout);
+        imperfLayout->addLayout(resumeLayout);
         
         topLayout->addWidget(imperfGroup);
         
@@ -503,9 +632,9 @@ private:
     
     QCheckBox *mouseMovementCheck_ = nullptr;
     QCheckBox *scrollCheck_ = nullptr;
+    QCheckBox *resumeCheck_ = nullptr;
     
     // Idle scroll tracking
-    QTimer *idleScrollTimer_ = nullptr;
     qint64 lastActivityTime_ = 0;
     
     // Stats
@@ -515,16 +644,21 @@ private:
     IKeyboardSimulator *simulator_ = nullptr;
     IMouseSimulator *mouseSimulator_ = nullptr;
     TypingEngine *engine_ = nullptr;
+    CancellationToken cancel_;      // Same stop path as the console frontends
     
     // Timers
-    QTimer *typingTimer_ = nullptr;
-    QTimer *countdownTimer_ = nullptr;
-    QTimer *watchdog_ = nullptr;
+    TimingWheel::Timer typingTimer_;
+    TimingWheel::Timer countdownTimer_;
+    TimingWheel::Timer watchdog_;
+    TimingWheel::Timer idleScrollTimer_;
+    EventTimers timers_;                // After the timers: unlinks them when it goes
+    QTimer *wakeup_ = nullptr;
     
     // State
     int countdownValue_ = 0;
     bool isTyping_ = false;
     qint64 lastActionTime_ = 0;
+    qint64 lastCheckpointTime_ = 0;
 };
 
 int main(int argc, char *argv[]) {
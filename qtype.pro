@@ -4,7 +4,7 @@
 
 TEMPLATE = app
 TARGET = qtype
-INCLUDEPATH += .
+INCLUDEPATH += . core
 
 # You can make your code fail to compile if you use deprecated APIs.
 # In order to do so, uncomment the following line.
@@ -14,5 +14,14 @@ INCLUDEPATH += .
 #DEFINES += QT_DISABLE_DEPRECATED_UP_TO=0x060000 # disables all APIs deprecated in Qt 6.0.0 and earlier
 
 # Input
-SOURCES += main.cpp
+HEADERS += typing_engine.h core/typing_core.h core/ydotool_socket.h
+SOURCES += main.cpp core/typing_core.cpp core/ydotool_socket.cpp
 QT += widgets
+
+# In-process XTest backend for X11 sessions
+unix:!macx {
+    HEADERS += core/x11_input.h
+    SOURCES += core/x11_input.cpp
+    DEFINES += QTYPE_HAVE_XTEST
+    LIBS += -lX11 -lXtst
+}
@@ -1,146 +1,193 @@
 // qtype_console.cpp - Windows Console Application (No Qt Required)
-// Compile: cl qtype_console.cpp /EHsc /std:c++17
-// Or with g++: g++ qtype_console.cpp -o qtype.exe -std=c++17
+// Compile: cl qtype_win.cpp core\typing_core.cpp /Icore /EHsc /std:c++17
+// Or with g++: g++ qtype_win.cpp core/typing_core.cpp -Icore -o qtype.exe -std=c++17
 
 #include <windows.h>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
-#include <random>
-#include <cmath>
-#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <thread>
-#include <chrono>
+
+#include "typing_core.h"
 
 // ============================================================================
-// Random Number Generator
+// High-Resolution Clock
 // ============================================================================
 
-class RandomGenerator {
-public:
-    static double gamma(double shape, double scale) {
-        if (shape < 1.0) {
-            return gamma(1.0 + shape, scale) * std::pow(uniform(), 1.0 / shape);
-        }
-
-        double d = shape - 1.0 / 3.0;
-        double c = 1.0 / std::sqrt(9.0 * d);
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
-        while (true) {
-            double x, v;
-            do {
-                x = normal(0.0, 1.0);
-                v = 1.0 + c * x;
-            } while (v <= 0.0);
+// Sleep() rounds every wait up to the 15.6 ms scheduler tick. A
+// high-resolution waitable timer (Windows 10 1803+) wakes within about a
+// millisecond; older systems fall back to a normal waitable timer. Waits on
+// the watched cancellation token also wake on its event.
+class WaitableTimerClock : public qtype::IClock {
+public:
+    WaitableTimerClock() {
+        cancelEvent_ = CreateEventW(NULL, TRUE, FALSE, NULL);
 
-            v = v * v * v;
-            double u = uniform();
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        frequency_ = frequency.QuadPart;
 
-            if (u < 1.0 - 0.0331 * x * x * x * x) {
-                return d * v * scale;
-            }
-            if (std::log(u) < 0.5 * x * x + d * (1.0 - v + std::log(v))) {
-                return d * v * scale;
-            }
+        timer_ = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                        TIMER_ALL_ACCESS);
+        if (!timer_) {
+            timer_ = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
         }
     }
 
-    static double normal(double mean, double stddev) {
-        static bool hasSpare = false;
-        static double spare;
+    ~WaitableTimerClock() override {
+        if (watched_) watched_->setNotifier(nullptr);
+        if (timer_) CloseHandle(timer_);
+        if (cancelEvent_) CloseHandle(cancelEvent_);
+    }
 
-        if (hasSpare) {
-            hasSpare = false;
-            return mean + stddev * spare;
-        }
+    WaitableTimerClock(const WaitableTimerClock&) = delete;
+    WaitableTimerClock& operator=(const WaitableTimerClock&) = delete;
 
-        double u, v, s;
-        do {
-            u = uniform() * 2.0 - 1.0;
-            v = uniform() * 2.0 - 1.0;
-            s = u * u + v * v;
-        } while (s >= 1.0 || s == 0.0);
+    int64_t nowUs() const override {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        int64_t ticks = counter.QuadPart;
+        return ticks / frequency_ * 1000000 + ticks % frequency_ * 1000000 / frequency_;
+    }
 
-        s = std::sqrt(-2.0 * std::log(s) / s);
-        spare = v * s;
-        hasSpare = true;
+    void sleepUntilUs(int64_t deadlineUs) override {
+        int64_t remainingUs = deadlineUs - nowUs();
+        if (remainingUs <= 0) return;
 
-        return mean + stddev * u * s;
+        LARGE_INTEGER due;
+        due.QuadPart = -remainingUs * 10;   // Relative, in 100 ns units
+        if (timer_ && SetWaitableTimer(timer_, &due, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(timer_, INFINITE);
+        } else {
+            Sleep(static_cast<DWORD>((remainingUs + 999) / 1000));
+        }
     }
 
-    static int range(int min, int max) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(min, max);
-        return dis(gen);
+    // Mirrors token into the event waitUntilUs() waits on
+    void watch(qtype::CancellationToken& token) {
+        watched_ = &token;
+        HANDLE event = cancelEvent_;
+        token.setNotifier([event](bool cancelled) {
+            if (cancelled) SetEvent(event); else ResetEvent(event);
+        });
+        if (token.isCancelled()) SetEvent(event);
     }
 
-    static double uniform() {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<> dis(0.0, 1.0);
-        return dis(gen);
-    }
-};
+    bool waitUntilUs(int64_t deadlineUs, qtype::CancellationToken& token) override {
+        if (&token != watched_ || !timer_ || !cancelEvent_) {
+            return IClock::waitUntilUs(deadlineUs, token);
+        }
+        if (token.isCancelled()) return false;
 
-// ============================================================================
-// Timing Profile
-// ============================================================================
+        int64_t remainingUs = deadlineUs - nowUs();
+        if (remainingUs <= 0) return true;
+
+        LARGE_INTEGER due;
+        due.QuadPart = -remainingUs * 10;
+        if (!SetWaitableTimer(timer_, &due, 0, NULL, NULL, FALSE)) {
+            return IClock::waitUntilUs(deadlineUs, token);
+        }
 
-struct TimingProfile {
-    double baseSpeedFactor = 1.0;
-    double microStutterProb = 0.1;
-    double burstProb = 0.14;
-    int burstMin = 2;
-    int burstMax = 6;
-    double gammaShape = 2.0;
-    double gammaScale = 1.0;
-    double noiseLevel = 0.15;
-    int minDelayMs = 120;
-    int maxDelayMs = 2000;
-
-    static TimingProfile humanAdvanced() {
-        TimingProfile p;
-        p.baseSpeedFactor = 1.0;
-        p.microStutterProb = 0.1;
-        p.burstProb = 0.14;
-        p.gammaShape = 2.0;
-        p.gammaScale = 1.0;
-        p.noiseLevel = 0.15;
-        return p;
+        HANDLE handles[2] = { cancelEvent_, timer_ };
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+            CancelWaitableTimer(timer_);
+            return false;
+        }
+        return !token.isCancelled();
     }
+
+private:
+    HANDLE timer_ = NULL;
+    HANDLE cancelEvent_ = NULL;         // Manual-reset, set while cancelled
+    qtype::CancellationToken* watched_ = nullptr;
+    int64_t frequency_ = 1;
 };
 
 // ============================================================================
 // Keyboard Simulator
 // ============================================================================
 
-class KeyboardSimulator {
+// Events go out through one SendInput call per batch. The key-up of one
+// character is held back and sent together with the key-down of the next,
+// so a chunk costs one call per character plus a final flush.
+//
+// Characters go out as Unicode unless a layout is given for scancodes:
+// then ASCII is pressed on the layout's keys, for remote desktops and VMs
+// that drop Unicode input. The layout must match the target's.
+class KeyboardSimulator : public qtype::IKeyboardSimulator<wchar_t> {
 public:
-    void typeCharacter(wchar_t c, int holdTimeMs) {
+    KeyboardSimulator(qtype::IClock& clock, qtype::CancellationToken& cancel)
+        : clock_(clock)
+        , cancel_(cancel)
+    {}
+
+    void typeCharacter(wchar_t c, int holdTimeMs) override {
         if (c == L'\n') {
-            sendKeyEvent(VK_SHIFT, 0);
-            Sleep(10);
-            sendKeyEvent(VK_RETURN, 0);
-            Sleep(holdTimeMs);
-            sendKeyEvent(VK_RETURN, KEYEVENTF_KEYUP);
-            Sleep(10);
-            sendKeyEvent(VK_SHIFT, KEYEVENTF_KEYUP);
+            // Shift+Enter, so chat boxes insert a line instead of sending
+            queueKey(VK_SHIFT, 0);
+            queueKey(VK_RETURN, 0);
+            send();
+            hold(holdTimeMs);
+            queueKey(VK_RETURN, KEYEVENTF_KEYUP);
+            queueKey(VK_SHIFT, KEYEVENTF_KEYUP);
             return;
         }
 
         if (c == L'\t') {
-            sendKeyEvent(VK_TAB, 0);
-            Sleep(holdTimeMs);
-            sendKeyEvent(VK_TAB, KEYEVENTF_KEYUP);
+            queueKey(VK_TAB, 0);
+            send();
+            hold(holdTimeMs);
+            queueKey(VK_TAB, KEYEVENTF_KEYUP);
+            return;
+        }
+
+        qtype::KeyStroke key = keys_ && c < 128 ? (*keys_)[c] : qtype::KeyStroke();
+        if (key.isTypable()) {
+            if (key.needsShift) queueScancode(qtype::Scancodes::LEFT_SHIFT, 0);
+            if (key.needsAltGr) queueScancode(qtype::Scancodes::RIGHT_ALT_SET1, KEYEVENTF_EXTENDEDKEY);
+            queueScancode(key.scancode, 0);
+            send();
+            hold(holdTimeMs);
+            queueScancode(key.scancode, KEYEVENTF_KEYUP);
+            if (key.needsAltGr) queueScancode(qtype::Scancodes::RIGHT_ALT_SET1, KEYEVENTF_EXTENDEDKEY | KEYEVENTF_KEYUP);
+            if (key.needsShift) queueScancode(qtype::Scancodes::LEFT_SHIFT, KEYEVENTF_KEYUP);
             return;
         }
 
-        sendUnicodeChar(c, holdTimeMs);
+        queueUnicode(c, 0);
+        send();
+        hold(holdTimeMs);
+        queueUnicode(c, KEYEVENTF_KEYUP);
     }
 
-    void releaseAllKeys() {
+    void pressBackspace() override {
+        queueKey(VK_BACK, 0);
+        send();
+        hold(TypingConstants::BACKSPACE_HOLD_MS);
+        queueKey(VK_BACK, KEYEVENTF_KEYUP);
+    }
+
+    void flush() override {
+        send();
+    }
+
+    void useScancodes(qtype::KeyboardLayoutType layout) {
+        keys_ = &qtype::keyStrokes(layout);
+    }
+
+    // KEYEVENTF_UNICODE reaches any character, whatever the active layout
+    bool canType(wchar_t) const override {
+        return true;
+    }
+
+    void releaseAllKeys() override {
         WORD modifiers[] = {
             VK_SHIFT, VK_CONTROL, VK_MENU,
             VK_LSHIFT, VK_RSHIFT,
@@ -150,35 +197,90 @@ public:
         };
 
         for (WORD vk : modifiers) {
-            sendKeyEvent(vk, KEYEVENTF_KEYUP);
+            queueKey(vk, KEYEVENTF_KEYUP);
         }
+        send();
     }
 
 private:
-    void sendKeyEvent(WORD vk, DWORD flags) {
-        INPUT input = {0};
+    qtype::IClock& clock_;
+    qtype::CancellationToken& cancel_;
+    std::vector<INPUT> pending_;
+    const qtype::KeyStrokeTable* keys_ = nullptr;     // Null: Unicode only
+
+    // A stop cuts the hold short; the key-up is still queued and flushed
+    void hold(int ms) {
+        clock_.waitForMs(ms, &cancel_);
+    }
+
+    void queueKey(WORD vk, DWORD flags) {
+        INPUT input = {};
         input.type = INPUT_KEYBOARD;
         input.ki.wVk = vk;
         input.ki.dwFlags = flags;
-        SendInput(1, &input, sizeof(INPUT));
+        pending_.push_back(input);
+    }
+
+    void queueScancode(WORD scancode, DWORD flags) {
+        INPUT input = {};
+        input.type = INPUT_KEYBOARD;
+        input.ki.wScan = scancode;
+        input.ki.dwFlags = KEYEVENTF_SCANCODE | flags;
+        pending_.push_back(input);
+    }
+
+    void queueUnicode(wchar_t ch, DWORD flags) {
+        INPUT input = {};
+        input.type = INPUT_KEYBOARD;
+        input.ki.wVk = 0;
+        input.ki.wScan = ch;
+        input.ki.dwFlags = KEYEVENTF_UNICODE | flags;
+        pending_.push_back(input);
     }
 
-    void sendUnicodeChar(wchar_t ch, int holdTimeMs) {
-        INPUT inputs[2] = {0};
+    void send() {
+        if (pending_.empty()) return;
+        SendInput(static_cast<UINT>(pending_.size()), pending_.data(), sizeof(INPUT));
+        pending_.clear();
+    }
+};
 
-        inputs[0].type = INPUT_KEYBOARD;
-        inputs[0].ki.wVk = 0;
-        inputs[0].ki.wScan = ch;
-        inputs[0].ki.dwFlags = KEYEVENTF_UNICODE;
+// ============================================================================
+// Escape Watcher
+// ============================================================================
 
-        inputs[1].type = INPUT_KEYBOARD;
-        inputs[1].ki.wVk = 0;
-        inputs[1].ki.wScan = ch;
-        inputs[1].ki.dwFlags = KEYEVENTF_UNICODE | KEYEVENTF_KEYUP;
+// Polls ESC on its own thread and cancels the run, so a stop lands in the
+// middle of a hold or delay instead of after it
+class EscapeWatcher {
+public:
+    explicit EscapeWatcher(qtype::CancellationToken& token)
+        : token_(token)
+        , thread_([this] { run(); })
+    {}
 
-        SendInput(1, &inputs[0], sizeof(INPUT));
-        Sleep(holdTimeMs);
-        SendInput(1, &inputs[1], sizeof(INPUT));
+    ~EscapeWatcher() {
+        done_ = true;
+        thread_.join();
+    }
+
+    EscapeWatcher(const EscapeWatcher&) = delete;
+    EscapeWatcher& operator=(const EscapeWatcher&) = delete;
+
+private:
+    static constexpr DWORD POLL_INTERVAL_MS = 10;
+
+    qtype::CancellationToken& token_;
+    std::atomic<bool> done_{false};
+    std::thread thread_;
+
+    void run() {
+        while (!done_ && !token_.isCancelled()) {
+            if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
+                token_.cancel();
+                return;
+            }
+            Sleep(POLL_INTERVAL_MS);
+        }
     }
 };
 
@@ -186,121 +288,102 @@ private:
 // Typing Engine
 // ============================================================================
 
+// Console frontend of the shared core engine: countdown and progress output.
+// All waits run on the high-resolution clock and end early on ESC. Progress
+// is checkpointed to sessionPath so a stopped run continues where it left off.
 class TypingEngine {
 public:
-    TypingEngine(const TimingProfile& profile)
-        : profile_(profile)
-        , rhythmPhase_(RandomGenerator::uniform() * 6.28318530718)
-        , fatigueFactor_(1.0)
-        , burstRemaining_(0)
-        , totalCharsTyped_(0)
-    {}
+    TypingEngine()
+        : simulator_(clock_, cancel_)
+        , pacer_(clock_)
+        , engine_(&simulator_, nullptr, qtype::DelayRange{120, 2000}, noImperfections())
+    {
+        clock_.watch(cancel_);
+        engine_.setClock(&clock_);
+        engine_.setCancellationToken(&cancel_);
+    }
+
+    void useScancodes(qtype::KeyboardLayoutType layout) {
+        simulator_.useScancodes(layout);
+    }
+
+    void typeText(const std::wstring& text, const std::string& sessionPath, bool restart) {
+        cancel_.reset();
+        EscapeWatcher escape(cancel_);
+
+        qtype::SessionState session;
+        bool resumed = !restart && qtype::SessionState::load(sessionPath, session) &&
+                       engine_.resume(text, session);
+        if (resumed) {
+            std::wcout << L"Resuming at " << session.progressPercent() << L"% (--restart to start over)\n";
+        } else {
+            engine_.setText(text);
+        }
 
-    void typeText(const std::wstring& text) {
         std::wcout << L"Starting in 5 seconds... (Switch to target window)\n";
-        for (int i = 5; i > 0; --i) {
+        for (int i = 5; i > 0 && !cancel_.isCancelled(); --i) {
             std::wcout << i << L"...\n";
-            Sleep(1000);
+            clock_.waitForMs(1000, &cancel_);
+        }
+        if (cancel_.isCancelled()) {
+            std::wcout << L"\nStopped by user (ESC pressed)\n";
+            return;
         }
         std::wcout << L"Processing...\n\n";
 
         size_t total = text.length();
-        size_t progress = 0;
+        size_t lastPrinted = engine_.currentPosition();
+        int64_t lastCheckpointUs = clock_.nowUs();
 
-        for (wchar_t c : text) {
-            int holdTime = generateHoldTime(c);
-            simulator_.typeCharacter(c, holdTime);
+        pacer_.reset();
+        while (engine_.hasMoreToType() && !cancel_.isCancelled()) {
+            int delay = engine_.typeNextChunk();
 
-            int delay = calculateDelay(c);
-            Sleep(delay);
-
-            totalCharsTyped_++;
-            progress++;
+            if (clock_.nowUs() - lastCheckpointUs >= TypingConstants::CHECKPOINT_INTERVAL_MS * 1000LL) {
+                engine_.checkpoint().save(sessionPath);
+                lastCheckpointUs = clock_.nowUs();
+            }
 
             // Update progress every 50 chars
-            if (progress % 50 == 0) {
-                int percent = (progress * 100) / total;
+            size_t progress = engine_.currentPosition();
+            if (progress / 50 != lastPrinted / 50) {
+                int percent = static_cast<int>((progress * 100) / total);
                 std::wcout << L"\rProgress: " << percent << L"%";
                 std::wcout.flush();
+                lastPrinted = progress;
             }
 
-            // Check for ESC key to stop
-            if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
-                std::wcout << L"\n\nStopped by user (ESC pressed)\n";
-                simulator_.releaseAllKeys();
-                return;
-            }
+            pacer_.wait(delay, &cancel_);
         }
 
+        if (cancel_.isCancelled()) {
+            engine_.checkpoint().save(sessionPath);
+            std::wcout << L"\n\nStopped by user (ESC pressed), run again to resume\n";
+            simulator_.releaseAllKeys();
+            return;
+        }
+
+        std::remove(sessionPath.c_str());
         std::wcout << L"\rProgress: 100%\n";
         std::wcout << L"\nCompleted!\n";
         simulator_.releaseAllKeys();
     }
 
 private:
-    int calculateDelay(wchar_t c) {
-        double range = profile_.maxDelayMs - profile_.minDelayMs;
-        double gammaValue = RandomGenerator::gamma(profile_.gammaShape, profile_.gammaScale);
-        double normalized = std::min(gammaValue / 6.0, 1.0);
-
-        double delay = profile_.minDelayMs + range * normalized;
-        delay *= rhythmicVariation();
-
-        if (std::iswdigit(c)) delay *= 1.05;
-        if (std::iswspace(c)) delay *= 1.12;
-        if (c == L'\n') delay *= 1.5;
-        if (c == L'.' || c == L'!' || c == L'?') delay *= 1.4;
-
-        if (RandomGenerator::uniform() < profile_.microStutterProb)
-            delay *= 1.3 + RandomGenerator::uniform() * 0.4;
-
-        if (shouldBurst())
-            delay *= 0.65;
-
-        delay *= fatigueFactor_;
-
-        double noise = RandomGenerator::normal(0.0, profile_.noiseLevel);
-        delay *= (1.0 + noise);
-
-        // Update fatigue
-        if (totalCharsTyped_ % 50 == 0) {
-            fatigueFactor_ = 1.0 + 0.25 * std::min(1.0, totalCharsTyped_ / 1000.0);
-        }
-
-        return std::max(15, std::min(int(delay), 8000));
-    }
-
-    int generateHoldTime(wchar_t c) {
-        double hold = RandomGenerator::gamma(2.5, 20.0);
-        if (std::iswupper(c)) hold *= 1.2;
-        hold *= (0.9 + RandomGenerator::uniform() * 0.2);
-        return std::max(40, std::min(int(hold), 180));
-    }
-
-    double rhythmicVariation() {
-        rhythmPhase_ += 0.03;
-        double rhythm = std::sin(rhythmPhase_) * 0.5 + 0.5;
-        return 0.85 + rhythm * 0.3;
-    }
-
-    bool shouldBurst() {
-        if (burstRemaining_ > 0) {
-            burstRemaining_--;
-            return true;
-        }
-        if (RandomGenerator::uniform() < profile_.burstProb) {
-            burstRemaining_ = RandomGenerator::range(profile_.burstMin, profile_.burstMax);
-            return true;
-        }
-        return false;
+    // Rehearsal runs type the file exactly as written
+    static qtype::ImperfectionSettings noImperfections() {
+        qtype::ImperfectionSettings settings;
+        settings.enableTypos = false;
+        settings.enableDoubleKeys = false;
+        return settings;
     }
 
+    qtype::CancellationToken cancel_;
+    WaitableTimerClock clock_;
     KeyboardSimulator simulator_;
-    TimingProfile profile_;
-    double rhythmPhase_;
-    double fatigueFactor_;
-    int burstRemaining_;
-    int totalCharsTyped_;
+    qtype::Pacer pacer_;
+    // The console always types with the humanAdvanced profile
+    qtype::TypingEngine<wchar_t, qtype::CharTraits<wchar_t>, qtype::HumanAdvancedProfile> engine_;
 };
 
 // ============================================================================
@@ -328,6 +411,15 @@ std::wstring readFile(const std::string& filename) {
     return wstr;
 }
 
+bool parseLayout(const std::string& name, qtype::KeyboardLayoutType& layout) {
+    if (name == "us") layout = qtype::KeyboardLayoutType::US_QWERTY;
+    else if (name == "uk") layout = qtype::KeyboardLayoutType::UK_QWERTY;
+    else if (name == "de") layout = qtype::KeyboardLayoutType::GERMAN_QWERTZ;
+    else if (name == "fr") layout = qtype::KeyboardLayoutType::FRENCH_AZERTY;
+    else return false;
+    return true;
+}
+
 void showUsage(const char* progName) {
     std::cout << "qtype - Text input rehearsal and training tool\n\n";
     std::cout << "Usage:\n";
@@ -335,6 +427,9 @@ void showUsage(const char* progName) {
     std::cout << "  " << progName << " --input <input_file>\n\n";
     std::cout << "Options:\n";
     std::cout << "  -i, --input FILE    Path to text file to type\n";
+    std::cout << "  -r, --restart       Start over instead of resuming a stopped run\n";
+    std::cout << "  -k, --keys LAYOUT   Press keys as scancodes for LAYOUT (us, uk, de, fr)\n";
+    std::cout << "                      instead of Unicode, for remote desktops and VMs\n";
     std::cout << "  -h, --help          Show this help message\n\n";
     std::cout << "Example:\n";
     std::cout << "  " << progName << " -i mytext.txt\n\n";
@@ -346,6 +441,8 @@ int main(int argc, char* argv[]) {
     SetConsoleOutputCP(CP_UTF8);
 
     std::string inputFile;
+    bool restart = false;
+    std::string keysLayout;
 
     // Parse arguments
     for (int i = 1; i < argc; ++i) {
@@ -356,6 +453,20 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
+        if (arg == "-r" || arg == "--restart") {
+            restart = true;
+        }
+
+        if (arg == "-k" || arg == "--keys") {
+            if (i + 1 < argc) {
+                keysLayout = argv[++i];
+            } else {
+                std::cerr << "Error: -k requires a layout\n";
+                showUsage(argv[0]);
+                return 1;
+            }
+        }
+
         if (arg == "-i" || arg == "--input") {
             if (i + 1 < argc) {
                 inputFile = argv[++i];
@@ -384,11 +495,20 @@ int main(int argc, char* argv[]) {
                << inputFile.c_str() << L"\n\n";
 
     // Create engine and type
-    TimingProfile profile = TimingProfile::humanAdvanced();
-    TypingEngine engine(profile);
+    TypingEngine engine;
+    if (!keysLayout.empty()) {
+        qtype::KeyboardLayoutType layout;
+        if (!parseLayout(keysLayout, layout)) {
+            std::cerr << "Error: Unknown layout: " << keysLayout << "\n";
+            showUsage(argv[0]);
+            return 1;
+        }
+        engine.useScancodes(layout);
+    }
 
     try {
-        engine.typeText(text);
+        // Checkpoints live next to the input file
+        engine.typeText(text, inputFile + ".qtype-session", restart);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
         return 1;
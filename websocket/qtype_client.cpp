@@ -1,8 +1,8 @@
 // qtype_client.cpp - Cross-Platform Console Client with WebSocket
-// Compile (MacOS): clang++ qtype_client.cpp -o qtype_client -std=c++17 -framework ApplicationServices -framework CoreFoundation
-// Compile (Linux): g++ qtype_client.cpp -o qtype_client -std=c++17 -lX11 -lXtst -lXss
-// Compile (Windows): cl qtype_client.cpp /EHsc /std:c++17 /Fe:qtype_client.exe
-//            or: g++ qtype_client.cpp -o qtype_client.exe -std=c++17 -static-libgcc -static-libstdc++
+// Compile (MacOS): clang++ qtype_client.cpp ../core/typing_core.cpp -I../core -o qtype_client -std=c++17 -framework ApplicationServices -framework CoreFoundation
+// Compile (Linux): g++ qtype_client.cpp ../core/typing_core.cpp ../core/x11_input.cpp -I../core -DQTYPE_HAVE_XTEST -o qtype_client -std=c++17 -lX11 -lXtst -lXss
+// Compile (Windows): cl qtype_client.cpp ..\core\typing_core.cpp /I..\core /EHsc /std:c++17 /Fe:qtype_client.exe
+//            or: g++ qtype_client.cpp ../core/typing_core.cpp -I../core -o qtype_client.exe -std=c++17 -static-libgcc -static-libstdc++
 // Compile (WSL): See Linux or use xdotool
 
 // Platform-specific includes - Windows first to avoid conflicts
@@ -18,9 +18,7 @@
 #include <ApplicationServices/ApplicationServices.h>
 #elif defined(__linux__)
 #include <X11/Xlib.h>
-#include <X11/extensions/XTest.h>
 #include <X11/extensions/scrnsaver.h>
-#include <X11/keysym.h>
 #endif
 
 #include <iostream>
@@ -29,40 +27,41 @@
 #include <chrono>
 #include <random>
 #include <cmath>
+#include <algorithm>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "typing_core.h"
+#include "typing_pipeline.h"
+#if defined(__linux__)
+#include "x11_input.h"
+#ifndef QTYPE_HAVE_XTEST
+#error "The Linux client types through XTest; build the core with X11 and XTest (QTYPE_HAVE_XTEST)"
+#endif
+#endif
+
+using qtype::RandomGenerator;
 
 // ============================================================================
 // Constants
 // ============================================================================
 
+// Timing, mouse and scroll constants come from the core; these are the
+// client's own
 namespace TypingConstants {
-    // Math constants
-    constexpr double TWO_PI = 6.28318530718;
-    
-    // Timing bounds
-    constexpr int MIN_DELAY_MS = 15;
-    constexpr int MAX_DELAY_MS = 8000;
-    constexpr int MIN_HOLD_TIME_MS = 40;
-    constexpr int MAX_HOLD_TIME_MS = 180;
-    
-    // Fatigue calculation
-    constexpr int CHARS_BEFORE_FATIGUE_UPDATE = 50;
-    constexpr int CHARS_FOR_MAX_FATIGUE = 1000;
-    constexpr double MAX_FATIGUE_FACTOR = 0.25;
-    constexpr double NOISE_LEVEL = 0.15;
-    
-    // Mouse movement
-    constexpr int MIN_MOUSE_MOVE_INTERVAL_CHARS = 20;
-    constexpr int MAX_MOUSE_MOVE_INTERVAL_CHARS = 60;
-    constexpr int MIN_MOUSE_PIXELS = 3;
-    constexpr int MAX_MOUSE_PIXELS = 15;
-    constexpr int MIN_MOUSE_PAUSE_MS = 100;
-    constexpr int MAX_MOUSE_PAUSE_MS = 300;
-    
-    // Scroll constants
-    constexpr int MIN_SCROLL_AMOUNT = 1;
-    constexpr int MAX_SCROLL_AMOUNT = 3;
-    constexpr double SCROLL_DOWN_PROBABILITY = 0.8;
+    // Text streaming: chunks the server may have in flight to us
+    constexpr int STREAM_WINDOW_CHUNKS = 4;
+    
+    // Progress reports sent to the server while typing
+    constexpr int MAX_PROGRESS_REPORTS_PER_SEC = 4;
 }
 
 // Simple WebSocket client using libwebsockets or raw socket
@@ -101,84 +100,33 @@ public:
 };
 
 // ============================================================================
-// Random Number Generator (same as console version)
+// Cross-Platform Keyboard Simulator
 // ============================================================================
 
-class RandomGenerator {
+#if defined(__linux__)
+// XTest from the core: one display connection and a cached keyboard mapping
+// that follows layout switches. Holds wait on the run's stop token.
+class KeyboardSimulator : public qtype::X11KeyboardSimulator<char> {
 public:
-    static double gamma(double shape, double scale) {
-        if (shape < 1.0) {
-            return gamma(1.0 + shape, scale) * std::pow(uniform(), 1.0 / shape);
-        }
-        
-        double d = shape - 1.0 / 3.0;
-        double c = 1.0 / std::sqrt(9.0 * d);
-        
-        while (true) {
-            double x, v;
-            do {
-                x = normal(0.0, 1.0);
-                v = 1.0 + c * x;
-            } while (v <= 0.0);
-            
-            v = v * v * v;
-            double u = uniform();
-            
-            if (u < 1.0 - 0.0331 * x * x * x * x) {
-                return d * v * scale;
-            }
-            if (std::log(u) < 0.5 * x * x + d * (1.0 - v + std::log(v))) {
-                return d * v * scale;
-            }
-        }
-    }
-    
-    static double normal(double mean, double stddev) {
-        thread_local bool hasSpare = false;
-        thread_local double spare;
-        
-        if (hasSpare) {
-            hasSpare = false;
-            return mean + stddev * spare;
+    KeyboardSimulator() {
+        if (!isConnected()) {
+            std::cerr << "Error: Cannot open X display with XTest. Make sure DISPLAY is set.\n";
+            std::cerr << "For WSL, you may need to install and run an X server (VcXsrv, Xming, etc.)\n";
+            std::cerr << "Or use: export DISPLAY=:0\n";
         }
-        
-        double u, v, s;
-        do {
-            u = uniform() * 2.0 - 1.0;
-            v = uniform() * 2.0 - 1.0;
-            s = u * u + v * v;
-        } while (s >= 1.0 || s == 0.0);
-        
-        s = std::sqrt(-2.0 * std::log(s) / s);
-        spare = v * s;
-        hasSpare = true;
-        
-        return mean + stddev * u * s;
-    }
-    
-    static int range(int min, int max) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(min, max);
-        return dis(gen);
-    }
-    
-    static double uniform() {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<> dis(0.0, 1.0);
-        return dis(gen);
     }
 };
-
-// ============================================================================
-// Cross-Platform Keyboard Simulator
-// ============================================================================
-
-class KeyboardSimulator {
+#else
+class KeyboardSimulator : public qtype::IKeyboardSimulator<char> {
 public:
+    // Holds and modifier pauses end early once the run is cancelled
+    void setCancellationToken(qtype::CancellationToken* token) {
+        cancel_ = token;
+    }
+    
 #ifdef __APPLE__
-    void typeCharacter(unsigned char c, int holdTimeMs) {
+    void typeCharacter(char ch, int holdTimeMs) override {
+        unsigned char c = static_cast<unsigned char>(ch);
         UniChar uc = c;
         CGEventRef down = nullptr;
         CGEventRef up = nullptr;
@@ -189,7 +137,7 @@ public:
             CGEventPost(kCGHIDEventTap, shiftDown);
             CFRelease(shiftDown);
             
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            hold(10);
             
             down = CGEventCreateKeyboardEvent(nullptr, 0x24, true);
             up = CGEventCreateKeyboardEvent(nullptr, 0x24, false);
@@ -198,13 +146,13 @@ public:
             CGEventSetFlags(up, kCGEventFlagMaskShift);
             
             CGEventPost(kCGHIDEventTap, down);
-            std::this_thread::sleep_for(std::chrono::milliseconds(holdTimeMs));
+            hold(holdTimeMs);
             CGEventPost(kCGHIDEventTap, up);
             
             CFRelease(down);
             CFRelease(up);
             
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            hold(10);
             
             CGEventRef shiftUp = CGEventCreateKeyboardEvent(nullptr, 56, false);
             CGEventPost(kCGHIDEventTap, shiftUp);
@@ -217,7 +165,7 @@ public:
             CGEventKeyboardSetUnicodeString(up, 1, &uc);
             
             CGEventPost(kCGHIDEventTap, down);
-            std::this_thread::sleep_for(std::chrono::milliseconds(holdTimeMs));
+            hold(holdTimeMs);
             CGEventPost(kCGHIDEventTap, up);
             
             CFRelease(down);
@@ -225,173 +173,24 @@ public:
         }
     }
     
-    void pressBackspace() {
+    void pressBackspace() override {
         CGEventRef down = CGEventCreateKeyboardEvent(nullptr, 51, true);  // kVK_Delete
         CGEventRef up = CGEventCreateKeyboardEvent(nullptr, 51, false);
         CGEventPost(kCGHIDEventTap, down);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        hold(10);
         CGEventPost(kCGHIDEventTap, up);
         CFRelease(down);
         CFRelease(up);
     }
     
-    void releaseAllKeys() {
+    void releaseAllKeys() override {
         // Not needed on macOS typically
     }
     
-#elif defined(__linux__)
-    KeyboardSimulator() {
-        display = XOpenDisplay(nullptr);
-        if (!display) {
-            std::cerr << "Error: Cannot open X display. Make sure DISPLAY is set.\n";
-            std::cerr << "For WSL, you may need to install and run an X server (VcXsrv, Xming, etc.)\n";
-            std::cerr << "Or use: export DISPLAY=:0\n";
-        }
-    }
-    
-    ~KeyboardSimulator() {
-        if (display) {
-            XCloseDisplay(display);
-        }
-    }
-    
-    void typeCharacter(unsigned char c, int holdTimeMs) {
-        if (!display) return;
-        
-        if (c == '\n') {
-            // Send Shift+Enter
-            KeyCode shift = XKeysymToKeycode(display, XK_Shift_L);
-            KeyCode enter = XKeysymToKeycode(display, XK_Return);
-            
-            XTestFakeKeyEvent(display, shift, True, 0);
-            XFlush(display);
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            
-            XTestFakeKeyEvent(display, enter, True, 0);
-            XFlush(display);
-            std::this_thread::sleep_for(std::chrono::milliseconds(holdTimeMs));
-            XTestFakeKeyEvent(display, enter, False, 0);
-            XFlush(display);
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            XTestFakeKeyEvent(display, shift, False, 0);
-            XFlush(display);
-            return;
-        }
-        
-        // Convert character to KeySym
-        KeySym keysym = charToKeySym(c);
-        if (keysym == NoSymbol) {
-            std::cerr << "Warning: Cannot map character '" << c << "' (code: " << (int)c << ")\n";
-            return;
-        }
-        
-        KeyCode keycode = XKeysymToKeycode(display, keysym);
-        if (keycode == 0) {
-            std::cerr << "Warning: No keycode for character '" << c << "'\n";
-            return;
-        }
-        
-        // Check if shift is needed
-        bool needShift = std::isupper(c) || isShiftChar(c);
-        
-        if (needShift) {
-            KeyCode shift = XKeysymToKeycode(display, XK_Shift_L);
-            XTestFakeKeyEvent(display, shift, True, 0);
-            XFlush(display);
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
-        }
-        
-        XTestFakeKeyEvent(display, keycode, True, 0);
-        XFlush(display);
-        std::this_thread::sleep_for(std::chrono::milliseconds(holdTimeMs));
-        XTestFakeKeyEvent(display, keycode, False, 0);
-        XFlush(display);
-        
-        if (needShift) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
-            KeyCode shift = XKeysymToKeycode(display, XK_Shift_L);
-            XTestFakeKeyEvent(display, shift, False, 0);
-            XFlush(display);
-        }
-    }
-    
-    void pressBackspace() {
-        if (!display) return;
-        
-        KeyCode backspace = XKeysymToKeycode(display, XK_BackSpace);
-        XTestFakeKeyEvent(display, backspace, True, 0);
-        XFlush(display);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        XTestFakeKeyEvent(display, backspace, False, 0);
-        XFlush(display);
-    }
-    
-    void releaseAllKeys() {
-        // Not typically needed for Linux
-    }
-    
-private:
-    Display* display = nullptr;
-    
-    KeySym charToKeySym(unsigned char c) {
-        // Handle special characters
-        switch (c) {
-            case ' ': return XK_space;
-            case '!': return XK_exclam;
-            case '"': return XK_quotedbl;
-            case '#': return XK_numbersign;
-            case '$': return XK_dollar;
-            case '%': return XK_percent;
-            case '&': return XK_ampersand;
-            case '\'': return XK_apostrophe;
-            case '(': return XK_parenleft;
-            case ')': return XK_parenright;
-            case '*': return XK_asterisk;
-            case '+': return XK_plus;
-            case ',': return XK_comma;
-            case '-': return XK_minus;
-            case '.': return XK_period;
-            case '/': return XK_slash;
-            case ':': return XK_colon;
-            case ';': return XK_semicolon;
-            case '<': return XK_less;
-            case '=': return XK_equal;
-            case '>': return XK_greater;
-            case '?': return XK_question;
-            case '@': return XK_at;
-            case '[': return XK_bracketleft;
-            case '\\': return XK_backslash;
-            case ']': return XK_bracketright;
-            case '^': return XK_asciicircum;
-            case '_': return XK_underscore;
-            case '`': return XK_grave;
-            case '{': return XK_braceleft;
-            case '|': return XK_bar;
-            case '}': return XK_braceright;
-            case '~': return XK_asciitilde;
-            case '\t': return XK_Tab;
-            case '\r': return XK_Return;
-        }
-        
-        // Handle alphanumeric
-        if (c >= 'a' && c <= 'z') return XK_a + (c - 'a');
-        if (c >= 'A' && c <= 'Z') return XK_a + (c - 'A');
-        if (c >= '0' && c <= '9') return XK_0 + (c - '0');
-        
-        return NoSymbol;
-    }
-    
-    bool isShiftChar(unsigned char c) {
-        return (c == '!' || c == '@' || c == '#' || c == '$' || c == '%' ||
-                c == '^' || c == '&' || c == '*' || c == '(' || c == ')' ||
-                c == '_' || c == '+' || c == '{' || c == '}' || c == '|' ||
-                c == ':' || c == '"' || c == '<' || c == '>' || c == '?' ||
-                c == '~');
-    }
 #elif defined(_WIN32) || defined(_WIN64)
     // Windows implementation using SendInput
-    void typeCharacter(unsigned char c, int holdTimeMs) {
+    void typeCharacter(char ch, int holdTimeMs) override {
+        unsigned char c = static_cast<unsigned char>(ch);
         if (c == '\n') {
             // Send Shift+Enter on Windows
             INPUT shiftDown = {0};
@@ -399,14 +198,14 @@ private:
             shiftDown.ki.wVk = VK_SHIFT;
             SendInput(1, &shiftDown, sizeof(INPUT));
             
-            Sleep(10);
+            hold(10);
             
             INPUT enterDown = {0};
             enterDown.type = INPUT_KEYBOARD;
             enterDown.ki.wVk = VK_RETURN;
             SendInput(1, &enterDown, sizeof(INPUT));
             
-            Sleep(holdTimeMs);
+            hold(holdTimeMs);
             
             INPUT enterUp = {0};
             enterUp.type = INPUT_KEYBOARD;
@@ -414,7 +213,7 @@ private:
             enterUp.ki.dwFlags = KEYEVENTF_KEYUP;
             SendInput(1, &enterUp, sizeof(INPUT));
             
-            Sleep(10);
+            hold(10);
             
             INPUT shiftUp = {0};
             shiftUp.type = INPUT_KEYBOARD;
@@ -434,7 +233,7 @@ private:
         down.ki.dwFlags = KEYEVENTF_UNICODE;
         SendInput(1, &down, sizeof(INPUT));
         
-        Sleep(holdTimeMs);
+        hold(holdTimeMs);
         
         // Key up
         INPUT up = {0};
@@ -444,13 +243,13 @@ private:
         SendInput(1, &up, sizeof(INPUT));
     }
     
-    void pressBackspace() {
+    void pressBackspace() override {
         INPUT down = {0};
         down.type = INPUT_KEYBOARD;
         down.ki.wVk = VK_BACK;
         SendInput(1, &down, sizeof(INPUT));
         
-        Sleep(10);
+        hold(10);
         
         INPUT up = {0};
         up.type = INPUT_KEYBOARD;
@@ -459,7 +258,7 @@ private:
         SendInput(1, &up, sizeof(INPUT));
     }
     
-    void releaseAllKeys() {
+    void releaseAllKeys() override {
         // Release common modifier keys on Windows
         WORD modifiers[] = {VK_SHIFT, VK_CONTROL, VK_MENU, VK_LWIN, VK_RWIN};
         for (WORD vk : modifiers) {
@@ -471,27 +270,46 @@ private:
         }
     }
 #else
-    void typeCharacter(unsigned char c, int holdTimeMs) {
+    void typeCharacter(char ch, int holdTimeMs) override {
         std::cerr << "Error: Keyboard simulation not implemented for this platform\n";
     }
     
-    void pressBackspace() {
+    void pressBackspace() override {
         std::cerr << "Error: Backspace not implemented for this platform\n";
     }
     
-    void releaseAllKeys() {
+    void releaseAllKeys() override {
     }
 #endif
+
+private:
+    qtype::CancellationToken* cancel_ = nullptr;
+    
+    void hold(int ms) {
+        qtype::systemClock().waitForMs(ms, cancel_);
+    }
 };
 
+#endif
+
 // ============================================================================
 // Cross-Platform Mouse Simulator
 // ============================================================================
 
-class MouseSimulator {
+#if defined(__linux__)
+class MouseSimulator : public qtype::X11MouseSimulator {
+public:
+    MouseSimulator() {
+        if (!isConnected()) {
+            std::cerr << "Warning: Cannot open X display for mouse\n";
+        }
+    }
+};
+#else
+class MouseSimulator : public qtype::IMouseSimulator {
 public:
 #ifdef __APPLE__
-    void moveRelative(int deltaX, int deltaY) {
+    void moveRelative(int deltaX, int deltaY) override {
         CGEventRef event = CGEventCreate(nullptr);
         CGPoint currentPos = CGEventGetLocation(event);
         CFRelease(event);
@@ -505,7 +323,7 @@ public:
         CFRelease(move);
     }
     
-    void scroll(int amount) {
+    void scroll(int amount) override {
         // Create a scroll wheel event
         // Positive amount = scroll down, negative = scroll up
         CGEventRef scrollEvent = CGEventCreateScrollWheelEvent(nullptr, 
@@ -515,49 +333,14 @@ public:
         CGEventPost(kCGHIDEventTap, scrollEvent);
         CFRelease(scrollEvent);
     }
-#elif defined(__linux__)
-    MouseSimulator() {
-        display = XOpenDisplay(nullptr);
-        if (!display) {
-            std::cerr << "Warning: Cannot open X display for mouse\n";
-        }
-    }
-    
-    ~MouseSimulator() {
-        if (display) {
-            XCloseDisplay(display);
-        }
-    }
-    
-    void moveRelative(int deltaX, int deltaY) {
-        if (!display) return;
-        XTestFakeRelativeMotionEvent(display, deltaX, deltaY, CurrentTime);
-        XFlush(display);
-    }
-    
-    void scroll(int amount) {
-        if (!display) return;
-        // X11 scroll simulation using button 4 (scroll up) and button 5 (scroll down)
-        unsigned int button = (amount > 0) ? 5 : 4;  // 5=down, 4=up
-        int absAmount = std::abs(amount);
-        
-        for (int i = 0; i < absAmount; i++) {
-            XTestFakeButtonEvent(display, button, True, CurrentTime);
-            XTestFakeButtonEvent(display, button, False, CurrentTime);
-        }
-        XFlush(display);
-    }
-    
-private:
-    Display* display = nullptr;
 #elif defined(_WIN32) || defined(_WIN64)
-    void moveRelative(int deltaX, int deltaY) {
+    void moveRelative(int deltaX, int deltaY) override {
         POINT pt;
         GetCursorPos(&pt);
         SetCursorPos(pt.x + deltaX, pt.y + deltaY);
     }
     
-    void scroll(int amount) {
+    void scroll(int amount) override {
         // Windows scroll using mouse_event with MOUSEEVENTF_WHEEL
         // Positive amount = scroll down (negative wheel delta)
         // Negative amount = scroll up (positive wheel delta)
@@ -569,15 +352,16 @@ private:
         SendInput(1, &input, sizeof(INPUT));
     }
 #else
-    void moveRelative(int deltaX, int deltaY) {
+    void moveRelative(int deltaX, int deltaY) override {
         // No-op for unsupported platforms
     }
     
-    void scroll(int amount) {
+    void scroll(int amount) override {
         // No-op for unsupported platforms
     }
 #endif
 };
+#endif
 
 // ============================================================================
 // Idle Detection (Platform-Specific)
@@ -634,175 +418,306 @@ public:
 };
 
 // ============================================================================
-// Typing Engine
+// Streamed Text Buffer
 // ============================================================================
 
-class TypingEngine {
+// Hand-off between the network loop (producer) and the typing thread
+// (consumer). The server only sends chunks we granted credit for, so at most
+// STREAM_WINDOW_CHUNKS are queued here no matter how large the document is.
+class TextStream {
 public:
-    TypingEngine() 
-        : rhythmPhase_(RandomGenerator::uniform() * TypingConstants::TWO_PI)
-        , fatigueFactor_(1.0)
-        , burstRemaining_(0)
-        , totalCharsTyped_(0)
-        , minDelayMs_(120)
-        , maxDelayMs_(2000)
-        , mouseMovementEnabled_(false)
-        , charsSinceMouseMove_(0)
-        , nextMouseMoveAt_(0)
-    {
-        scheduleNextMouseMove();
+    // Called on the typing thread when a freed slot leaves credit to hand
+    // back, so the loop doesn't have to poll for it. Set before any run.
+    void setNotifier(std::function<void()> notifier) {
+        notifier_ = std::move(notifier);
     }
     
-    void setDelayRange(int minMs, int maxMs) {
-        minDelayMs_ = minMs;
-        maxDelayMs_ = maxMs;
+    void begin(int id, size_t totalLength) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id_ = id;
+        totalLength_ = totalLength;
+        nextSeq_ = 0;
+        chunks_.clear();
+        finished_ = false;
+        cancelled_ = false;
+        creditsOwed_ = 0;
     }
     
-    void setMouseMovementEnabled(bool enabled) {
-        mouseMovementEnabled_ = enabled;
+    // Queues a chunk of the current stream; stale or out-of-order chunks are dropped
+    bool push(int id, int seq, std::string text, bool final) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (id != id_ || seq != nextSeq_ || finished_ || cancelled_) return false;
+            nextSeq_++;
+            chunks_.push_back(std::move(text));
+            finished_ = final;
+        }
+        cv_.notify_one();
+        return true;
     }
     
-    void typeText(const std::string& text, std::atomic<bool>& shouldStop) {
-        std::cout << "Starting in 5 seconds...\n";
-        for (int i = 5; i > 0 && !shouldStop; --i) {
-            std::cout << i << "...\n";
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+            chunks_.clear();
         }
-        
-        if (shouldStop) return;
-        
-        std::cout << "Typing...\n";
-        
-        size_t total = text.length();
-        size_t progress = 0;
-        
-        for (char c : text) {
-            if (shouldStop) break;
-            
-            // Check if we should move mouse
-            if (shouldMoveMouse()) {
-                performMouseMovement();
-                std::this_thread::sleep_for(std::chrono::milliseconds(
-                    RandomGenerator::range(TypingConstants::MIN_MOUSE_PAUSE_MS, 
-                                          TypingConstants::MAX_MOUSE_PAUSE_MS)));
-            }
-            
-            unsigned char uc = static_cast<unsigned char>(c);
-            int holdTime = generateHoldTime(uc);
-            simulator_.typeCharacter(uc, holdTime);
-            
-            int delay = calculateDelay(uc);
-            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
-            
-            totalCharsTyped_++;
-            charsSinceMouseMove_++;
-            progress++;
-            
-            if (progress % 50 == 0) {
-                int percent = (progress * 100) / total;
-                std::cout << "\rProgress: " << percent << "%";
-                std::cout.flush();
-            }
-        }
-        
-        std::cout << "\rProgress: 100%\n";
-        std::cout << "Completed!\n";
+        cv_.notify_all();
+    }
+    
+    // Blocks until the next chunk arrives. Returns false at end of stream or on cancel.
+    bool pop(std::string& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !chunks_.empty() || finished_ || cancelled_; });
+        if (cancelled_ || chunks_.empty()) return false;
+        
+        out = std::move(chunks_.front());
+        chunks_.pop_front();
+        if (finished_) return true;
+        
+        // Slot is free again, let the server refill it
+        bool first = creditsOwed_++ == 0;
+        lock.unlock();
+        if (first && notifier_) notifier_();
+        return true;
+    }
+    
+    // Credits to hand back to the server since the last call
+    int takeCredits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int credits = creditsOwed_;
+        creditsOwed_ = 0;
+        return credits;
+    }
+    
+    int id() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return id_;
+    }
+    
+    size_t totalLength() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return totalLength_;
     }
     
 private:
-    int calculateDelay(unsigned char c) {
-        double range = maxDelayMs_ - minDelayMs_;
-        double gammaValue = RandomGenerator::gamma(2.0, 1.0);
-        double normalized = std::min(gammaValue / 6.0, 1.0);
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::function<void()> notifier_;
+    std::deque<std::string> chunks_;
+    int id_ = 0;
+    int nextSeq_ = 0;
+    size_t totalLength_ = 0;
+    int creditsOwed_ = 0;
+    bool finished_ = false;
+    bool cancelled_ = false;
+};
+
+// ============================================================================
+// Progress Reporting
+// ============================================================================
+
+// The typing thread publishes its position with a relaxed store per
+// character; a timer on the network loop turns it into a status message
+// MAX_PROGRESS_REPORTS_PER_SEC times a second while typing. Positions in
+// between simply overwrite each other, so a slow socket only ever gets the
+// newest one.
+class ProgressReporter {
+public:
+    void begin(size_t total) {
+        total_.store(total, std::memory_order_relaxed);
+        typed_.store(0, std::memory_order_relaxed);
+        lastSentTyped_ = SIZE_MAX;
+    }
+    
+    void update(size_t typed) {
+        typed_.store(typed, std::memory_order_relaxed);
+    }
+    
+    // Builds a report if the position changed since the last one
+    bool poll(std::string& message) {
+        size_t typed = typed_.load(std::memory_order_relaxed);
+        if (typed == lastSentTyped_) return false;
         
-        double delay = minDelayMs_ + range * normalized;
-        delay *= rhythmicVariation();
+        size_t total = total_.load(std::memory_order_relaxed);
+        int percent = total > 0 ? static_cast<int>(std::min<size_t>(100, typed * 100 / total)) : 0;
+        message = "{\"type\":\"status\",\"status\":\"progress\",\"progress\":" + std::to_string(percent) +
+                  ",\"typed\":" + std::to_string(typed) + ",\"total\":" + std::to_string(total) + "}";
         
-        if (std::isdigit(c)) delay *= 1.05;
-        if (std::isspace(c)) delay *= 1.12;
-        if (c == '\n') delay *= 1.5;
-        if (c == '.' || c == '!' || c == '?') delay *= 1.4;
+        lastSentTyped_ = typed;
+        return true;
+    }
+    
+private:
+    std::atomic<size_t> typed_{0};
+    std::atomic<size_t> total_{0};
+    
+    size_t lastSentTyped_ = SIZE_MAX;   // Network loop only
+};
+
+// ============================================================================
+// Typing Engine
+// ============================================================================
+
+// Console frontend of the shared core engine: countdown, progress output and
+// the pauses the core asks for between chunks. Every wait, down to key holds,
+// is on the stop token, so stop_typing takes effect at once. Whole-text runs
+// are checkpointed, so a stopped run of the same text picks up where it left off.
+class TypingEngine {
+public:
+    TypingEngine()
+        : engine_(&simulator_, &mouseSim_, qtype::DelayRange{120, 2000},
+                  clientImperfections())
+        , pipeline_(&simulator_, &mouseSim_, qtype::DelayRange{120, 2000},
+                    clientImperfections())
+    {}
+    
+    void setDelayRange(int minMs, int maxMs) {
+        engine_.setDelayRange(qtype::DelayRange{minMs, maxMs});
+        pipeline_.engine().setDelayRange(qtype::DelayRange{minMs, maxMs});
+    }
+    
+    void setMouseMovementEnabled(bool enabled) {
+        engine_.setMouseMovementEnabled(enabled);
+        pipeline_.engine().setMouseMovementEnabled(enabled);
+    }
+    
+    void setProgressReporter(ProgressReporter* reporter) {
+        progressReporter_ = reporter;
+    }
+    
+    void setSessionPath(const std::string& path) {
+        sessionPath_ = path;
+    }
+    
+    void typeText(const std::string& text, qtype::CancellationToken& stop) {
+        beginRun(stop);
         
-        if (RandomGenerator::uniform() < 0.1)
-            delay *= 1.3 + RandomGenerator::uniform() * 0.4;
+        qtype::SessionState session;
+        if (qtype::SessionState::load(sessionPath_, session) && engine_.resume(text, session)) {
+            std::cout << "Resuming at " << session.progressPercent() << "%\n";
+            lastPrinted_ = session.position;
+        } else {
+            engine_.setText(text);
+        }
+        checkpointing_ = true;
         
-        if (shouldBurst())
-            delay *= 0.65;
+        if (countdown(stop)) {
+            std::cout << "Typing...\n";
+            typeAvailable(text.length(), stop);
+        }
         
-        delay *= fatigueFactor_;
+        finish(stop, engine_.getSkippedCharCount());
+    }
+    
+    // Types chunks as they arrive, so the first keystroke doesn't wait for the
+    // rest of the document. The pipeline plans keys ahead on its own thread
+    // and this one only injects them; stop_typing cancels the stream, which
+    // lets a planner waiting for text finish. Not checkpointed: a new stream
+    // is new text.
+    void typeStream(TextStream& stream, qtype::CancellationToken& stop) {
+        beginRun(stop);
+        checkpointing_ = false;
+        if (!countdown(stop)) {
+            finish(stop, 0);
+            return;
+        }
         
-        double noise = RandomGenerator::normal(0.0, TypingConstants::NOISE_LEVEL);
-        delay *= (1.0 + noise);
+        std::cout << "Typing...\n";
         
-        if (totalCharsTyped_ % TypingConstants::CHARS_BEFORE_FATIGUE_UPDATE == 0) {
-            fatigueFactor_ = 1.0 + TypingConstants::MAX_FATIGUE_FACTOR * 
-                             std::min(1.0, totalCharsTyped_ / static_cast<double>(TypingConstants::CHARS_FOR_MAX_FATIGUE));
-        }
+        size_t total = stream.totalLength();
+        pipeline_.run([&stream](std::string& text) { return stream.pop(text); }, stop,
+                      [this, total](int position) { reportProgress(position, total); });
+        finish(stop, pipeline_.engine().getSkippedCharCount());
         
-        return std::max(TypingConstants::MIN_DELAY_MS, std::min(int(delay), TypingConstants::MAX_DELAY_MS));
+        qtype::PipelineStats stats = pipeline_.stats();
+        std::cout << "Planned ahead: peak " << stats.peakFill << " of " << stats.capacity
+                  << " events, " << stats.underruns << " underruns\n";
     }
     
-    int generateHoldTime(unsigned char c) {
-        double hold = RandomGenerator::gamma(2.5, 20.0);
-        if (std::isupper(c)) hold *= 1.2;
-        hold *= (0.9 + RandomGenerator::uniform() * 0.2);
-        return std::max(TypingConstants::MIN_HOLD_TIME_MS, std::min(int(hold), TypingConstants::MAX_HOLD_TIME_MS));
+private:
+    // The server doesn't send imperfection settings; type the text as given
+    static qtype::ImperfectionSettings clientImperfections() {
+        qtype::ImperfectionSettings settings;
+        settings.enableTypos = false;
+        settings.enableDoubleKeys = false;
+        return settings;
     }
     
-    double rhythmicVariation() {
-        rhythmPhase_ += 0.03;
-        double rhythm = std::sin(rhythmPhase_) * 0.5 + 0.5;
-        return 0.85 + rhythm * 0.3;
+    void beginRun(qtype::CancellationToken& stop) {
+        simulator_.setCancellationToken(&stop);
+        engine_.setCancellationToken(&stop);
+        pacer_.reset();
+        lastPrinted_ = 0;
+        lastCheckpoint_ = std::chrono::steady_clock::now();
     }
     
-    bool shouldBurst() {
-        if (burstRemaining_ > 0) {
-            burstRemaining_--;
-            return true;
-        }
-        if (RandomGenerator::uniform() < 0.14) {
-            burstRemaining_ = RandomGenerator::range(2, 6);
-            return true;
+    bool countdown(qtype::CancellationToken& stop) {
+        std::cout << "Starting in 5 seconds...\n";
+        for (int i = 5; i > 0 && !stop.isCancelled(); --i) {
+            std::cout << i << "...\n";
+            qtype::systemClock().waitForMs(1000, &stop);
         }
-        return false;
+        return !stop.isCancelled();
     }
     
-    void scheduleNextMouseMove() {
-        nextMouseMoveAt_ = RandomGenerator::range(TypingConstants::MIN_MOUSE_MOVE_INTERVAL_CHARS,
-                                                  TypingConstants::MAX_MOUSE_MOVE_INTERVAL_CHARS);
+    void typeAvailable(size_t total, qtype::CancellationToken& stop) {
+        while (!stop.isCancelled() && engine_.hasMoreToType()) {
+            int delay = engine_.typeNextChunk();
+            reportProgress(engine_.currentPosition(), total);
+            
+            auto now = std::chrono::steady_clock::now();
+            if (checkpointing_ &&
+                now - lastCheckpoint_ >= std::chrono::milliseconds(TypingConstants::CHECKPOINT_INTERVAL_MS)) {
+                engine_.checkpoint().save(sessionPath_);
+                lastCheckpoint_ = now;
+            }
+            
+            pacer_.wait(delay, &stop);
+        }
     }
     
-    bool shouldMoveMouse() {
-        return mouseMovementEnabled_ && charsSinceMouseMove_ >= nextMouseMoveAt_;
+    void reportProgress(size_t progress, size_t total) {
+        if (progressReporter_) progressReporter_->update(progress);
+        
+        // Console line every 50 characters
+        if (progress / 50 != lastPrinted_ / 50 && total > 0) {
+            int percent = static_cast<int>(std::min<size_t>(100, (progress * 100) / total));
+            std::cout << "\rProgress: " << percent << "%";
+            std::cout.flush();
+            lastPrinted_ = progress;
+        }
     }
     
-    void performMouseMovement() {
-        int deltaX = RandomGenerator::range(-TypingConstants::MAX_MOUSE_PIXELS, 
-                                            TypingConstants::MAX_MOUSE_PIXELS);
-        int deltaY = RandomGenerator::range(-TypingConstants::MAX_MOUSE_PIXELS, 
-                                            TypingConstants::MAX_MOUSE_PIXELS);
-        
-        if (deltaX == 0 && deltaY == 0) {
-            deltaX = RandomGenerator::range(TypingConstants::MIN_MOUSE_PIXELS, 
-                                            TypingConstants::MAX_MOUSE_PIXELS);
+    void finish(qtype::CancellationToken& stop, int skipped) {
+        if (stop.isCancelled()) {
+            if (checkpointing_) engine_.checkpoint().save(sessionPath_);
+            std::cout << "\nStopped\n";
+            return;
         }
         
-        mouseSim_.moveRelative(deltaX, deltaY);
-        charsSinceMouseMove_ = 0;
-        scheduleNextMouseMove();
+        if (checkpointing_) std::remove(sessionPath_.c_str());
+        
+        std::cout << "\rProgress: 100%\n";
+        std::cout << "Completed!\n";
+        
+        if (skipped > 0) {
+            std::cout << "Skipped " << skipped << " untypeable characters\n";
+        }
     }
     
     KeyboardSimulator simulator_;
     MouseSimulator mouseSim_;
-    double rhythmPhase_;
-    double fatigueFactor_;
-    int burstRemaining_;
-    int totalCharsTyped_;
-    int minDelayMs_;
-    int maxDelayMs_;
-    bool mouseMovementEnabled_;
-    int charsSinceMouseMove_;
-    int nextMouseMoveAt_;
+    // The console always types with the humanAdvanced profile
+    qtype::TypingEngine<char, qtype::CharTraits<char>, qtype::HumanAdvancedProfile> engine_;
+    qtype::TypingPipeline<char, qtype::CharTraits<char>, qtype::HumanAdvancedProfile> pipeline_;
+    qtype::Pacer pacer_;
+    ProgressReporter* progressReporter_ = nullptr;
+    size_t lastPrinted_ = 0;
+    
+    std::string sessionPath_ = ".qtype-session";
+    bool checkpointing_ = false;
+    std::chrono::steady_clock::time_point lastCheckpoint_;
 };
 
 // ============================================================================
@@ -815,8 +730,72 @@ private:
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <cerrno>
 #endif
 
+// One client-to-server frame: header with masking key, and the payload
+// masked in place
+struct OutboundFrame {
+    std::atomic<OutboundFrame*> next{nullptr};
+    unsigned char header[14];
+    size_t headerLen = 0;
+    std::string payload;
+    size_t written = 0;   // Bytes of header + payload already sent
+    
+    size_t size() const { return headerLen + payload.size(); }
+};
+
+// Intrusive multi-producer/single-consumer queue. push() is lock-free and
+// may be called from any thread; pop() only by the thread holding the
+// writer role.
+class OutboundQueue {
+public:
+    OutboundQueue() : head_(&stub_), tail_(&stub_) {}
+    
+    ~OutboundQueue() {
+        while (OutboundFrame* frame = pop()) delete frame;
+    }
+    
+    void push(OutboundFrame* frame) {
+        frame->next.store(nullptr, std::memory_order_relaxed);
+        OutboundFrame* prev = head_.exchange(frame, std::memory_order_acq_rel);
+        prev->next.store(frame, std::memory_order_release);
+    }
+    
+    // Oldest frame, or nullptr if empty or a producer is halfway through push()
+    OutboundFrame* pop() {
+        OutboundFrame* tail = tail_;
+        OutboundFrame* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+        
+        // Last real frame: put the stub behind it so it can be unlinked
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+    
+private:
+    std::atomic<OutboundFrame*> head_;   // Producers push here
+    OutboundFrame* tail_;                // Consumer pops here
+    OutboundFrame stub_;
+};
+
 class WebSocketClient {
 public:
 #if defined(_WIN32) || defined(_WIN64)
@@ -888,60 +867,120 @@ public:
         fcntl(sockfd_, F_SETFL, O_NONBLOCK);
 #endif
         
+        open_ = true;
         std::cout << "Connected to server\n";
         return true;
     }
     
-    void sendMessage(const std::string& message) {
-        // Simplified WebSocket frame (text frame)
-        std::string frame;
-        frame += (char)0x81; // FIN + text frame
+    // Queues a text frame and writes it if no other thread is writing.
+    // Safe to call from any thread.
+    void sendMessage(std::string message) {
+        auto* frame = new OutboundFrame();
+        frame->header[0] = 0x81;  // FIN + text frame
         
         size_t len = message.length();
+        size_t n = 2;
         if (len < 126) {
-            frame += (char)(0x80 | len); // Masked + length
+            frame->header[1] = static_cast<unsigned char>(0x80 | len);  // Masked + length
+        } else if (len <= 0xFFFF) {
+            frame->header[1] = 0x80 | 126;
+            frame->header[n++] = (len >> 8) & 0xFF;
+            frame->header[n++] = len & 0xFF;
         } else {
-            frame += (char)(0x80 | 126);
-            frame += (char)((len >> 8) & 0xFF);
-            frame += (char)(len & 0xFF);
+            frame->header[1] = 0x80 | 127;
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                frame->header[n++] = (uint64_t(len) >> shift) & 0xFF;
+            }
         }
         
-        // Masking key (simple)
-        char mask[4] = {0x12, 0x34, 0x56, 0x78};
-        frame.append(mask, 4);
+        uint32_t key = nextMaskKey();
+        unsigned char* mask = frame->header + n;
+        std::memcpy(mask, &key, 4);
+        frame->headerLen = n + 4;
         
-        // Masked payload
-        for (size_t i = 0; i < len; ++i) {
-            frame += message[i] ^ mask[i % 4];
+        frame->payload = std::move(message);
+        maskPayload(frame->payload, mask);
+        
+        pendingFrames_.fetch_add(1, std::memory_order_relaxed);
+        outbound_.push(frame);
+        flush();
+    }
+    
+    // Writes queued frames until the queue is empty or the socket would block.
+    // Only one thread writes at a time; a caller that finds the writer busy
+    // returns at once and its frames go out with the writer's next batch.
+    void flush() {
+        while (!writing_.exchange(true, std::memory_order_acquire)) {
+            bool drained = writePending();
+            writing_.store(false, std::memory_order_release);
+            
+            // A frame pushed while we held the writer role has no one else
+            // to write it
+            if (!drained || pendingFrames_.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+    
+    // True while frames are queued or the kernel send buffer is full
+    bool isBackedUp() const {
+        return pendingFrames_.load(std::memory_order_relaxed) > 0 || !isWritable();
+    }
+    
+    // True if a send() right now would not block
+    bool isWritable() const {
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(sockfd_, &writeSet);
+        timeval timeout = {0, 0};
+        return select(static_cast<int>(sockfd_) + 1, nullptr, &writeSet, nullptr, &timeout) > 0;
+    }
+    
+    // Blocks until data arrives, wakeFd turns readable, queued frames can
+    // be written, or timeoutMs passes (-1: no timeout). The loop reacts to a
+    // command (stop_typing) as soon as it lands instead of on its next poll.
+    void wait(int timeoutMs, SocketType wakeFd) const {
+        fd_set readSet, writeSet;
+        FD_ZERO(&readSet);
+        FD_ZERO(&writeSet);
+        FD_SET(sockfd_, &readSet);
+        SocketType maxFd = sockfd_;
+        if (wakeFd != INVALID_SOCKET_VALUE) {
+            FD_SET(wakeFd, &readSet);
+            maxFd = std::max(maxFd, wakeFd);
         }
+        if (pendingFrames_.load(std::memory_order_relaxed) > 0) FD_SET(sockfd_, &writeSet);
         
-        send(sockfd_, frame.c_str(), frame.length(), 0);
+        timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        select(static_cast<int>(maxFd) + 1, &readSet, &writeSet, nullptr, timeoutMs < 0 ? nullptr : &timeout);
     }
     
+    // Returns the next complete message, or "" if none has fully arrived yet
+    // or the connection is gone; isOpen() tells the two apart. Frames are
+    // reassembled across recv() calls, and several frames read in one call
+    // are returned one by one.
     std::string receiveMessage() {
-        char buffer[4096];
-        ssize_t n = recv(sockfd_, buffer, sizeof(buffer) - 1, 0);
+        std::string message;
+        if (popMessage(message)) return message;
+        if (!open_) return "";
         
-        if (n <= 0) return "";
-        
-        // Parse WebSocket frame (simplified)
-        if (n < 2) return "";
-        
-        unsigned char frame_type = buffer[0];
-        unsigned char payload_len = buffer[1] & 0x7F;
-        
-        size_t offset = 2;
-        if (payload_len == 126) {
-            offset = 4;
-        } else if (payload_len == 127) {
-            offset = 10;
+        char buffer[4096];
+        ssize_t n = recv(sockfd_, buffer, sizeof(buffer), 0);
+        if (n < 0 && (wouldBlock() || interrupted())) return "";
+        if (n <= 0) {
+            open_ = false;  // Closed by the server, or reset
+            return "";
         }
         
-        std::string message(buffer + offset, n - offset);
+        recvBuffer_.append(buffer, n);
+        popMessage(message);
         return message;
     }
     
+    // False once the server closed the connection or it broke. A closed
+    // socket reads as ready at once, so the loop has to stop waiting on it.
+    bool isOpen() const { return open_; }
+    
     ~WebSocketClient() {
+        for (OutboundFrame* frame : inflight_) delete frame;
 #if defined(_WIN32) || defined(_WIN64)
         if (sockfd_ != INVALID_SOCKET) {
             closesocket(sockfd_);
@@ -955,7 +994,294 @@ public:
     }
     
 private:
+    static constexpr size_t MAX_BATCH_FRAMES = 32;  // Frames gathered into one send call
+    
     SocketType sockfd_ = INVALID_SOCKET_VALUE;
+    bool open_ = false;        // Reader only
+    std::string recvBuffer_;   // Bytes received but not yet parsed
+    std::string fragments_;    // Payload of an unfinished fragmented message
+    
+    OutboundQueue outbound_;
+    std::deque<OutboundFrame*> inflight_;   // Owned by the current writer
+    std::atomic<bool> writing_{false};
+    std::atomic<int> pendingFrames_{0};     // Queued or partially written
+    std::atomic<uint64_t> maskState_{std::random_device{}()};
+    
+    // Fresh masking key per frame (splitmix64 over an atomic counter)
+    uint32_t nextMaskKey() {
+        uint64_t z = maskState_.fetch_add(0x9E3779B97F4A7C15ull, std::memory_order_relaxed);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return static_cast<uint32_t>(z ^ (z >> 31));
+    }
+    
+    // XORs the payload with the 4-byte key eight bytes at a time
+    static void maskPayload(std::string& payload, const unsigned char mask[4]) {
+        unsigned char pattern[8] = {mask[0], mask[1], mask[2], mask[3],
+                                    mask[0], mask[1], mask[2], mask[3]};
+        uint64_t mask64;
+        std::memcpy(&mask64, pattern, 8);
+        
+        char* data = &payload[0];
+        size_t len = payload.size();
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            word ^= mask64;
+            std::memcpy(data + i, &word, 8);
+        }
+        for (; i < len; ++i) {
+            data[i] ^= mask[i % 4];
+        }
+    }
+    
+    // Writer only. Gathers queued frames into one scatter-gather send per
+    // batch, resuming partially written frames where they stopped. Returns
+    // false if the socket would block.
+    bool writePending() {
+        while (true) {
+            while (inflight_.size() < MAX_BATCH_FRAMES) {
+                OutboundFrame* frame = outbound_.pop();
+                if (!frame) break;
+                inflight_.push_back(frame);
+            }
+            if (inflight_.empty()) return true;
+            
+            long sent = sendBatch();
+            if (sent < 0) {
+                if (wouldBlock()) return false;
+                dropInflight();  // Connection is gone
+                return false;
+            }
+            
+            size_t remaining = static_cast<size_t>(sent);
+            while (!inflight_.empty()) {
+                OutboundFrame* frame = inflight_.front();
+                size_t left = frame->size() - frame->written;
+                if (remaining < left) {
+                    frame->written += remaining;
+                    break;
+                }
+                remaining -= left;
+                inflight_.pop_front();
+                delete frame;
+                pendingFrames_.fetch_sub(1, std::memory_order_release);
+            }
+        }
+    }
+    
+#if defined(_WIN32) || defined(_WIN64)
+    using IoBuffer = WSABUF;
+    static void setBuffer(IoBuffer& buf, const void* data, size_t len) {
+        buf.buf = const_cast<CHAR*>(static_cast<const CHAR*>(data));
+        buf.len = static_cast<ULONG>(len);
+    }
+#else
+    using IoBuffer = iovec;
+    static void setBuffer(IoBuffer& buf, const void* data, size_t len) {
+        buf.iov_base = const_cast<void*>(data);
+        buf.iov_len = len;
+    }
+#endif
+    
+    long sendBatch() {
+        IoBuffer bufs[MAX_BATCH_FRAMES * 2];
+        size_t count = 0;
+        for (OutboundFrame* frame : inflight_) {
+            if (frame->written < frame->headerLen) {
+                setBuffer(bufs[count++], frame->header + frame->written,
+                          frame->headerLen - frame->written);
+            }
+            size_t payloadOffset = frame->written > frame->headerLen ? frame->written - frame->headerLen : 0;
+            if (payloadOffset < frame->payload.size()) {
+                setBuffer(bufs[count++], frame->payload.data() + payloadOffset,
+                          frame->payload.size() - payloadOffset);
+            }
+        }
+        
+#if defined(_WIN32) || defined(_WIN64)
+        DWORD sent = 0;
+        if (WSASend(sockfd_, bufs, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) != 0) return -1;
+        return static_cast<long>(sent);
+#else
+        msghdr msg = {};
+        msg.msg_iov = bufs;
+        msg.msg_iovlen = count;
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags |= MSG_NOSIGNAL;  // A closed peer is reported as an error, not SIGPIPE
+#endif
+        ssize_t sent;
+        do {
+            sent = sendmsg(sockfd_, &msg, flags);
+        } while (sent < 0 && errno == EINTR);
+        return static_cast<long>(sent);
+#endif
+    }
+    
+    static bool wouldBlock() {
+#if defined(_WIN32) || defined(_WIN64)
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+    
+    static bool interrupted() {
+#if defined(_WIN32) || defined(_WIN64)
+        return WSAGetLastError() == WSAEINTR;
+#else
+        return errno == EINTR;
+#endif
+    }
+    
+    void dropInflight() {
+        for (OutboundFrame* frame : inflight_) {
+            delete frame;
+            pendingFrames_.fetch_sub(1, std::memory_order_release);
+        }
+        inflight_.clear();
+    }
+    
+    bool popMessage(std::string& message) {
+        while (recvBuffer_.size() >= 2) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(recvBuffer_.data());
+            bool fin = p[0] & 0x80;
+            unsigned char opcode = p[0] & 0x0F;
+            bool masked = p[1] & 0x80;
+            
+            size_t offset = 2;
+            uint64_t payloadLen = p[1] & 0x7F;
+            if (payloadLen == 126) {
+                if (recvBuffer_.size() < 4) return false;
+                payloadLen = (uint64_t(p[2]) << 8) | p[3];
+                offset = 4;
+            } else if (payloadLen == 127) {
+                if (recvBuffer_.size() < 10) return false;
+                payloadLen = 0;
+                for (int i = 0; i < 8; ++i) payloadLen = (payloadLen << 8) | p[2 + i];
+                offset = 10;
+            }
+            
+            size_t maskOffset = offset;
+            if (masked) offset += 4;
+            if (recvBuffer_.size() < offset + payloadLen) return false;  // Wait for the rest
+            
+            std::string payload = recvBuffer_.substr(offset, payloadLen);
+            if (masked) {
+                for (size_t i = 0; i < payload.size(); ++i) {
+                    payload[i] ^= recvBuffer_[maskOffset + (i % 4)];
+                }
+            }
+            recvBuffer_.erase(0, offset + payloadLen);
+            
+            if (opcode == 0x8) {
+                // Close: the server sends nothing after it
+                recvBuffer_.clear();
+                open_ = false;
+                return false;
+            }
+            if (opcode > 0x8) continue;  // Ping/pong carry no messages
+            
+            fragments_ += payload;
+            if (fin) {
+                message = std::move(fragments_);
+                fragments_.clear();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Lets the typing thread end the loop's wait early; the loop then picks up
+// whatever changed (credit to hand back, a finished run). A pipe on POSIX;
+// Windows select() only takes sockets, so a loopback socket pair there.
+// Windows needs WSAStartup() first, which WebSocketClient does.
+class LoopWaker {
+public:
+    using SocketType = WebSocketClient::SocketType;
+    
+    LoopWaker() {
+#if defined(_WIN32) || defined(_WIN64)
+        SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int addrLen = sizeof(addr);
+        if (listener != INVALID_SOCKET &&
+            bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+            listen(listener, 1) == 0 &&
+            getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrLen) == 0) {
+            writeEnd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (writeEnd_ != INVALID_SOCKET &&
+                ::connect(writeEnd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+                readEnd_ = accept(listener, nullptr, nullptr);
+            }
+        }
+        if (listener != INVALID_SOCKET) closesocket(listener);
+        
+        u_long mode = 1;
+        if (readEnd_ != INVALID_SOCKET) ioctlsocket(readEnd_, FIONBIO, &mode);
+        if (writeEnd_ != INVALID_SOCKET) ioctlsocket(writeEnd_, FIONBIO, &mode);
+#else
+        int fds[2];
+        if (pipe(fds) == 0) {
+            readEnd_ = fds[0];
+            writeEnd_ = fds[1];
+            fcntl(readEnd_, F_SETFL, O_NONBLOCK);
+            fcntl(writeEnd_, F_SETFL, O_NONBLOCK);
+        }
+#endif
+        if (readEnd_ == WebSocketClient::INVALID_SOCKET_VALUE) {
+            std::cerr << "Warning: No wakeup channel, the loop reacts to typing on its next timer\n";
+        }
+    }
+    
+    ~LoopWaker() {
+#if defined(_WIN32) || defined(_WIN64)
+        if (readEnd_ != INVALID_SOCKET) closesocket(readEnd_);
+        if (writeEnd_ != INVALID_SOCKET) closesocket(writeEnd_);
+#else
+        if (readEnd_ >= 0) close(readEnd_);
+        if (writeEnd_ >= 0) close(writeEnd_);
+#endif
+    }
+    
+    LoopWaker(const LoopWaker&) = delete;
+    LoopWaker& operator=(const LoopWaker&) = delete;
+    
+    // For the loop's select()
+    SocketType fd() const { return readEnd_; }
+    
+    // Any thread. One byte until the loop drains it, however often it's called.
+    void wake() {
+        if (pending_.exchange(true, std::memory_order_acq_rel)) return;
+        char byte = 1;
+#if defined(_WIN32) || defined(_WIN64)
+        send(writeEnd_, &byte, 1, 0);
+#else
+        ssize_t written = write(writeEnd_, &byte, 1);
+        (void)written;   // Full or gone: a wakeup is pending either way
+#endif
+    }
+    
+    // Loop only, after its wait and before it looks at what changed
+    void drain() {
+        pending_.store(false, std::memory_order_release);
+        char buffer[64];
+#if defined(_WIN32) || defined(_WIN64)
+        while (recv(readEnd_, buffer, sizeof(buffer), 0) > 0) {}
+#else
+        while (read(readEnd_, buffer, sizeof(buffer)) > 0) {}
+#endif
+    }
+    
+private:
+    SocketType readEnd_ = WebSocketClient::INVALID_SOCKET_VALUE;
+    SocketType writeEnd_ = WebSocketClient::INVALID_SOCKET_VALUE;
+    std::atomic<bool> pending_{false};
 };
 
 // ============================================================================
@@ -985,6 +1311,68 @@ std::string unescapeJsonString(const std::string& str) {
     return result;
 }
 
+// Finds "key":"..." in a flat message and returns the unescaped string value
+bool extractJsonString(const std::string& message, const std::string& key, std::string& out) {
+    std::string pattern = "\"" + key + "\":\"";
+    size_t pos = message.find(pattern);
+    if (pos == std::string::npos) return false;
+
+    size_t start = pos + pattern.length();
+    size_t end = start;
+    while (end < message.length() && message[end] != '"') {
+        end += (message[end] == '\\') ? 2 : 1;  // Skip escaped characters
+    }
+    end = std::min(end, message.length());
+
+    out = unescapeJsonString(message.substr(start, end - start));
+    return true;
+}
+
+int extractJsonInt(const std::string& message, const std::string& key, int defaultValue) {
+    std::string pattern = "\"" + key + "\":";
+    size_t pos = message.find(pattern);
+    if (pos == std::string::npos) return defaultValue;
+
+    size_t numStart = pos + pattern.length();
+    size_t numEnd = message.find_first_of(",}", numStart);
+    if (numEnd == std::string::npos) return defaultValue;
+
+    try {
+        return std::stoi(message.substr(numStart, numEnd - numStart));
+    } catch (...) {
+        return defaultValue;
+    }
+}
+
+bool extractJsonBool(const std::string& message, const std::string& key, bool defaultValue) {
+    std::string pattern = "\"" + key + "\":";
+    size_t pos = message.find(pattern);
+    if (pos == std::string::npos) return defaultValue;
+    return message.compare(pos + pattern.length(), 4, "true") == 0;
+}
+
+// Applies the settings object shared by start_typing and start_stream
+void applySettings(const std::string& message, TypingEngine& engine, std::atomic<bool>& scrollEnabled) {
+    int minDelay = extractJsonInt(message, "minDelay", 120);
+    int maxDelay = extractJsonInt(message, "maxDelay", 2000);
+    std::cout << "Using delay range: " << minDelay << "ms - " << maxDelay << "ms\n";
+    engine.setDelayRange(minDelay, maxDelay);
+
+    bool mouseMovement = extractJsonBool(message, "mouseMovement", false);
+    engine.setMouseMovementEnabled(mouseMovement);
+    std::cout << "Mouse movement: " << (mouseMovement ? "enabled" : "disabled") << "\n";
+
+    if (message.find("\"idleScroll\":") != std::string::npos) {
+        if (extractJsonBool(message, "idleScroll", false)) {
+            scrollEnabled.store(true);
+            std::cout << "Idle scrolling: enabled (30s delay)\n";
+        } else {
+            scrollEnabled.store(false);
+            std::cout << "Idle scrolling: disabled\n";
+        }
+    }
+}
+
 // ============================================================================
 // Main
 // ============================================================================
@@ -1005,151 +1393,174 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Send ready message
-    ws.sendMessage(R"({"type":"ready"})");
+    // Send ready message; we take start_stream as well as start_typing
+    ws.sendMessage(R"({"type":"ready","streaming":true})");
     
     TypingEngine engine;
     MouseSimulator mouseSim;
-    std::atomic<bool> shouldStop(false);
+    TextStream stream;
+    ProgressReporter progress;
+    engine.setProgressReporter(&progress);
+    if (const char* home = std::getenv("HOME")) {
+        engine.setSessionPath(std::string(home) + "/.qtype-session");
+    }
+    LoopWaker waker;
+    stream.setNotifier([&waker] { waker.wake(); });
+    qtype::CancellationToken stop;
     std::atomic<bool> isBusy(false);
+    std::thread typist;     // Joined before the next run and at exit
     std::atomic<bool> scrollEnabled(false);  // Enable via command or startup
     
-    // Idle scroll thread - runs independently
-    std::thread idleScrollThread([&mouseSim, &scrollEnabled]() {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    // Timers run from the message loop below, which sleeps in select()
+    // until the next one is due, the server writes or the typing thread
+    // wakes it
+    qtype::EventTimers timers;
+    qtype::TimingWheel::Timer idleScroll;
+    idleScroll.callback = [&]() {
+        timers.start(idleScroll, 1000);
+        if (!scrollEnabled.load()) return;
+        
+        int64_t idleMs = IdleDetector::getIdleTimeMs();
+        
+        // If idle for more than 30 seconds, scroll
+        if (idleMs >= 30000) {
+            int amount = RandomGenerator::range(TypingConstants::MIN_SCROLL_AMOUNT,
+                                                TypingConstants::MAX_SCROLL_AMOUNT);
             
-            if (!scrollEnabled.load()) continue;
-            
-            int64_t idleMs = IdleDetector::getIdleTimeMs();
-            
-            // If idle for more than 30 seconds, scroll
-            if (idleMs >= 30000) {
-                int amount = RandomGenerator::range(TypingConstants::MIN_SCROLL_AMOUNT,
-                                                    TypingConstants::MAX_SCROLL_AMOUNT);
-                
-                // 80% chance to scroll down, 20% to scroll up
-                if (RandomGenerator::uniform() > TypingConstants::SCROLL_DOWN_PROBABILITY) {
-                    amount = -amount;
-                }
-                
-                mouseSim.scroll(amount);
+            // 80% chance to scroll down, 20% to scroll up
+            if (RandomGenerator::uniform() > TypingConstants::SCROLL_DOWN_PROBABILITY) {
+                amount = -amount;
             }
+            
+            mouseSim.scroll(amount);
+        }
+    };
+    timers.start(idleScroll, 1000);
+    
+    // Latest typing position while a run lasts. If the socket is backed up
+    // the report waits and newer positions replace it.
+    const int progressIntervalMs = 1000 / TypingConstants::MAX_PROGRESS_REPORTS_PER_SEC;
+    qtype::TimingWheel::Timer progressReport;
+    progressReport.callback = [&]() {
+        if (!isBusy) return;     // Run over; the next start arms it again
+        timers.start(progressReport, progressIntervalMs);
+        std::string report;
+        if (!ws.isBackedUp() && progress.poll(report)) {
+            ws.sendMessage(report);
         }
-    });
-    idleScrollThread.detach();
+    };
 
     std::cout << "Client ready. Waiting for commands from server...\n";
     std::cout << "Press Ctrl+C to exit\n\n";
     
     while (true) {
+        timers.run();
+        
+        // Hand consumed stream slots back to the server
+        int credits = stream.takeCredits();
+        if (credits > 0) {
+            ws.sendMessage("{\"type\":\"credit\",\"stream\":" + std::to_string(stream.id()) +
+                           ",\"credits\":" + std::to_string(credits) + "}");
+        }
+        
+        // Finish frames a full socket left behind
+        ws.flush();
+        
         std::string message = ws.receiveMessage();
         
-        if (!message.empty()) {
-            std::cout << "Received: " << message << "\n";
-            
-            // Parse JSON (simplified - use real JSON library)
-            if (message.find("\"type\":\"start_typing\"") != std::string::npos) {
-                // Check if already busy
-                if (isBusy) {
-                    std::cout << "Client is busy, ignoring command\n";
-                    continue;
-                }
-
-                // Extract text (very basic parsing)
-                size_t textPos = message.find("\"text\":\"");
-                if (textPos != std::string::npos) {
-                    size_t start = textPos + 8;
-                    size_t end = message.find("\"", start);
-
-                    // Handle escaped quotes within the text
-                    while (end != std::string::npos && end > 0 && message[end - 1] == '\\') {
-                        end = message.find("\"", end + 1);
-                    }
+        if (!ws.isOpen()) {
+            std::cout << "Connection to server lost\n";
+            break;
+        }
+        
+        if (message.empty()) {
+            ws.wait(timers.msUntilNextRun(), waker.fd());
+            waker.drain();
+            continue;
+        }
+        
+        // Parse JSON (simplified - use real JSON library)
+        if (message.find("\"type\":\"text_chunk\"") != std::string::npos) {
+            std::string text;
+            extractJsonString(message, "text", text);
+            stream.push(extractJsonInt(message, "stream", -1),
+                        extractJsonInt(message, "seq", -1),
+                        std::move(text),
+                        extractJsonBool(message, "final", false));
+            continue;  // Chunks arrive often, don't echo them
+        }
+        
+        std::cout << "Received: " << message << "\n";
+        
+        if (message.find("\"type\":\"start_typing\"") != std::string::npos) {
+            // Check if already busy
+            if (isBusy) {
+                std::cout << "Client is busy, ignoring command\n";
+                continue;
+            }
 
-                    std::string rawText = message.substr(start, end - start);
-                    std::string text = unescapeJsonString(rawText);
+            std::string text;
+            if (extractJsonString(message, "text", text)) {
+                std::cout << "Text to type: " << text.length() << " characters\n";
+                applySettings(message, engine, scrollEnabled);
+                progress.begin(text.length());
 
-                    std::cout << "Text to type: " << text.length() << " characters\n";
+                // Reset stop token and set busy state
+                stop.reset();
+                isBusy = true;
+                ws.sendMessage(R"({"type":"status","status":"busy"})");
+                timers.start(progressReport, progressIntervalMs);
 
-                    // Extract settings (minDelay and maxDelay)
-                    int minDelay = 120;  // defaults
-                    int maxDelay = 2000;
-                    
-                    size_t minDelayPos = message.find("\"minDelay\":");
-                    if (minDelayPos != std::string::npos) {
-                        size_t numStart = minDelayPos + 11;
-                        size_t numEnd = message.find_first_of(",}", numStart);
-                        if (numEnd != std::string::npos) {
-                            std::string minDelayStr = message.substr(numStart, numEnd - numStart);
-                            try {
-                                minDelay = std::stoi(minDelayStr);
-                            } catch (...) {}
-                        }
-                    }
-                    
-                    size_t maxDelayPos = message.find("\"maxDelay\":");
-                    if (maxDelayPos != std::string::npos) {
-                        size_t numStart = maxDelayPos + 11;
-                        size_t numEnd = message.find_first_of(",}", numStart);
-                        if (numEnd != std::string::npos) {
-                            std::string maxDelayStr = message.substr(numStart, numEnd - numStart);
-                            try {
-                                maxDelay = std::stoi(maxDelayStr);
-                            } catch (...) {}
-                        }
-                    }
-                    
-                    std::cout << "Using delay range: " << minDelay << "ms - " << maxDelay << "ms\n";
-                    engine.setDelayRange(minDelay, maxDelay);
+                // Start typing in separate thread
+                if (typist.joinable()) typist.join();
+                typist = std::thread([&engine, text, &stop, &ws, &isBusy, &waker]() {
+                    engine.typeText(text, stop);
+                    // Mark as free and notify server
+                    isBusy = false;
+                    ws.sendMessage(R"({"type":"status","status":"free"})");
+                    waker.wake();
+                });
+            }
+        }
+        else if (message.find("\"type\":\"start_stream\"") != std::string::npos) {
+            if (isBusy) {
+                std::cout << "Client is busy, ignoring command\n";
+                continue;
+            }
 
-                    // Extract mouse movement setting
-                    bool mouseMovement = false;
-                    size_t mousePos = message.find("\"mouseMovement\":");
-                    if (mousePos != std::string::npos) {
-                        size_t boolStart = mousePos + 16;
-                        if (message.substr(boolStart, 4) == "true") {
-                            mouseMovement = true;
-                        }
-                    }
-                    engine.setMouseMovementEnabled(mouseMovement);
-                    std::cout << "Mouse movement: " << (mouseMovement ? "enabled" : "disabled") << "\n";
-                    
-                    // Extract idle scroll setting
-                    size_t scrollPos = message.find("\"idleScroll\":");
-                    if (scrollPos != std::string::npos) {
-                        size_t boolStart = scrollPos + 13;
-                        if (message.substr(boolStart, 4) == "true") {
-                            scrollEnabled.store(true);
-                            std::cout << "Idle scrolling: enabled (30s delay)\n";
-                        } else {
-                            scrollEnabled.store(false);
-                            std::cout << "Idle scrolling: disabled\n";
-                        }
-                    }
+            int streamId = extractJsonInt(message, "stream", 0);
+            int totalLength = extractJsonInt(message, "totalLength", 0);
+            std::cout << "Streaming text: " << totalLength << " characters\n";
+            applySettings(message, engine, scrollEnabled);
 
-                    // Reset stop flag and set busy state
-                    shouldStop = false;
-                    isBusy = true;
-                    ws.sendMessage(R"({"type":"status","status":"busy"})");
+            stream.begin(streamId, totalLength);
+            progress.begin(totalLength);
+            stop.reset();
+            isBusy = true;
+            ws.sendMessage(R"({"type":"status","status":"busy"})");
+            ws.sendMessage("{\"type\":\"credit\",\"stream\":" + std::to_string(streamId) +
+                           ",\"credits\":" + std::to_string(TypingConstants::STREAM_WINDOW_CHUNKS) + "}");
+            timers.start(progressReport, progressIntervalMs);
 
-                    // Start typing in separate thread
-                    std::thread([&engine, text, &shouldStop, &ws, &isBusy]() {
-                        engine.typeText(text, shouldStop);
-                        // Mark as free and notify server
-                        isBusy = false;
-                        ws.sendMessage(R"({"type":"status","status":"free"})");
-                    }).detach();
-                }
-            }
-            else if (message.find("\"type\":\"stop_typing\"") != std::string::npos) {
-                shouldStop = true;
-                std::cout << "Stop command received\n";
-            }
+            if (typist.joinable()) typist.join();
+            typist = std::thread([&engine, &stream, &stop, &ws, &isBusy, &waker]() {
+                engine.typeStream(stream, stop);
+                isBusy = false;
+                ws.sendMessage(R"({"type":"status","status":"free"})");
+                waker.wake();
+            });
+        }
+        else if (message.find("\"type\":\"stop_typing\"") != std::string::npos) {
+            stop.cancel();
+            stream.cancel();
+            std::cout << "Stop command received\n";
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
-    return 0;
+    // Nobody is left to stop a run or feed its stream; end it before the
+    // objects it types with go away
+    stop.cancel();
+    stream.cancel();
+    if (typist.joinable()) typist.join();
+    return 1;
 }
@@ -13,7 +13,8 @@
 #include <QGroupBox>
 #include <QComboBox>
 #include <QCheckBox>
-#include <QListWidget>
+#include <QListView>
+#include <QAbstractListModel>
 #include <QWebSocketServer>
 #include <QWebSocket>
 #include <QJsonDocument>
@@ -22,6 +23,277 @@
 #include <QTimer>
 #include <QNetworkInterface>
 #include <QMessageBox>
+#include <QElapsedTimer>
+#include <vector>
+#include <cstdint>
+
+// Text streaming: documents are sent as a start_stream message carrying the
+// settings, followed by sequenced text_chunk messages. The client grants
+// chunks with credit messages, so it can start typing after the first chunk
+// and never buffers more than its window. Only clients that announce
+// "streaming" in their ready message get streams; others get start_typing.
+namespace StreamConstants {
+    constexpr int CHUNK_CHARS = 512;
+}
+
+struct OutgoingStream {
+    quint32 id = 0;     // 0 = no stream in progress
+    QString text;
+    int offset = 0;
+    int seq = 0;
+    int credits = 0;
+};
+
+// ============================================================================
+// Connection Table
+// ============================================================================
+
+// Stable handle for a connection: slot index plus generation. Once a client
+// disconnects its generation is bumped, so stale ids never resolve to the
+// client that later reuses the slot.
+struct ClientId {
+    quint32 index = 0;
+    quint32 generation = 0;     // 0 = invalid, live slots start at 1
+
+    bool isValid() const { return generation != 0; }
+    quint64 toKey() const { return (quint64(generation) << 32) | index; }
+    static ClientId fromKey(quint64 key) { return {quint32(key), quint32(key >> 32)}; }
+
+    bool operator==(const ClientId &other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const ClientId &other) const { return !(*this == other); }
+};
+
+struct ClientRecord {
+    ClientId id;
+    QWebSocket *socket = nullptr;
+    QString address;    // "ip:port", formatted once on connect
+    bool busy = false;
+    bool canStream = false;     // Announced in its ready message
+    int progress = 0;
+    int typed = 0;              // Characters typed, from the last progress report
+    double charsPerSec = 0.0;   // Smoothed over progress reports
+    QElapsedTimer sinceReport;  // Monotonic, so a wall-clock step can't skew the rate
+    OutgoingStream stream;
+};
+
+// Slot map of connected clients. Records live densely in a vector (removal
+// swaps the last record into the hole) and slots map ids to dense positions,
+// so insert, lookup, remove and the busy toggle are all O(1).
+class ConnectionTable {
+public:
+    ClientId insert(QWebSocket *socket, const QString &address) {
+        quint32 index;
+        if (freeHead_ != NO_SLOT) {
+            index = freeHead_;
+            freeHead_ = slots_[index].nextFree;
+        } else {
+            index = static_cast<quint32>(slots_.size());
+            slots_.push_back(Slot());
+        }
+
+        Slot &slot = slots_[index];
+        slot.dense = static_cast<quint32>(records_.size());
+
+        ClientRecord record;
+        record.id = {index, slot.generation};
+        record.socket = socket;
+        record.address = address;
+        records_.push_back(record);
+        return record.id;
+    }
+
+    bool remove(ClientId id) {
+        Slot *slot = resolve(id);
+        if (!slot) return false;
+
+        quint32 dense = slot->dense;
+        if (records_[dense].busy) busyCount_--;
+        if (dense + 1 != records_.size()) {
+            records_[dense] = std::move(records_.back());
+            slots_[records_[dense].id.index].dense = dense;
+        }
+        records_.pop_back();
+
+        slot->generation = (slot->generation == UINT32_MAX) ? 1 : slot->generation + 1;
+        slot->nextFree = freeHead_;
+        freeHead_ = id.index;
+        return true;
+    }
+
+    ClientRecord *find(ClientId id) {
+        Slot *slot = resolve(id);
+        return slot ? &records_[slot->dense] : nullptr;
+    }
+
+    const ClientRecord *find(ClientId id) const {
+        return const_cast<ConnectionTable*>(this)->find(id);
+    }
+
+    // Dense position of a client, which is also its row in the list view
+    int rowOf(ClientId id) const {
+        const ClientRecord *record = find(id);
+        return record ? static_cast<int>(record - records_.data()) : -1;
+    }
+
+    // Returns true if the flag actually changed
+    bool setBusy(ClientId id, bool busy) {
+        ClientRecord *record = find(id);
+        if (!record || record->busy == busy) return false;
+        record->busy = busy;
+        busyCount_ += busy ? 1 : -1;
+        return true;
+    }
+
+    const ClientRecord &at(int row) const { return records_[row]; }
+    int size() const { return static_cast<int>(records_.size()); }
+    bool isEmpty() const { return records_.empty(); }
+    int busyCount() const { return busyCount_; }
+    int freeCount() const { return size() - busyCount_; }
+
+    std::vector<ClientRecord>::iterator begin() { return records_.begin(); }
+    std::vector<ClientRecord>::iterator end() { return records_.end(); }
+
+private:
+    static constexpr quint32 NO_SLOT = UINT32_MAX;
+
+    struct Slot {
+        quint32 generation = 1;
+        quint32 dense = 0;
+        quint32 nextFree = NO_SLOT;
+    };
+
+    Slot *resolve(ClientId id) {
+        if (id.index >= slots_.size()) return nullptr;
+        Slot &slot = slots_[id.index];
+        return slot.generation == id.generation ? &slot : nullptr;
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<ClientRecord> records_;
+    quint32 freeHead_ = NO_SLOT;
+    int busyCount_ = 0;
+};
+
+// ============================================================================
+// Client List Model
+// ============================================================================
+
+// List view over the connection table; rows are the table's dense order.
+// Status changes update a single row instead of rebuilding the whole list.
+class ClientListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum Roles {
+        ClientIdRole = Qt::UserRole + 1
+    };
+
+    using QAbstractListModel::QAbstractListModel;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : table_.size();
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override {
+        if (!index.isValid() || index.row() >= rowCount()) {
+            return QVariant();
+        }
+        const ClientRecord &record = table_.at(index.row());
+        if (role == ClientIdRole) {
+            return QVariant::fromValue(record.id.toKey());
+        }
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        if (!record.busy) {
+            return QString("🟢 %1").arg(record.address);
+        }
+        return QString("🔴 %1  %2%  %3 chars/s")
+            .arg(record.address)
+            .arg(record.progress)
+            .arg(record.charsPerSec, 0, 'f', 1);
+    }
+
+    ClientId addClient(QWebSocket *socket, const QString &address) {
+        int row = rowCount();
+        beginInsertRows(QModelIndex(), row, row);
+        ClientId id = table_.insert(socket, address);
+        endInsertRows();
+        return id;
+    }
+
+    // The table fills the hole with its last record, so to the view this is
+    // "last row removed, removed row changed". Callers that track a selected
+    // client should reselect it by id afterwards.
+    void removeClient(ClientId id) {
+        int row = table_.rowOf(id);
+        if (row < 0) return;
+
+        int last = rowCount() - 1;
+        beginRemoveRows(QModelIndex(), last, last);
+        table_.remove(id);
+        endRemoveRows();
+        if (row < rowCount()) {
+            emit dataChanged(index(row), index(row), {Qt::DisplayRole, ClientIdRole});
+        }
+    }
+
+    void setBusy(ClientId id, bool busy) {
+        if (!table_.setBusy(id, busy)) return;
+        ClientRecord *record = table_.find(id);
+        record->progress = 0;
+        record->typed = 0;
+        record->charsPerSec = 0.0;
+        record->sinceReport.start();
+        notifyChanged(id);
+    }
+
+    void setProgress(ClientId id, int progress, int typed) {
+        ClientRecord *record = table_.find(id);
+        if (!record) return;
+
+        // Rate from the characters typed since the previous report
+        qint64 elapsedMs = record->sinceReport.isValid() ? record->sinceReport.restart() : 0;
+        if (!record->sinceReport.isValid()) record->sinceReport.start();
+        if (typed > record->typed && elapsedMs > 0) {
+            double rate = (typed - record->typed) * 1000.0 / elapsedMs;
+            record->charsPerSec = record->charsPerSec > 0.0
+                ? 0.7 * record->charsPerSec + 0.3 * rate
+                : rate;
+        }
+        record->typed = typed;
+
+        record->progress = progress;
+        notifyChanged(id);
+    }
+
+    ClientId idAt(const QModelIndex &index) const {
+        if (!index.isValid() || index.row() >= rowCount()) return ClientId();
+        return table_.at(index.row()).id;
+    }
+
+    QModelIndex indexOf(ClientId id) const {
+        int row = table_.rowOf(id);
+        return row >= 0 ? index(row) : QModelIndex();
+    }
+
+    ConnectionTable &table() { return table_; }
+    const ConnectionTable &table() const { return table_; }
+
+private:
+    void notifyChanged(ClientId id) {
+        int row = table_.rowOf(id);
+        emit dataChanged(index(row), index(row), {Qt::DisplayRole});
+    }
+
+    ConnectionTable table_;
+};
+
+// ============================================================================
+// Server Window
+// ============================================================================
 
 class QTypeServer : public QMainWindow {
     Q_OBJECT
@@ -42,13 +314,12 @@ public:
         }
 
         // Disconnect and clean up all clients
-        for (QWebSocket *client : clients_) {
-            if (client) {
-                disconnect(client, nullptr, this, nullptr);
-                client->close(QWebSocketProtocol::CloseCodeNormal, "Server shutting down");
+        for (ClientRecord &record : clientModel_->table()) {
+            if (record.socket) {
+                disconnect(record.socket, nullptr, this, nullptr);
+                record.socket->close(QWebSocketProtocol::CloseCodeNormal, "Server shutting down");
             }
         }
-        clients_.clear();
 
         if (wsServer_) {
             wsServer_->close();
@@ -59,42 +330,60 @@ private slots:
     void onNewConnection() {
         QWebSocket *client = wsServer_->nextPendingConnection();
         
-        connect(client, &QWebSocket::textMessageReceived, this, &QTypeServer::onMessageReceived);
-        connect(client, &QWebSocket::disconnected, this, &QTypeServer::onClientDisconnected);
+        QString clientInfo = QString("%1:%2").arg(client->peerAddress().toString()).arg(client->peerPort());
+        ClientId id = clientModel_->addClient(client, clientInfo);  // Starts out free
+        
+        // Handlers get the stable id directly instead of looking up sender()
+        connect(client, &QWebSocket::textMessageReceived, this, [this, id](const QString &message) {
+            onMessageReceived(id, message);
+        });
+        connect(client, &QWebSocket::disconnected, this, [this, id]() {
+            onClientDisconnected(id);
+        });
         
-        clients_.append(client);
-        clientBusyState_[client] = false;  // Initialize as free
-        updateClientList();
+        updateButtonState();
 
-        QString clientInfo = QString("%1:%2").arg(client->peerAddress().toString()).arg(client->peerPort());
         statusLabel_->setText(QString("Client connected: %1").arg(clientInfo));
         
         // Send welcome message
         QJsonObject welcome;
         welcome["type"] = "welcome";
         welcome["message"] = "Connected to qtype server";
+        welcome["clientId"] = QString::number(id.toKey());
         client->sendTextMessage(QJsonDocument(welcome).toJson(QJsonDocument::Compact));
     }
     
-    void onClientDisconnected() {
+    void onClientDisconnected(ClientId id) {
         // Don't process disconnections during destruction
         if (isDestroying_) {
             return;
         }
 
-        QWebSocket *client = qobject_cast<QWebSocket*>(sender());
-        if (client) {
-            QString clientInfo = QString("%1:%2").arg(client->peerAddress().toString()).arg(client->peerPort());
-            clients_.removeAll(client);
-            clientBusyState_.remove(client);  // Remove busy state tracking
-            client->deleteLater();
-            updateClientList();
-            statusLabel_->setText(QString("Client disconnected: %1").arg(clientInfo));
+        ClientRecord *record = clientModel_->table().find(id);
+        if (!record) {
+            return;
         }
+
+        QString clientInfo = record->address;
+        record->socket->deleteLater();
+
+        ClientId selected = selectedClientId();
+        clientModel_->removeClient(id);
+        if (selected.isValid() && selected != id) {
+            clientList_->setCurrentIndex(clientModel_->indexOf(selected));
+        } else {
+            clientList_->setCurrentIndex(QModelIndex());
+        }
+
+        updateButtonState();
+        statusLabel_->setText(QString("Client disconnected: %1").arg(clientInfo));
     }
     
-    void onMessageReceived(const QString &message) {
-        QWebSocket *client = qobject_cast<QWebSocket*>(sender());
+    void onMessageReceived(ClientId id, const QString &message) {
+        ClientRecord *record = clientModel_->table().find(id);
+        if (!record) {
+            return;
+        }
         
         QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
         QJsonObject obj = doc.object();
@@ -106,30 +395,45 @@ private slots:
             QString status = obj["status"].toString();
             int progress = obj["progress"].toInt();
 
-            QString clientInfo = QString("%1:%2").arg(client->peerAddress().toString()).arg(client->peerPort());
+            QString clientInfo = record->address;
 
             // Update busy state
             if (status == "busy") {
-                clientBusyState_[client] = true;
+                clientModel_->setBusy(id, true);
                 statusLabel_->setText(QString("%1 - Typing started").arg(clientInfo));
             } else if (status == "free") {
-                clientBusyState_[client] = false;
+                record->stream = OutgoingStream();  // Finished or stopped, drop unsent text
+                clientModel_->setBusy(id, false);
                 statusLabel_->setText(QString("%1 - Completed").arg(clientInfo));
+            } else if (status == "progress") {
+                // Periodic report while typing (a few per second per client):
+                // only the client's row is repainted
+                clientModel_->setProgress(id, progress, obj["typed"].toInt());
+                return;
             } else {
                 // General status update with progress
+                clientModel_->setProgress(id, progress, record->typed);
                 statusLabel_->setText(QString("%1 - %2 (%3%)").arg(clientInfo).arg(status).arg(progress));
             }
 
-            updateClientList();
             updateButtonState();
         }
         else if (type == "ready") {
+            record->canStream = obj["streaming"].toBool();
             statusLabel_->setText("Client is ready");
         }
+        else if (type == "credit") {
+            // Client has room for more chunks of the current stream
+            OutgoingStream &stream = record->stream;
+            if (stream.id != 0 && stream.id == static_cast<quint32>(obj["stream"].toInt())) {
+                stream.credits += qMax(0, obj["credits"].toInt());
+                pumpStream(*record);
+            }
+        }
     }
     
     void startTyping() {
-        if (clients_.isEmpty()) {
+        if (clientModel_->table().isEmpty()) {
             statusLabel_->setText("Error: No clients connected!");
             return;
         }
@@ -193,20 +497,40 @@ private slots:
         settings["mouseMovement"] = mouseCheck_->isChecked();
         settings["idleScroll"] = scrollCheck_->isChecked();
         
-        // Create command
-        QJsonObject command;
-        command["type"] = "start_typing";
-        command["text"] = text;
-        command["settings"] = settings;
-        
-        QString json = QJsonDocument(command).toJson(QJsonDocument::Compact);
+        // Whole-text command, for clients that don't stream; built once
+        // and only if someone needs it
+        bool streaming = streamCheck_->isChecked();
+        QString json;
+        auto wholeTextCommand = [&]() -> const QString & {
+            if (json.isEmpty()) {
+                QJsonObject command;
+                command["type"] = "start_typing";
+                command["text"] = text;
+                command["settings"] = settings;
+                json = QString(QJsonDocument(command).toJson(QJsonDocument::Compact));
+            }
+            return json;
+        };
+
+        // The client is busy from here on. Waiting for its own busy status
+        // leaves a window where a second Start reaches it: the client ignores
+        // that start while the server replaces the stream it is still
+        // granting credit for, and both sides wait. Its free status clears it,
+        // so a client that doesn't know start_stream is never sent one.
+        auto sendCommand = [&](ClientRecord &client) {
+            if (streaming && client.canStream) {
+                beginStream(client, text, settings);
+            } else {
+                client.socket->sendTextMessage(wholeTextCommand());
+            }
+            clientModel_->setBusy(client.id, true);
+        };
 
         // Send to selected client or all free clients
-        int selectedRow = clientList_->currentRow();
-        if (selectedRow >= 0 && selectedRow < clients_.size()) {
-            QWebSocket *selectedClient = clients_[selectedRow];
-            if (!clientBusyState_.value(selectedClient, false)) {
-                selectedClient->sendTextMessage(json);
+        ClientRecord *selectedClient = clientModel_->table().find(selectedClientId());
+        if (selectedClient) {
+            if (!selectedClient->busy && selectedClient->stream.id == 0) {
+                sendCommand(*selectedClient);
                 statusLabel_->setText("Command sent to selected client");
                 stopButton_->setEnabled(true);
             } else {
@@ -215,9 +539,9 @@ private slots:
         } else {
             // Send to all free clients
             int sentCount = 0;
-            for (QWebSocket *client : clients_) {
-                if (!clientBusyState_.value(client, false)) {
-                    client->sendTextMessage(json);
+            for (ClientRecord &client : clientModel_->table()) {
+                if (!client.busy && client.stream.id == 0) {
+                    sendCommand(client);
                     sentCount++;
                 }
             }
@@ -228,6 +552,7 @@ private slots:
                 statusLabel_->setText("Error: All clients are busy!");
             }
         }
+        updateButtonState();
     }
     
     void stopTyping() {
@@ -236,8 +561,9 @@ private slots:
         
         QString json = QJsonDocument(command).toJson(QJsonDocument::Compact);
         
-        for (QWebSocket *client : clients_) {
-            client->sendTextMessage(json);
+        for (ClientRecord &client : clientModel_->table()) {
+            client.socket->sendTextMessage(json);
+            client.stream = OutgoingStream();
         }
         
         startButton_->setEnabled(true);
@@ -263,7 +589,10 @@ private:
         // Client list
         QGroupBox *clientGroup = new QGroupBox("Connected Clients");
         QVBoxLayout *clientLayout = new QVBoxLayout(clientGroup);
-        clientList_ = new QListWidget(this);
+        clientModel_ = new ClientListModel(this);
+        clientList_ = new QListView(this);
+        clientList_->setModel(clientModel_);
+        clientList_->setUniformItemSizes(true);
         clientList_->setMaximumHeight(100);
         clientLayout->addWidget(new QLabel("Select target client (or send to all):"));
         clientLayout->addWidget(clientList_);
@@ -379,6 +708,16 @@ private:
         scrollLayout->addWidget(scrollCheck_);
         mainLayout->addWidget(scrollGroup);
         
+        // Transfer option
+        QGroupBox *transferGroup = new QGroupBox("Transfer", this);
+        QHBoxLayout *transferLayout = new QHBoxLayout(transferGroup);
+        streamCheck_ = new QCheckBox("Stream text in chunks", this);
+        streamCheck_->setChecked(true);
+        streamCheck_->setToolTip("Clients start typing after the first chunk instead of waiting for the whole text.\n"
+                                 "Older clients that don't announce streaming get the whole text at once.");
+        transferLayout->addWidget(streamCheck_);
+        mainLayout->addWidget(transferGroup);
+        
         // Text edit
         textEdit_ = new QPlainTextEdit(this);
         textEdit_->setPlaceholderText("Paste your text here... It will be sent to the selected client for typing.");
@@ -417,21 +756,67 @@ private:
         }
     }
     
-    void updateClientList() {
-        clientList_->clear();
-        for (QWebSocket *client : clients_) {
-            QString info = QString("%1:%2").arg(client->peerAddress().toString()).arg(client->peerPort());
-            bool isBusy = clientBusyState_.value(client, false);
-            QString icon = isBusy ? "🔴" : "🟢";  // Red for busy, green for free
-            QString displayText = QString("%1 %2").arg(icon).arg(info);
-            clientList_->addItem(displayText);
+    void beginStream(ClientRecord &client, const QString &text, const QJsonObject &settings) {
+        OutgoingStream &stream = client.stream;
+        stream = OutgoingStream();
+        stream.id = nextStreamId_++;
+        stream.text = text;
+
+        // Settings go first; chunks follow once the client grants credit
+        QJsonObject command;
+        command["type"] = "start_stream";
+        command["stream"] = static_cast<int>(stream.id);
+        command["totalLength"] = text.toUtf8().size();     // The client counts UTF-8 bytes
+        command["settings"] = settings;
+        client.socket->sendTextMessage(QJsonDocument(command).toJson(QJsonDocument::Compact));
+    }
+
+    void pumpStream(ClientRecord &client) {
+        OutgoingStream &stream = client.stream;
+
+        while (stream.credits > 0 && stream.offset < stream.text.length()) {
+            int length = nextChunkLength(stream.text, stream.offset);
+            bool isFinal = stream.offset + length >= stream.text.length();
+
+            QJsonObject chunk;
+            chunk["type"] = "text_chunk";
+            chunk["stream"] = static_cast<int>(stream.id);
+            chunk["seq"] = stream.seq++;
+            chunk["text"] = stream.text.mid(stream.offset, length);
+            chunk["final"] = isFinal;
+            client.socket->sendTextMessage(QJsonDocument(chunk).toJson(QJsonDocument::Compact));
+
+            stream.offset += length;
+            stream.credits--;
         }
 
-        updateButtonState();
+        if (stream.offset >= stream.text.length()) {
+            stream = OutgoingStream();  // Everything sent
+        }
+    }
+
+    // Length of the chunk starting at offset. Prefers to end just after
+    // whitespace so words aren't split across frames, and never splits a
+    // surrogate pair.
+    static int nextChunkLength(const QString &text, int offset) {
+        int remaining = text.length() - offset;
+        if (remaining <= StreamConstants::CHUNK_CHARS) return remaining;
+
+        for (int len = StreamConstants::CHUNK_CHARS; len > StreamConstants::CHUNK_CHARS / 2; --len) {
+            if (text[offset + len - 1].isSpace()) return len;
+        }
+
+        int len = StreamConstants::CHUNK_CHARS;
+        if (text[offset + len - 1].isHighSurrogate()) len--;
+        return len;
+    }
+
+    ClientId selectedClientId() const {
+        return clientModel_->idAt(clientList_->currentIndex());
     }
 
     void updateButtonState() {
-        if (clients_.isEmpty()) {
+        if (clientModel_->table().isEmpty()) {
             startButton_->setEnabled(false);
             stopButton_->setEnabled(false);
             if (statusLabel_->text().isEmpty() || statusLabel_->text() == "Client is ready") {
@@ -440,19 +825,8 @@ private:
         } else {
             // Enable start button if at least one client is free
             // Enable stop button if at least one client is busy
-            bool anyFree = false;
-            bool anyBusy = false;
-            for (QWebSocket *client : clients_) {
-                bool isBusy = clientBusyState_.value(client, false);
-                if (isBusy) {
-                    anyBusy = true;
-                } else {
-                    anyFree = true;
-                }
-                if (anyFree && anyBusy) break;  // Found both, no need to continue
-            }
-            startButton_->setEnabled(anyFree);
-            stopButton_->setEnabled(anyBusy);
+            startButton_->setEnabled(clientModel_->table().freeCount() > 0);
+            stopButton_->setEnabled(clientModel_->table().busyCount() > 0);
         }
     }
     
@@ -473,15 +847,15 @@ private:
 
 private:
     QWebSocketServer *wsServer_ = nullptr;
-    QList<QWebSocket*> clients_;
-    QMap<QWebSocket*, bool> clientBusyState_;  // true = busy, false = free
+    ClientListModel *clientModel_ = nullptr;  // Owns the connection table
+    quint32 nextStreamId_ = 1;
     bool isDestroying_ = false;
 
     QPlainTextEdit *textEdit_ = nullptr;
     QPushButton *startButton_ = nullptr;
     QPushButton *stopButton_ = nullptr;
     QLabel *statusLabel_ = nullptr;
-    QListWidget *clientList_ = nullptr;
+    QListView *clientList_ = nullptr;
 
     QSpinBox *minDelaySpinBox_ = nullptr;
     QSpinBox *maxDelaySpinBox_ = nullptr;
@@ -500,6 +874,7 @@ private:
     
     QCheckBox *mouseCheck_ = nullptr;
     QCheckBox *scrollCheck_ = nullptr;
+    QCheckBox *streamCheck_ = nullptr;
 };
 
 int main(int argc, char *argv[]) {